@@ -0,0 +1,1112 @@
+/*
+ * TilEm II benchmark suite
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This program runs a fixed set of workloads on the emulator core,
+   and writes the results as a JSON document for tracking performance
+   over time.  No calculator ROM is needed: each test calculator has
+   its Flash/ROM erased, and a small test program written into page
+   0.  The programs use RAM at C000-FFFF, which is mapped there on all
+   models (for Flash-based models, after writing to port 7.)
+
+   All emulation is deterministic, so the numbers of instructions and
+   cycles executed for a given workload are the same on every run;
+   only the host times should vary. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tilem.h>
+
+#include "host.h"
+
+#ifndef PACKAGE_VERSION
+# define PACKAGE_VERSION "unknown"
+#endif
+
+/* Test programs */
+
+#define ADDR_IDLE     0x0000
+#define ADDR_MIX      0x0100
+#define ADDR_INTR     0x0200
+#define ADDR_LCD      0x0300
+#define ADDR_AUDIO    0x0380
+#define ADDR_LINK_TX  0x0400
+#define ADDR_LINK_RX  0x0480
+
+/* Counter incremented by the interrupt handler and by the link
+   receiver */
+#define ADDR_COUNTER  0xC200
+
+typedef struct _TestSegment {
+	word addr;
+	word length;
+	const byte *data;
+} TestSegment;
+
+static const byte prog_idle[] = {
+	0xF3,                   /* 0000 di */
+	0x76,                   /* 0001 halt */
+	0x18, 0xFD              /* 0002 jr 0001h */
+};
+
+/* Interrupt handler: count interrupts, then acknowledge the timer
+   interrupt (port 3 works the same way on all models) */
+static const byte prog_isr[] = {
+	0xF5,                   /* 0038 push af */
+	0xE5,                   /* 0039 push hl */
+	0x2A, 0x00, 0xC2,       /* 003A ld hl,(0C200h) */
+	0x23,                   /* 003D inc hl */
+	0x22, 0x00, 0xC2,       /* 003E ld (0C200h),hl */
+	0x3E, 0x08,             /* 0041 ld a,08h */
+	0xD3, 0x03,             /* 0043 out (03h),a */
+	0x3E, 0x0B,             /* 0045 ld a,0Bh */
+	0xD3, 0x03,             /* 0047 out (03h),a */
+	0xE1,                   /* 0049 pop hl */
+	0xF1,                   /* 004A pop af */
+	0xFB,                   /* 004B ei */
+	0xC9                    /* 004C ret */
+};
+
+/* General instruction mix: loads, ALU, block moves, bit operations,
+   indexed addressing, calls, and stack operations */
+static const byte prog_mix[] = {
+	0xF3,                   /* 0100 di */
+	                        /*      mix: */
+	0x21, 0x00, 0xC0,       /* 0101 ld hl,0C000h */
+	0x06, 0x40,             /* 0104 ld b,40h */
+	                        /*      fill: */
+	0x78,                   /* 0106 ld a,b */
+	0x87,                   /* 0107 add a,a */
+	0xAE,                   /* 0108 xor (hl) */
+	0x77,                   /* 0109 ld (hl),a */
+	0x23,                   /* 010A inc hl */
+	0x10, 0xF9,             /* 010B djnz fill */
+	0x21, 0x00, 0xC0,       /* 010D ld hl,0C000h */
+	0x11, 0x00, 0xC1,       /* 0110 ld de,0C100h */
+	0x01, 0x40, 0x00,       /* 0113 ld bc,0040h */
+	0xED, 0xB0,             /* 0116 ldir */
+	0xDD, 0x21, 0x00, 0xC1, /* 0118 ld ix,0C100h */
+	0x06, 0x20,             /* 011C ld b,20h */
+	                        /*      sum: */
+	0xDD, 0x7E, 0x00,       /* 011E ld a,(ix+0) */
+	0xDD, 0x86, 0x01,       /* 0121 add a,(ix+1) */
+	0xCB, 0x3F,             /* 0124 srl a */
+	0x30, 0x01,             /* 0126 jr nc,$+3 */
+	0x3C,                   /* 0128 inc a */
+	0xDD, 0x77, 0x00,       /* 0129 ld (ix+0),a */
+	0xDD, 0x23,             /* 012C inc ix */
+	0xC5,                   /* 012E push bc */
+	0xCD, 0x60, 0x01,       /* 012F call sub */
+	0xC1,                   /* 0132 pop bc */
+	0x10, 0xE9,             /* 0133 djnz sum */
+	0xC3, 0x01, 0x01,       /* 0135 jp mix */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	                        /*      sub: */
+	0xD9,                   /* 0160 exx */
+	0x08,                   /* 0161 ex af,af' */
+	0xED, 0x5B, 0x00, 0xC1, /* 0162 ld de,(0C100h) */
+	0x2A, 0x02, 0xC1,       /* 0166 ld hl,(0C102h) */
+	0x19,                   /* 0169 add hl,de */
+	0xED, 0x52,             /* 016A sbc hl,de */
+	0x29,                   /* 016C add hl,hl */
+	0x22, 0x04, 0xC1,       /* 016D ld (0C104h),hl */
+	0x08,                   /* 0170 ex af,af' */
+	0xD9,                   /* 0171 exx */
+	0xC9                    /* 0172 ret */
+};
+
+/* Wait for interrupts in a loop */
+static const byte prog_intr[] = {
+	0x3E, 0x0B,             /* 0200 ld a,0Bh */
+	0xD3, 0x03,             /* 0202 out (03h),a */
+	0xED, 0x56,             /* 0204 im 1 */
+	0xFB,                   /* 0206 ei */
+	0x76,                   /* 0207 halt */
+	0x18, 0xFD              /* 0208 jr 0207h */
+};
+
+/* Fill the (T6A04) LCD with columns that are dark in 0, 1, 2 or 3
+   of every 4 frames, producing four levels of gray */
+static const byte prog_lcd[] = {
+	0xF3,                   /* 0300 di */
+	0x3E, 0x01,             /* 0301 ld a,01h     ; 8-bit mode */
+	0xCD, 0x40, 0x03,       /* 0303 call lcdcmd */
+	0x3E, 0x05,             /* 0306 ld a,05h     ; increment row */
+	0xCD, 0x40, 0x03,       /* 0308 call lcdcmd */
+	0x3E, 0x03,             /* 030B ld a,03h     ; display on */
+	0xCD, 0x40, 0x03,       /* 030D call lcdcmd */
+	0x1E, 0x00,             /* 0310 ld e,00h */
+	                        /*      frame: */
+	0x7B,                   /* 0312 ld a,e */
+	0x3C,                   /* 0313 inc a */
+	0xE6, 0x03,             /* 0314 and 03h */
+	0x5F,                   /* 0316 ld e,a */
+	0x16, 0x20,             /* 0317 ld d,20h */
+	                        /*      col: */
+	0x3E, 0x80,             /* 0319 ld a,80h */
+	0xCD, 0x40, 0x03,       /* 031B call lcdcmd */
+	0x7A,                   /* 031E ld a,d */
+	0xCD, 0x40, 0x03,       /* 031F call lcdcmd */
+	0x7A,                   /* 0322 ld a,d */
+	0xE6, 0x03,             /* 0323 and 03h */
+	0x4F,                   /* 0325 ld c,a */
+	0x7B,                   /* 0326 ld a,e */
+	0xB9,                   /* 0327 cp c */
+	0x9F,                   /* 0328 sbc a,a      ; dark if E < (D & 3) */
+	0x4F,                   /* 0329 ld c,a */
+	0x06, 0x40,             /* 032A ld b,40h */
+	                        /*      row: */
+	0x79,                   /* 032C ld a,c */
+	0xCD, 0x48, 0x03,       /* 032D call lcddata */
+	0x10, 0xFA,             /* 0330 djnz row */
+	0x14,                   /* 0332 inc d */
+	0x7A,                   /* 0333 ld a,d */
+	0xFE, 0x2C,             /* 0334 cp 2Ch */
+	0x20, 0xE1,             /* 0336 jr nz,col */
+	0x18, 0xD8,             /* 0338 jr frame */
+	0, 0, 0, 0, 0, 0,
+	                        /*      lcdcmd: */
+	0xCD, 0x50, 0x03,       /* 0340 call lcdwait */
+	0xD3, 0x10,             /* 0343 out (10h),a */
+	0xC9,                   /* 0345 ret */
+	0, 0,
+	                        /*      lcddata: */
+	0xCD, 0x50, 0x03,       /* 0348 call lcdwait */
+	0xD3, 0x11,             /* 034B out (11h),a */
+	0xC9,                   /* 034D ret */
+	0, 0,
+	                        /*      lcdwait: */
+	0xF5,                   /* 0350 push af */
+	0xDB, 0x10,             /* 0351 in a,(10h) */
+	0x17,                   /* 0353 rla */
+	0x38, 0xFB,             /* 0354 jr c,0351h */
+	0xF1,                   /* 0356 pop af */
+	0xC9                    /* 0357 ret */
+};
+
+/* Square wave (about 3.5 kHz at 6 MHz) on the link port */
+static const byte prog_audio[] = {
+	0xF3,                   /* 0380 di */
+	0xAF,                   /* 0381 xor a */
+	0xEE, 0x03,             /* 0382 xor 03h */
+	0xD3, 0x00,             /* 0384 out (00h),a */
+	0x06, 0x40,             /* 0386 ld b,40h */
+	0x10, 0xFE,             /* 0388 djnz $ */
+	0x18, 0xF6              /* 038A jr 0382h */
+};
+
+/* Send bytes continuously using the standard TI link protocol */
+static const byte prog_link_tx[] = {
+	0xF3,                   /* 0400 di */
+	0x21, 0x00, 0xC0,       /* 0401 ld hl,0C000h */
+	                        /*      byte: */
+	0x5E,                   /* 0404 ld e,(hl) */
+	0x2C,                   /* 0405 inc l */
+	0x0E, 0x08,             /* 0406 ld c,08h */
+	                        /*      bit: */
+	0xDB, 0x00,             /* 0408 in a,(00h)   ; wait for idle */
+	0xE6, 0x03,             /* 040A and 03h */
+	0xFE, 0x03,             /* 040C cp 03h */
+	0x20, 0xF8,             /* 040E jr nz,bit */
+	0xCB, 0x1B,             /* 0410 rr e */
+	0x3E, 0x01,             /* 0412 ld a,01h */
+	0x30, 0x02,             /* 0414 jr nc,$+4 */
+	0x3E, 0x02,             /* 0416 ld a,02h */
+	0xD3, 0x00,             /* 0418 out (00h),a  ; send bit */
+	0xDB, 0x00,             /* 041A in a,(00h)   ; wait for ack */
+	0xE6, 0x03,             /* 041C and 03h */
+	0x20, 0xFA,             /* 041E jr nz,041Ah */
+	0xAF,                   /* 0420 xor a */
+	0xD3, 0x00,             /* 0421 out (00h),a */
+	0xDB, 0x00,             /* 0423 in a,(00h)   ; wait for release */
+	0xE6, 0x03,             /* 0425 and 03h */
+	0xFE, 0x03,             /* 0427 cp 03h */
+	0x20, 0xF8,             /* 0429 jr nz,0423h */
+	0x0D,                   /* 042B dec c */
+	0x20, 0xDA,             /* 042C jr nz,bit */
+	0x18, 0xD4              /* 042E jr byte */
+};
+
+/* Receive bytes continuously, counting them */
+static const byte prog_link_rx[] = {
+	0xF3,                   /* 0480 di */
+	                        /*      byte: */
+	0x0E, 0x08,             /* 0481 ld c,08h */
+	                        /*      bit: */
+	0xDB, 0x00,             /* 0483 in a,(00h)   ; wait for bit */
+	0xE6, 0x03,             /* 0485 and 03h */
+	0xFE, 0x03,             /* 0487 cp 03h */
+	0x28, 0xF8,             /* 0489 jr z,bit */
+	0xD3, 0x00,             /* 048B out (00h),a  ; ack */
+	0x1F,                   /* 048D rra */
+	0xCB, 0x1A,             /* 048E rr d */
+	0xDB, 0x00,             /* 0490 in a,(00h)   ; wait for release */
+	0xE6, 0x03,             /* 0492 and 03h */
+	0x28, 0xFA,             /* 0494 jr z,0490h */
+	0xAF,                   /* 0496 xor a */
+	0xD3, 0x00,             /* 0497 out (00h),a */
+	0x0D,                   /* 0499 dec c */
+	0x20, 0xE7,             /* 049A jr nz,bit */
+	0x2A, 0x00, 0xC2,       /* 049C ld hl,(0C200h) */
+	0x23,                   /* 049F inc hl */
+	0x22, 0x00, 0xC2,       /* 04A0 ld (0C200h),hl */
+	0x18, 0xDC              /* 04A3 jr byte */
+};
+
+#define SEGMENT(aaa, ddd) { aaa, sizeof(ddd), ddd }
+
+static const TestSegment test_segments[] = {
+	SEGMENT(ADDR_IDLE, prog_idle),
+	SEGMENT(0x0038, prog_isr),
+	SEGMENT(ADDR_MIX, prog_mix),
+	SEGMENT(ADDR_INTR, prog_intr),
+	SEGMENT(ADDR_LCD, prog_lcd),
+	SEGMENT(ADDR_AUDIO, prog_audio),
+	SEGMENT(ADDR_LINK_TX, prog_link_tx),
+	SEGMENT(ADDR_LINK_RX, prog_link_rx)
+};
+
+
+/* Utility functions */
+
+/* Count the bits set in X */
+static int count_bits(unsigned int x)
+{
+	int n = 0;
+
+	while (x) {
+		x &= x - 1;
+		n++;
+	}
+	return n;
+}
+
+/* Map RAM into the upper half of the address space. */
+static int map_ram(TilemCalc *calc)
+{
+	static const byte port7_values[] = { 0x41, 0x81 };
+	unsigned int i;
+
+	if (calc->hw.mem_ltop(calc, 0xC000) >= calc->hw.romsize)
+		return 1;
+
+	for (i = 0; i < sizeof(port7_values); i++) {
+		tilem_calc_reset(calc);
+		(*calc->hw.z80_out)(calc, 0x07, port7_values[i]);
+		if (calc->hw.mem_ltop(calc, 0xC000) >= calc->hw.romsize)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Create a calculator running the given test program.  Returns NULL
+   if the test programs can't be run on this model. */
+static TilemCalc * new_test_calc(char model, dword entry)
+{
+	TilemCalc *calc;
+	unsigned int i;
+
+	calc = tilem_calc_new(model);
+	if (!calc)
+		return NULL;
+
+	memset(calc->mem, 0xff, calc->hw.romsize);
+	for (i = 0; i < sizeof(test_segments) / sizeof(TestSegment); i++)
+		memcpy(calc->mem + test_segments[i].addr,
+		       test_segments[i].data, test_segments[i].length);
+
+	tilem_calc_reset(calc);
+	if (!map_ram(calc)) {
+		tilem_calc_free(calc);
+		return NULL;
+	}
+
+	calc->z80.r.pc.d = entry;
+	calc->z80.r.sp.d = 0xFFF0;
+	calc->z80.stop_mask = ~(TILEM_STOP_BREAKPOINT | TILEM_STOP_EXCEPTION);
+	return calc;
+}
+
+/* Run for the given number of emulated microseconds, in slices
+   similar to those used by the GUI. */
+static void run_calc(TilemCalc *calc, qword usec)
+{
+	int n;
+
+	while (usec > 0) {
+		n = (usec > 10000 ? 10000 : usec);
+		tilem_z80_run_time(calc, n, NULL);
+		usec -= n;
+	}
+}
+
+static word get_counter(TilemCalc *calc)
+{
+	return ((*calc->hw.z80_rdmem)(calc, ADDR_COUNTER)
+	        | ((*calc->hw.z80_rdmem)(calc, ADDR_COUNTER + 1) << 8));
+}
+
+
+/* JSON output */
+
+static FILE *outfile;
+static int nresults;
+static int nfields;
+
+static void begin_result(const char *name, const char *model)
+{
+	fprintf(outfile, "%s\n    { \"name\": \"%s\"",
+	        (nresults ? "," : ""), name);
+	if (model)
+		fprintf(outfile, ", \"model\": \"%s\"", model);
+	nresults++;
+	nfields = 0;
+}
+
+static void add_int(const char *key, qword value)
+{
+	fprintf(outfile, ",%s\"%s\": %llu", (nfields % 4 ? " " : "\n      "),
+	        key, (unsigned long long) value);
+	nfields++;
+}
+
+static void add_double(const char *key, double value)
+{
+	fprintf(outfile, ",%s\"%s\": %.6g", (nfields % 4 ? " " : "\n      "),
+	        key, value);
+	nfields++;
+}
+
+static void end_result(void)
+{
+	fprintf(outfile, " }");
+	fflush(outfile);
+}
+
+/* Write standard statistics for an emulation run */
+static void add_run_stats(const TilemPerfCounters *perf, double emutime,
+                          double hosttime)
+{
+	add_int("instructions", perf->instructions);
+	add_int("cycles", perf->cycles);
+	add_int("interrupts", perf->interrupts);
+	add_double("emulated_seconds", emutime);
+	add_double("host_seconds", hosttime);
+	add_double("mips", (hosttime > 0
+	                    ? perf->instructions / hosttime * 1e-6 : 0.0));
+	add_double("speed", (hosttime > 0 ? emutime / hosttime : 0.0));
+}
+
+/* Run a workload twice: once with performance counters enabled, to
+   count instructions and cycles, and then again (with identical
+   initial state) to measure host time.  SETUP, if not NULL, is called
+   to finish setting up each calculator. */
+static int run_workload(const char *name, const TilemHardware *hw,
+                        dword entry, qword usec,
+                        void (*setup)(TilemCalc *, void *), void *data)
+{
+	TilemCalc *calc;
+	TilemPerfCounters perf;
+	double t;
+
+	calc = new_test_calc(hw->model_id, entry);
+	if (!calc)
+		return 0;
+	if (setup)
+		(*setup)(calc, data);
+	tilem_perf_counters_enable(calc, 1);
+	run_calc(calc, usec);
+	perf = *calc->perf;
+	tilem_calc_free(calc);
+
+	calc = new_test_calc(hw->model_id, entry);
+	if (setup)
+		(*setup)(calc, data);
+	t = host_get_time();
+	run_calc(calc, usec);
+	t = host_get_time() - t;
+	tilem_calc_free(calc);
+
+	begin_result(name, hw->name);
+	add_run_stats(&perf, usec * 1e-6, t);
+	end_result();
+	return 1;
+}
+
+
+/* Benchmarks */
+
+static qword duration = 10000000;
+
+static const TilemHardware * get_model(char id)
+{
+	const TilemHardware **models;
+	int nmodels, i;
+
+	tilem_get_supported_hardware(&models, &nmodels);
+	for (i = 0; i < nmodels; i++)
+		if (models[i]->model_id == id)
+			return models[i];
+	return NULL;
+}
+
+/* Raw interpreter speed for each model */
+static void bench_interp(void)
+{
+	const TilemHardware **models;
+	int nmodels, i;
+
+	tilem_get_supported_hardware(&models, &nmodels);
+	for (i = 0; i < nmodels; i++)
+		run_workload("interp", models[i], ADDR_MIX, duration,
+		             NULL, NULL);
+}
+
+/* Idle (halted) calculator with interrupts disabled */
+static void bench_idle(void)
+{
+	const TilemHardware **models;
+	int nmodels, i;
+
+	tilem_get_supported_hardware(&models, &nmodels);
+	for (i = 0; i < nmodels; i++)
+		run_workload("idle", models[i], ADDR_IDLE, duration * 10,
+		             NULL, NULL);
+}
+
+/* Halted calculator, waking up for each timer interrupt */
+static void bench_interrupts(void)
+{
+	const TilemHardware **models;
+	int nmodels, i;
+
+	tilem_get_supported_hardware(&models, &nmodels);
+	for (i = 0; i < nmodels; i++)
+		run_workload("interrupts", models[i], ADDR_INTR, duration * 10,
+		             NULL, NULL);
+}
+
+static int bp_always_false(TilemCalc *calc TILEM_ATTR_UNUSED,
+                           dword addr TILEM_ATTR_UNUSED,
+                           void *data TILEM_ATTR_UNUSED)
+{
+	return 0;
+}
+
+static void add_breakpoints(TilemCalc *calc, void *data)
+{
+	int n = *(int *) data;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		/* never hit */
+		tilem_z80_add_breakpoint(calc, TILEM_BREAK_MEM_EXEC,
+		                         0x4000 + i * 0x10, 0x400f + i * 0x10,
+		                         0xffff, NULL, NULL);
+		tilem_z80_add_breakpoint(calc, TILEM_BREAK_MEM_WRITE,
+		                         0xD000 + i * 0x10, 0xD00f + i * 0x10,
+		                         0xffff, NULL, NULL);
+		tilem_z80_add_breakpoint(calc, TILEM_BREAK_PORT_WRITE,
+		                         0x40 + i, 0x40 + i, 0xff, NULL, NULL);
+
+		/* hit frequently, but filtered out by the callback */
+		tilem_z80_add_breakpoint(calc, TILEM_BREAK_MEM_READ,
+		                         0xC100, 0xC13F, 0xffff,
+		                         &bp_always_false, NULL);
+	}
+}
+
+/* Interpreter speed with a large number of breakpoints set */
+static void bench_breakpoints(void)
+{
+	static const int counts[] = { 1, 8, 64 };
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	char name[64];
+	unsigned int i;
+	int n;
+
+	for (i = 0; i < sizeof(counts) / sizeof(int); i++) {
+		n = counts[i];
+		sprintf(name, "breakpoints.%d", n * 4);
+		run_workload(name, hw, ADDR_MIX, duration,
+		             &add_breakpoints, &n);
+	}
+}
+
+/* Grayscale LCD emulation, with frames taken at 60 Hz; SAMPLEINT is
+   passed to tilem_gray_lcd_new.  Returns the set of gray levels
+   (rounded to multiples of 1/4) shown in the last frame, as a bit
+   mask. */
+static unsigned int bench_gray_lcd_mode(const char *name, int sampleint)
+{
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	TilemCalc *calc;
+	TilemGrayLCD *glcd;
+	TilemLCDBuffer *buf;
+	TilemPerfCounters perf;
+	qword t, lasthash = 0;
+	double ht;
+	byte *prev = NULL;
+	int pass, size, differs, i, j;
+	int nframes = 0, nchanged = 0, nhasherrors = 0;
+	unsigned int levels = 0;
+
+	memset(&perf, 0, sizeof(perf));
+	ht = 0;
+
+	for (pass = 0; pass < 2; pass++) {
+		calc = new_test_calc(hw->model_id, ADDR_LCD);
+		glcd = tilem_gray_lcd_new(calc, 4, sampleint);
+		buf = tilem_lcd_buffer_new();
+		if (pass == 0)
+			tilem_perf_counters_enable(calc, 1);
+
+		ht = host_get_time();
+		for (t = 0; t < duration; t += 16667) {
+			tilem_z80_run_time(calc, 16667, NULL);
+			tilem_gray_lcd_get_frame(glcd, buf);
+			if (pass > 0)
+				continue;
+
+			/* count frames that really differ from the
+			   previous one, and check that the hash
+			   agrees */
+			size = buf->rowstride * buf->height;
+			differs = (!prev || memcmp(prev, buf->data, size));
+			if (differs != (!prev || buf->hash != lasthash))
+				nhasherrors++;
+			if (differs) {
+				nchanged++;
+				tilem_free(prev);
+				prev = tilem_new_atomic(byte, size);
+				memcpy(prev, buf->data, size);
+			}
+			lasthash = buf->hash;
+			nframes++;
+		}
+		ht = host_get_time() - ht;
+
+		if (pass == 0) {
+			perf = *calc->perf;
+
+			for (i = 0; i < buf->height; i++)
+				for (j = 0; j < buf->width; j++)
+					levels |= 1 << ((buf->data[i * buf->rowstride + j]
+					                 + 16) >> 5);
+		}
+
+		tilem_lcd_buffer_free(buf);
+		tilem_gray_lcd_free(glcd);
+		tilem_calc_free(calc);
+	}
+
+	tilem_free(prev);
+
+	/* make sure the test program really is drawing something */
+	if (nchanged < 2) {
+		fprintf(stderr, "tilem-bench: LCD test program did not"
+		        " change the display\n");
+		exit(1);
+	}
+
+	if (nhasherrors) {
+		fprintf(stderr, "tilem-bench: LCD frame hash does not match"
+		        " frame contents (%d frames)\n", nhasherrors);
+		exit(1);
+	}
+
+	begin_result(name, hw->name);
+	add_run_stats(&perf, duration * 1e-6, ht);
+	add_int("frames", nframes);
+	add_int("changed_frames", nchanged);
+	add_int("lcd_writes", perf.lcd_writes);
+	add_int("gray_levels", count_bits(levels));
+	end_result();
+
+	return levels;
+}
+
+/* Grayscale LCD, sampled at fixed intervals and timed by LCD change
+   events; both should show the same gray levels */
+static void bench_gray_lcd(void)
+{
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	unsigned int sampled, events;
+
+	sampled = bench_gray_lcd_mode("gray_lcd", 200);
+	events = bench_gray_lcd_mode("gray_lcd_events", 0);
+
+	if (count_bits(sampled) < 4 || events != sampled) {
+		fprintf(stderr, "tilem-bench: LCD test program shows %d gray"
+		        " levels when sampled, %d when timed by events"
+		        " (expected the same 4)\n",
+		        count_bits(sampled), count_bits(events));
+		exit(1);
+	}
+
+	run_workload("mono_lcd", hw, ADDR_LCD, duration, NULL, NULL);
+}
+
+/* Fill an LCD buffer with a test pattern */
+static void fill_lcd_buffer(TilemLCDBuffer *buf, int width, int height)
+{
+	int x, y;
+
+	buf->width = width;
+	buf->height = height;
+	buf->rowstride = width;
+	buf->contrast = 32;
+	buf->format = TILEM_LCD_BUF_BLACK_128;
+	tilem_free(buf->data);
+	buf->data = tilem_new_atomic(byte, width * height);
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			buf->data[y * width + x] = ((x ^ y) * 37) & 0x7f;
+}
+
+/* Cost of scaling the LCD image to various sizes */
+static void bench_draw(void)
+{
+	static const int scales[] = { 1, 2, 3, 4, 6 };
+	static const struct { const char *name; int type; } types[] = {
+		{ "fast", TILEM_SCALE_FAST },
+		{ "smooth", TILEM_SCALE_SMOOTH } };
+	TilemLCDBuffer *buf;
+	dword *palette;
+	byte *img;
+	char name[64];
+	int w, h, n;
+	unsigned int i, j, k;
+	double t;
+
+	buf = tilem_lcd_buffer_new();
+	palette = tilem_color_palette_new(255, 255, 255, 0, 0, 0, 2.2);
+
+	for (i = 0; i < 2; i++) {
+		/* 96x64 (monochrome) and 320x240 (color) screens */
+		if (i == 0)
+			fill_lcd_buffer(buf, 96, 64);
+		else
+			fill_lcd_buffer(buf, 320, 240);
+
+		for (j = 0; j < sizeof(scales) / sizeof(int); j++) {
+			w = buf->width * scales[j] + (scales[j] > 1 ? 5 : 0);
+			h = buf->height * scales[j] + (scales[j] > 1 ? 3 : 0);
+			img = tilem_new_atomic(byte, w * h * 4);
+
+			for (k = 0; k < 2; k++) {
+				/* run for at least 0.2 seconds */
+				n = 0;
+				t = host_get_time();
+				do {
+					tilem_draw_lcd_image_rgb
+						(buf, img, w, h, w * 3, 3,
+						 palette, types[k].type);
+					n++;
+				} while (host_get_time() - t < 0.2);
+				t = host_get_time() - t;
+
+				sprintf(name, "draw_rgb.%s", types[k].name);
+				begin_result(name, NULL);
+				add_int("lcd_width", buf->width);
+				add_int("lcd_height", buf->height);
+				add_int("width", w);
+				add_int("height", h);
+				add_int("frames", n);
+				add_double("host_seconds", t);
+				add_double("us_per_frame", t * 1e6 / n);
+				end_result();
+			}
+
+			tilem_free(img);
+		}
+	}
+
+	tilem_free(palette);
+	tilem_lcd_buffer_free(buf);
+}
+
+/* Streaming the gray LCD test program to a Y4M video (at 60 frames
+   per second, so that every LCD frame is converted) */
+static void bench_video(void)
+{
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	TilemCalc *calc;
+	TilemGrayLCD *glcd;
+	TilemLCDBuffer *buf;
+	TilemVideoWriter *vw;
+	dword *palette;
+	FILE *f;
+	qword t, lasthash = 0;
+	double ht;
+	long size;
+	int nchanged = 0;
+
+	f = tmpfile();
+	if (!f) {
+		perror("tmpfile");
+		return;
+	}
+
+	calc = new_test_calc(hw->model_id, ADDR_LCD);
+	glcd = tilem_gray_lcd_new(calc, 4, 200);
+	buf = tilem_lcd_buffer_new();
+	palette = tilem_color_palette_new(255, 255, 255, 0, 0, 0, 2.2);
+	vw = tilem_video_writer_new(f, TILEM_VIDEO_Y4M,
+	                            hw->lcdwidth * 2, hw->lcdheight * 2,
+	                            60, palette);
+
+	ht = host_get_time();
+	for (t = 0; vw && t < duration; t += 16667) {
+		tilem_z80_run_time(calc, 16667, NULL);
+		tilem_gray_lcd_get_frame(glcd, buf);
+		if (nchanged == 0 || buf->hash != lasthash)
+			nchanged++;
+		lasthash = buf->hash;
+		if (tilem_video_writer_add_frame(vw, buf, 16667))
+			break;
+	}
+	ht = host_get_time() - ht;
+
+	/* identical frames are not converted again, so the results
+	   are only meaningful if the display is changing */
+	if (vw && nchanged < 2) {
+		fprintf(stderr, "tilem-bench: LCD test program did not"
+		        " change the display\n");
+		exit(1);
+	}
+
+	begin_result("video_y4m", hw->name);
+	add_double("emulated_seconds", duration * 1e-6);
+	add_double("host_seconds", ht);
+	if (vw) {
+		add_int("frames", tilem_video_writer_get_frame_count(vw));
+		add_int("changed_frames", nchanged);
+		add_int("write_errors", tilem_video_writer_free(vw) ? 1 : 0);
+	}
+	size = ftell(f);
+	add_int("bytes", size > 0 ? size : 0);
+	end_result();
+
+	fclose(f);
+	tilem_free(palette);
+	tilem_lcd_buffer_free(buf);
+	tilem_gray_lcd_free(glcd);
+	tilem_calc_free(calc);
+}
+
+typedef struct _AudioData {
+	TilemAudioFilter *af;
+	qword nbytes;
+	short buffer[4096];
+} AudioData;
+
+static void audio_callback(TilemCalc *calc TILEM_ATTR_UNUSED,
+                           TilemAudioFilter *af, void *buffer, int length,
+                           void *data)
+{
+	AudioData *ad = data;
+	ad->nbytes += length;
+	tilem_audio_filter_set_buffer(af, buffer, length);
+}
+
+static void setup_audio(TilemCalc *calc, AudioData *ad)
+{
+	ad->af = tilem_audio_filter_new(calc);
+	ad->nbytes = 0;
+	tilem_audio_filter_set_rate(ad->af, 44100);
+	tilem_audio_filter_set_channels(ad->af, 2);
+	tilem_audio_filter_set_format(ad->af, TILEM_AUDIO_S16);
+	tilem_audio_filter_set_callback(ad->af, &audio_callback, ad);
+	tilem_audio_filter_set_buffer(ad->af, ad->buffer, sizeof(ad->buffer));
+	tilem_audio_filter_on(ad->af);
+	calc->z80.stop_mask |= TILEM_STOP_AUDIO_BUFFER;
+}
+
+/* Audio filtering of a square wave */
+static void bench_audio(void)
+{
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	static AudioData data;
+	TilemCalc *calc;
+	TilemPerfCounters perf;
+	double t;
+	int pass;
+
+	memset(&perf, 0, sizeof(perf));
+	t = 0;
+
+	for (pass = 0; pass < 2; pass++) {
+		calc = new_test_calc(hw->model_id, ADDR_AUDIO);
+		setup_audio(calc, &data);
+		if (pass == 0)
+			tilem_perf_counters_enable(calc, 1);
+
+		t = host_get_time();
+		run_calc(calc, duration);
+		t = host_get_time() - t;
+
+		if (pass == 0)
+			perf = *calc->perf;
+
+		/* (the callback would refill the buffer forever) */
+		tilem_audio_filter_set_callback(data.af, NULL, NULL);
+		tilem_audio_filter_free(data.af);
+		tilem_calc_free(calc);
+	}
+
+	begin_result("audio", hw->name);
+	add_run_stats(&perf, duration * 1e-6, t);
+	add_int("samples", data.nbytes / 4);
+	end_result();
+
+	run_workload("audio_off", hw, ADDR_AUDIO, duration, NULL, NULL);
+}
+
+/* Saving and loading calculator state */
+static void bench_state(void)
+{
+	static const char models[] = { TILEM_CALC_TI83P, TILEM_CALC_TI84P_SE };
+	TilemCalc *calc, *calc2;
+	FILE *romf, *savf;
+	double tsave, tload, t;
+	unsigned int i;
+	int n;
+	long romsize, savsize;
+
+	for (i = 0; i < sizeof(models); i++) {
+		calc = new_test_calc(models[i], ADDR_MIX);
+		if (!calc)
+			continue;
+		run_calc(calc, 100000);
+
+		romf = tmpfile();
+		savf = tmpfile();
+		if (!romf || !savf) {
+			perror("tilem-bench: tmpfile");
+			exit(1);
+		}
+
+		tsave = tload = 0;
+		romsize = savsize = 0;
+		for (n = 0; tsave + tload < 1.0; n++) {
+			rewind(romf);
+			rewind(savf);
+			t = host_get_time();
+			if (tilem_calc_save_state(calc, romf, savf)) {
+				fprintf(stderr, "tilem-bench: cannot save state\n");
+				exit(1);
+			}
+			fflush(romf);
+			fflush(savf);
+			tsave += host_get_time() - t;
+
+			romsize = ftell(romf);
+			savsize = ftell(savf);
+
+			rewind(romf);
+			rewind(savf);
+			t = host_get_time();
+			calc2 = tilem_calc_new(models[i]);
+			if (tilem_calc_load_state(calc2, romf, savf)) {
+				fprintf(stderr, "tilem-bench: cannot load state\n");
+				exit(1);
+			}
+			tload += host_get_time() - t;
+			tilem_calc_free(calc2);
+		}
+
+		begin_result("state", calc->hw.name);
+		add_int("iterations", n);
+		add_int("rom_bytes", romsize);
+		add_int("sav_bytes", savsize);
+		add_double("save_ms", tsave * 1e3 / n);
+		add_double("load_ms", tload * 1e3 / n);
+		end_result();
+
+		fclose(romf);
+		fclose(savf);
+		tilem_calc_free(calc);
+	}
+}
+
+/* Transfer data between two calculators connected by a virtual cable.
+   Each calculator is run for a short time slice, and the link line
+   state is copied across whenever one of them changes it. */
+static void bench_link(void)
+{
+	const TilemHardware *hw = get_model(TILEM_CALC_TI83P);
+	TilemCalc *tx, *rx;
+	qword t, nbytes = 0;
+	double ht;
+	int rem, n;
+	word count, prevcount = 0;
+
+	tx = new_test_calc(hw->model_id, ADDR_LINK_TX);
+	rx = new_test_calc(hw->model_id, ADDR_LINK_RX);
+	tx->linkport.linkemu = TILEM_LINK_EMULATOR_BLACK;
+	rx->linkport.linkemu = TILEM_LINK_EMULATOR_BLACK;
+	tx->z80.stop_mask &= ~TILEM_STOP_LINK_STATE;
+	rx->z80.stop_mask &= ~TILEM_STOP_LINK_STATE;
+
+	ht = host_get_time();
+	for (t = 0; t < duration; ) {
+		tilem_z80_run_time(tx, 50, &rem);
+		n = (rem < 50 ? 50 - rem : 1);
+		tilem_linkport_blacklink_set_lines(rx, tx->linkport.lines);
+		tilem_z80_run_time(rx, n, NULL);
+		tilem_linkport_blacklink_set_lines(tx, rx->linkport.lines);
+		t += n;
+
+		/* counter is only 16 bits */
+		count = get_counter(rx);
+		nbytes += (word) (count - prevcount);
+		prevcount = count;
+	}
+	ht = host_get_time() - ht;
+
+	begin_result("link", hw->name);
+	add_int("bytes", nbytes);
+	add_double("emulated_seconds", duration * 1e-6);
+	add_double("host_seconds", ht);
+	add_double("bytes_per_host_second", nbytes / ht);
+	add_double("bytes_per_emulated_second", nbytes / (duration * 1e-6));
+	end_result();
+
+	tilem_calc_free(tx);
+	tilem_calc_free(rx);
+}
+
+static const struct {
+	const char *name;
+	void (*func)(void);
+} benchmarks[] = {
+	{ "interp", &bench_interp },
+	{ "idle", &bench_idle },
+	{ "interrupts", &bench_interrupts },
+	{ "breakpoints", &bench_breakpoints },
+	{ "lcd", &bench_gray_lcd },
+	{ "draw", &bench_draw },
+	{ "video", &bench_video },
+	{ "audio", &bench_audio },
+	{ "state", &bench_state },
+	{ "link", &bench_link }
+};
+
+#define NBENCHMARKS ((int) (sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+static void usage(const char *progname, FILE *f)
+{
+	int i;
+
+	fprintf(f, "Usage: %s [OPTIONS] [BENCHMARK ...]\n"
+	        "Options:\n"
+	        "  -d SECONDS   Emulated time for each run (default: 10)\n"
+	        "  -o FILE      Write results to FILE\n"
+	        "  -v           Show emulator warnings\n"
+	        "Benchmarks:\n ", progname);
+	for (i = 0; i < NBENCHMARKS; i++)
+		fprintf(f, " %s", benchmarks[i].name);
+	fprintf(f, "\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *outname = NULL;
+	char **selected;
+	int nselected = 0;
+	int i, j;
+
+	selected = tilem_new(char *, argc);
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+			duration = atof(argv[++i]) * 1e6;
+		}
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+			outname = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-v")) {
+			host_verbose = 1;
+		}
+		else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0], stdout);
+			return 0;
+		}
+		else if (argv[i][0] == '-') {
+			usage(argv[0], stderr);
+			return 1;
+		}
+		else {
+			for (j = 0; j < NBENCHMARKS; j++)
+				if (!strcmp(argv[i], benchmarks[j].name))
+					break;
+			if (j == NBENCHMARKS) {
+				fprintf(stderr, "%s: unknown benchmark %s\n",
+				        argv[0], argv[i]);
+				return 1;
+			}
+			selected[nselected++] = argv[i];
+		}
+	}
+
+	if (duration < 1000)
+		duration = 1000;
+
+	if (outname) {
+		outfile = fopen(outname, "w");
+		if (!outfile) {
+			perror(outname);
+			return 1;
+		}
+	}
+	else {
+		outfile = stdout;
+	}
+
+	fprintf(outfile, "{\n  \"program\": \"tilem-bench\",\n"
+	        "  \"version\": \"%s\",\n"
+	        "  \"duration\": %g,\n"
+	        "  \"results\": [", PACKAGE_VERSION, duration * 1e-6);
+
+	for (i = 0; i < NBENCHMARKS; i++) {
+		for (j = 0; j < nselected; j++)
+			if (!strcmp(selected[j], benchmarks[i].name))
+				break;
+		if (nselected == 0 || j < nselected)
+			(*benchmarks[i].func)();
+	}
+
+	fprintf(outfile, "\n  ]\n}\n");
+
+	tilem_free(selected);
+
+	if (outfile != stdout && fclose(outfile)) {
+		perror(outname);
+		return 1;
+	}
+	return 0;
+}
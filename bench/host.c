@@ -0,0 +1,131 @@
+/*
+ * TilEm II benchmark suite
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <tilem.h>
+
+#include "host.h"
+
+int host_verbose;
+
+double host_get_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec * 1e-6);
+}
+
+/* Memory management and logging (required by libtilemcore) */
+
+void tilem_free(void* p)
+{
+	free(p);
+}
+
+static void * check_alloc(void* p)
+{
+	if (!p) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+void* tilem_malloc(size_t s)
+{
+	return check_alloc(malloc(s ? s : 1));
+}
+
+void* tilem_realloc(void* p, size_t s)
+{
+	return check_alloc(realloc(p, s ? s : 1));
+}
+
+void* tilem_try_malloc(size_t s)
+{
+	return malloc(s ? s : 1);
+}
+
+void* tilem_malloc0(size_t s)
+{
+	return check_alloc(calloc(1, s ? s : 1));
+}
+
+void* tilem_try_malloc0(size_t s)
+{
+	return calloc(1, s ? s : 1);
+}
+
+void* tilem_malloc_atomic(size_t s)
+{
+	return tilem_malloc(s);
+}
+
+void* tilem_try_malloc_atomic(size_t s)
+{
+	return tilem_try_malloc(s);
+}
+
+const char * tilem_gettext(const char *msg)
+{
+	return msg;
+}
+
+static void log_message(TilemCalc* calc, const char* prefix,
+                        const char* msg, va_list ap)
+{
+	fprintf(stderr, "x%c: %s", calc->hw.model_id, prefix);
+	vfprintf(stderr, msg, ap);
+	fputc('\n', stderr);
+}
+
+void tilem_message(TilemCalc* calc, const char* msg, ...)
+{
+	va_list ap;
+	if (host_verbose) {
+		va_start(ap, msg);
+		log_message(calc, "", msg, ap);
+		va_end(ap);
+	}
+}
+
+void tilem_warning(TilemCalc* calc, const char* msg, ...)
+{
+	va_list ap;
+	if (host_verbose) {
+		va_start(ap, msg);
+		log_message(calc, "WARNING: ", msg, ap);
+		va_end(ap);
+	}
+}
+
+void tilem_internal(TilemCalc* calc, const char* msg, ...)
+{
+	va_list ap;
+	va_start(ap, msg);
+	log_message(calc, "INTERNAL ERROR: ", msg, ap);
+	va_end(ap);
+}
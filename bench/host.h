@@ -0,0 +1,28 @@
+/*
+ * TilEm II benchmark suite
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Host functions shared by the benchmark programs.  (host.c also
+   provides the memory allocation and logging functions required by
+   libtilemcore.) */
+
+/* If nonzero, show messages and warnings from the emulator */
+extern int host_verbose;
+
+/* Get current wall-clock time in seconds */
+double host_get_time(void);
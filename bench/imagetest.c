@@ -0,0 +1,569 @@
+/*
+ * TilEm II LCD image conversion tests
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This program checks the LCD image scaling and conversion functions
+   (tilem_draw_lcd_image_*) against a straightforward reference
+   implementation: the scalar code that those functions replaced.
+
+   Each test fills a TilemLCDBuffer with random contents (monochrome
+   or grayscale, or color), picks a random contrast, palette, output
+   size, row stride, and scaling mode, and compares the library's
+   output with the reference output byte for byte.  Output buffers
+   are filled with random bytes beforehand, so that bytes the
+   functions should not touch (row padding, the fourth byte of 32-bit
+   RGB pixels, rows outside the requested range) are checked too.
+
+   The exit status is nonzero if any test fails. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tilem.h>
+
+#include "host.h"
+
+/* Random numbers (a fixed generator, so that failures can be
+   reproduced with -s) */
+
+static dword rand_state;
+
+static dword rand_next(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 8) & 0xffffff;
+}
+
+/* Random integer between MIN and MAX inclusive */
+static int rand_range(int min, int max)
+{
+	return min + (int) (rand_next() % (dword) (max - min + 1));
+}
+
+static void rand_fill(byte *p, int n)
+{
+	while (n-- > 0)
+		*p++ = rand_next();
+}
+
+/* Reference implementation */
+
+static void ref_add_scale1d_exact(const byte *in, int incount,
+                                  unsigned int *out, int outcount,
+                                  int f, int channels)
+{
+	int i, j, k;
+
+	for (i = 0; i < incount; i++) {
+		for (j = 0; j < outcount / incount; j++) {
+			for (k = 0; k < channels; k++)
+				out[k] += in[k] * f * incount;
+			out += channels;
+		}
+		in += channels;
+	}
+}
+
+static void ref_add_scale1d_smooth(const byte *in, int incount,
+                                   unsigned int *out, int outcount,
+                                   int f, int channels)
+{
+	int in_rem, out_rem;
+	unsigned int outv[3];
+	int i, k;
+
+	in_rem = outcount;
+	out_rem = incount;
+	outv[0] = outv[1] = outv[2] = 0;
+	i = outcount;
+	while (i > 0) {
+		if (in_rem < out_rem) {
+			out_rem -= in_rem;
+			for (k = 0; k < channels; k++)
+				outv[k] += in_rem * in[k] * f;
+			in += channels;
+			in_rem = outcount;
+		}
+		else {
+			in_rem -= out_rem;
+			for (k = 0; k < channels; k++) {
+				outv[k] += out_rem * in[k] * f;
+				out[k] += outv[k];
+				outv[k] = 0;
+			}
+			out += channels;
+			out_rem = incount;
+			i--;
+		}
+	}
+}
+
+static void ref_add_scale1d(const byte *in, int incount,
+                            unsigned int *out, int outcount,
+                            int f, int channels)
+{
+	if (outcount % incount)
+		ref_add_scale1d_smooth(in, incount, out, outcount,
+		                       f, channels);
+	else
+		ref_add_scale1d_exact(in, incount, out, outcount,
+		                      f, channels);
+}
+
+/* Scale by averaging; output values are multiplied by INWIDTH *
+   INHEIGHT */
+static void ref_scale2d_smooth(const byte *in,
+                               int inwidth, int inheight, int inrowstride,
+                               unsigned int *out,
+                               int outwidth, int outheight, int channels)
+{
+	int outrowstride = outwidth * channels;
+	int in_rem, out_rem;
+	int i;
+
+	memset(out, 0, outrowstride * outheight * sizeof(unsigned int));
+
+	in_rem = outheight;
+	out_rem = inheight;
+	i = outheight;
+	while (i > 0) {
+		if (in_rem < out_rem) {
+			if (in_rem)
+				ref_add_scale1d(in, inwidth, out, outwidth,
+				                in_rem, channels);
+			out_rem -= in_rem;
+			in += inrowstride;
+			in_rem = outheight;
+		}
+		else {
+			in_rem -= out_rem;
+			ref_add_scale1d(in, inwidth, out, outwidth,
+			                out_rem, channels);
+			out += outrowstride;
+			out_rem = inheight;
+			i--;
+		}
+	}
+}
+
+/* Scale by nearest neighbor; output is a packed array of input
+   pixels */
+static void ref_scale2d_fast(const byte *in,
+                             int inwidth, int inheight, int inrowstride,
+                             byte *out, int outwidth, int outheight,
+                             int channels)
+{
+	const byte *p;
+	int i, j, k, e, f;
+
+	e = outheight - inheight / 2;
+	i = outheight;
+	while (i > 0) {
+		if (e >= 0) {
+			p = in;
+			f = outwidth - inwidth / 2;
+			j = outwidth;
+			while (j > 0) {
+				if (f >= 0) {
+					for (k = 0; k < channels; k++)
+						*out++ = p[k];
+					f -= inwidth;
+					j--;
+				}
+				else {
+					f += outwidth;
+					p += channels;
+				}
+			}
+			e -= inheight;
+			i--;
+		}
+		else {
+			e += outheight;
+			in += inrowstride;
+		}
+	}
+}
+
+static void ref_contrast_settings(unsigned int contrast,
+                                  int *cbase, int *cfact)
+{
+	if (contrast < 32) {
+		*cbase = 0;
+		*cfact = contrast * 8;
+	}
+	else {
+		*cbase = (contrast - 32) * 8;
+		*cfact = 255 - *cbase;
+	}
+}
+
+/* Compute the (unconverted) output pixel values: gray levels 0-128,
+   or RGB triples 0-63, one int per channel */
+static void ref_scale(const TilemLCDBuffer *buf, unsigned int *values,
+                      int imgwidth, int imgheight, int scaletype)
+{
+	int channels = (buf->format == TILEM_LCD_BUF_BLACK_128 ? 1 : 3);
+	int n = imgwidth * imgheight * channels;
+	byte *bbuf;
+	int i;
+
+	if (scaletype == TILEM_SCALE_FAST
+	    || (imgwidth % buf->width == 0 && imgheight % buf->height == 0)) {
+		bbuf = tilem_new_atomic(byte, n);
+		ref_scale2d_fast(buf->data, buf->width, buf->height,
+		                 buf->rowstride, bbuf, imgwidth, imgheight,
+		                 channels);
+		for (i = 0; i < n; i++)
+			values[i] = bbuf[i];
+		tilem_free(bbuf);
+	}
+	else {
+		ref_scale2d_smooth(buf->data, buf->width, buf->height,
+		                   buf->rowstride, values, imgwidth, imgheight,
+		                   channels);
+		for (i = 0; i < n; i++)
+			values[i] /= buf->width * buf->height;
+	}
+}
+
+/* Reference for tilem_draw_lcd_image_indexed_rows */
+static void ref_draw_indexed(const TilemLCDBuffer *buf, byte *buffer,
+                             int imgwidth, int imgheight, int rowstride,
+                             int scaletype, int ystart, int yend)
+{
+	unsigned int *values;
+	int cbase, cfact, i, j;
+	byte cindex[129];
+
+	if (buf->contrast == 0) {
+		for (i = ystart; i < yend; i++)
+			memset(buffer + i * rowstride, 0, imgwidth);
+		return;
+	}
+
+	ref_contrast_settings(buf->contrast, &cbase, &cfact);
+	for (i = 0; i <= 128; i++)
+		cindex[i] = ((i * cfact) >> 7) + cbase;
+
+	values = tilem_new_atomic(unsigned int, imgwidth * imgheight);
+	ref_scale(buf, values, imgwidth, imgheight, scaletype);
+
+	for (i = ystart; i < yend; i++)
+		for (j = 0; j < imgwidth; j++)
+			buffer[i * rowstride + j]
+				= cindex[values[i * imgwidth + j]];
+
+	tilem_free(values);
+}
+
+/* Reference for tilem_draw_lcd_image_rgb_rows (XRGB = 0) and
+   tilem_draw_lcd_image_xrgb_rows (XRGB = 1) */
+static void ref_draw_rgb(const TilemLCDBuffer *buf, byte *buffer,
+                         int imgwidth, int imgheight, int rowstride,
+                         int pixbytes, int xrgb, const dword *palette,
+                         int scaletype, int ystart, int yend)
+{
+	unsigned int *values = NULL;
+	int cbase, cfact, factor, i, j, k;
+	dword c = 0;
+	byte *p;
+
+	if (buf->contrast == 0) {
+		if (buf->format == TILEM_LCD_BUF_BLACK_128)
+			c = palette[0];
+	}
+	else {
+		values = tilem_new_atomic(unsigned int,
+		                          imgwidth * imgheight * 3);
+		ref_scale(buf, values, imgwidth, imgheight, scaletype);
+	}
+
+	ref_contrast_settings(buf->contrast, &cbase, &cfact);
+	factor = buf->contrast * 32;
+	if (factor >= (63335 / 63))
+		factor = (65535 / 63);
+
+	for (i = ystart; i < yend; i++) {
+		for (j = 0; j < imgwidth; j++) {
+			if (!values) {
+				/* blank screen */
+			}
+			else if (buf->format == TILEM_LCD_BUF_BLACK_128) {
+				k = values[i * imgwidth + j];
+				c = palette[((k * cfact) >> 7) + cbase];
+			}
+			else {
+				c = 0;
+				for (k = 0; k < 3; k++)
+					c = ((c << 8)
+					     | ((values[(i * imgwidth + j) * 3 + k]
+					         * factor) >> 8));
+			}
+
+			p = buffer + i * rowstride + j * pixbytes;
+			if (xrgb) {
+				c |= 0xff000000;
+				memcpy(p, &c, 4);
+			}
+			else {
+				p[0] = c >> 16;
+				p[1] = c >> 8;
+				p[2] = c;
+			}
+		}
+	}
+
+	tilem_free(values);
+}
+
+/* Tests */
+
+enum {
+	TEST_INDEXED,
+	TEST_RGB,
+	TEST_XRGB,
+	NUM_TEST_TYPES
+};
+
+static const char * const test_names[NUM_TEST_TYPES] = {
+	"indexed", "rgb", "xrgb"
+};
+
+static int verbose;
+
+/* Run one random test; return 1 if it fails */
+static int run_test(int n)
+{
+	TilemLCDBuffer *buf;
+	dword palette[256];
+	byte *out, *ref;
+	int type, channels, width, height, imgwidth, imgheight;
+	int pixbytes, rowstride, scaletype, ystart, yend, size;
+	int i, j, failed;
+
+	type = rand_range(0, NUM_TEST_TYPES - 1);
+
+	buf = tilem_lcd_buffer_new();
+
+	/* LCD contents: usually the size of a real LCD, sometimes
+	   arbitrary */
+	if (rand_range(0, 1)) {
+		buf->format = TILEM_LCD_BUF_BLACK_128;
+		channels = 1;
+		width = (rand_range(0, 1) ? 96 : 128);
+		height = 64;
+	}
+	else {
+		buf->format = TILEM_LCD_BUF_SRGB_63;
+		channels = 3;
+		width = 320;
+		height = 240;
+	}
+	if (rand_range(0, 3) == 0) {
+		width = rand_range(1, 160);
+		height = rand_range(1, 120);
+	}
+
+	/* the indexed functions accept only grayscale */
+	if (type == TEST_INDEXED && channels != 1) {
+		buf->format = TILEM_LCD_BUF_BLACK_128;
+		channels = 1;
+	}
+
+	buf->width = width;
+	buf->height = height;
+	buf->rowstride = width * channels + rand_range(0, 1) * rand_range(1, 9);
+	buf->data = tilem_new_atomic(byte, buf->rowstride * height);
+	for (i = 0; i < buf->rowstride * height; i++) {
+		/* mostly blank or fully dark pixels, as on a real LCD */
+		j = rand_range(0, 3);
+		if (channels == 1)
+			buf->data[i] = (j == 0 ? rand_range(0, 128)
+			                : j == 1 ? 128 : 0);
+		else
+			buf->data[i] = (j == 0 ? rand_range(0, 63)
+			                : j == 1 ? 63 : 0);
+	}
+
+	buf->contrast = (rand_range(0, 15) ? rand_range(1, 63) : 0);
+
+	for (i = 0; i < 256; i++)
+		palette[i] = rand_next();
+
+	/* output image: scaled up or down by an integer or arbitrary
+	   factor */
+	switch (rand_range(0, 2)) {
+	case 0:
+		imgwidth = width * rand_range(1, 4);
+		imgheight = height * rand_range(1, 4);
+		break;
+	case 1:
+		imgwidth = rand_range(width, width * 4);
+		imgheight = rand_range(height, height * 4);
+		break;
+	default:
+		imgwidth = rand_range(1, width * 2);
+		imgheight = rand_range(1, height * 2);
+		break;
+	}
+
+	if (type == TEST_INDEXED)
+		pixbytes = 1;
+	else if (type == TEST_XRGB)
+		pixbytes = 4;
+	else
+		pixbytes = rand_range(3, 4);
+
+	rowstride = imgwidth * pixbytes + rand_range(0, 1) * rand_range(1, 16);
+	if (type == TEST_XRGB)
+		rowstride = (rowstride + 3) & ~3;
+
+	scaletype = (rand_range(0, 1) ? TILEM_SCALE_SMOOTH : TILEM_SCALE_FAST);
+
+	if (rand_range(0, 1)) {
+		ystart = 0;
+		yend = imgheight;
+	}
+	else {
+		ystart = rand_range(0, imgheight - 1);
+		yend = rand_range(ystart + 1, imgheight);
+	}
+
+	size = rowstride * imgheight;
+	out = tilem_new_atomic(byte, size);
+	ref = tilem_new_atomic(byte, size);
+	rand_fill(out, size);
+	memcpy(ref, out, size);
+
+	switch (type) {
+	case TEST_INDEXED:
+		if (ystart == 0 && yend == imgheight)
+			tilem_draw_lcd_image_indexed(buf, out, imgwidth,
+			                             imgheight, rowstride,
+			                             scaletype);
+		else
+			tilem_draw_lcd_image_indexed_rows(buf, out, imgwidth,
+			                                  imgheight, rowstride,
+			                                  scaletype,
+			                                  ystart, yend);
+		ref_draw_indexed(buf, ref, imgwidth, imgheight, rowstride,
+		                 scaletype, ystart, yend);
+		break;
+
+	case TEST_RGB:
+		if (ystart == 0 && yend == imgheight)
+			tilem_draw_lcd_image_rgb(buf, out, imgwidth, imgheight,
+			                         rowstride, pixbytes, palette,
+			                         scaletype);
+		else
+			tilem_draw_lcd_image_rgb_rows(buf, out, imgwidth,
+			                              imgheight, rowstride,
+			                              pixbytes, palette,
+			                              scaletype, ystart, yend);
+		ref_draw_rgb(buf, ref, imgwidth, imgheight, rowstride,
+		             pixbytes, 0, palette, scaletype, ystart, yend);
+		break;
+
+	case TEST_XRGB:
+		tilem_draw_lcd_image_xrgb_rows(buf, out, imgwidth, imgheight,
+		                               rowstride, palette, scaletype,
+		                               ystart, yend);
+		ref_draw_rgb(buf, ref, imgwidth, imgheight, rowstride,
+		             4, 1, palette, scaletype, ystart, yend);
+		break;
+	}
+
+	failed = memcmp(out, ref, size) != 0;
+
+	if (failed || verbose) {
+		printf("%s: test %d (%s, %s %dx%d stride %d, contrast %d,"
+		       " to %dx%d stride %d, %d bytes/pixel, %s,"
+		       " rows %d-%d)",
+		       (failed ? "FAILED" : "ok"), n, test_names[type],
+		       (channels == 1 ? "gray" : "color"), width, height,
+		       buf->rowstride, buf->contrast, imgwidth, imgheight,
+		       rowstride, pixbytes,
+		       (scaletype == TILEM_SCALE_FAST ? "fast" : "smooth"),
+		       ystart, yend - 1);
+		if (failed) {
+			for (i = 0; i < size && out[i] == ref[i]; i++)
+				;
+			printf(": first difference at row %d, byte %d"
+			       " (got %d, expected %d)",
+			       i / rowstride, i % rowstride, out[i], ref[i]);
+		}
+		printf("\n");
+	}
+
+	tilem_free(out);
+	tilem_free(ref);
+	tilem_lcd_buffer_free(buf);
+	return failed;
+}
+
+static void usage(const char *progname, FILE *f)
+{
+	fprintf(f, "Usage: %s [-v] [-n COUNT] [-s SEED]\n"
+	        "Compare LCD image conversion with a reference"
+	        " implementation,\n"
+	        "using COUNT random tests (default 1000.)\n",
+	        progname);
+}
+
+int main(int argc, char **argv)
+{
+	int i, count = 1000, nfailed = 0;
+	dword seed = 1;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-v")) {
+			verbose = 1;
+		}
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 0);
+		}
+		else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0], stdout);
+			return 0;
+		}
+		else {
+			usage(argv[0], stderr);
+			return 1;
+		}
+	}
+
+	rand_state = seed;
+	for (i = 0; i < count; i++)
+		nfailed += run_test(i);
+
+	if (nfailed) {
+		printf("%d of %d image tests FAILED\n", nfailed, count);
+		return 1;
+	}
+
+	printf("All %d image tests passed\n", count);
+	return 0;
+}
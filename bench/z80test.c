@@ -0,0 +1,591 @@
+/*
+ * TilEm II Z80 core tests
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This program checks the emulated Z80 against two references:
+
+   - With no arguments, every documented (and most undocumented)
+     instruction is executed once, and the number of clock cycles it
+     takes is compared against the standard Z80 timing tables.  Then
+     a program waiting for timer interrupts with HALT is run in slices
+     of various sizes, and the clock at which each interrupt is
+     accepted must not depend on the size of the slices.
+
+   - Given the name of a CP/M program (such as the instruction
+     exercisers zexdoc.com and zexall.com), the program is run on a
+     flat 64k memory model, with the console output functions of BDOS
+     trapped and printed to stdout.  The exercisers themselves are
+     not included with TilEm.
+
+   In both cases, the calculator hardware is replaced by the stub
+   functions below, so no ROM image is needed.  The exit status is
+   nonzero if any test fails. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tilem.h>
+
+#include "host.h"
+
+/* Flat memory model */
+
+static byte flatmem[0x10000];
+
+/* CP/M emulation: executing OUT (0FFh),A calls a BDOS function;
+   executing OUT (0FEh),A exits the program */
+#define PORT_BDOS 0xFF
+#define PORT_EXIT 0xFE
+#define ADDR_BDOS 0xFE00
+
+/* Executing OUT (0FDh),A acknowledges the timer interrupt (see
+   run_halt_program) */
+#define PORT_INTACK 0xFD
+
+static int cpm_finished;
+static int cpm_errors;
+static char cpm_line[256];
+static int cpm_linelen;
+
+#define HALT_TEST_CLOCKS 2000000
+#define HALT_TEST_ACKS 4000
+
+static dword halt_acks[HALT_TEST_ACKS];
+static int halt_nacks;
+
+static void cpm_putc(char c)
+{
+	putchar(c);
+
+	if (c == '\n' || cpm_linelen == sizeof(cpm_line) - 1) {
+		cpm_line[cpm_linelen] = 0;
+		if (strstr(cpm_line, "ERROR"))
+			cpm_errors++;
+		cpm_linelen = 0;
+	}
+	if (c != '\n' && c != '\r')
+		cpm_line[cpm_linelen++] = c;
+}
+
+static byte flat_rdmem(TilemCalc *calc TILEM_ATTR_UNUSED, dword addr)
+{
+	return flatmem[addr & 0xffff];
+}
+
+static void flat_wrmem(TilemCalc *calc TILEM_ATTR_UNUSED, dword addr,
+                       byte value)
+{
+	flatmem[addr & 0xffff] = value;
+}
+
+static dword flat_addr(TilemCalc *calc TILEM_ATTR_UNUSED, dword addr)
+{
+	return addr & 0xffff;
+}
+
+static byte flat_in(TilemCalc *calc TILEM_ATTR_UNUSED,
+                    dword port TILEM_ATTR_UNUSED)
+{
+	return 0xff;
+}
+
+static void flat_out(TilemCalc *calc, dword port, byte value TILEM_ATTR_UNUSED)
+{
+	word de;
+
+	switch (port & 0xff) {
+	case PORT_BDOS:
+		if (calc->z80.r.bc.b.l == 2) {
+			cpm_putc(calc->z80.r.de.b.l);
+		}
+		else if (calc->z80.r.bc.b.l == 9) {
+			de = calc->z80.r.de.w.l;
+			while (flatmem[de] != '$')
+				cpm_putc(flatmem[de++]);
+		}
+		break;
+
+	case PORT_EXIT:
+		cpm_finished = 1;
+		tilem_z80_stop(calc, TILEM_STOP_BREAKPOINT);
+		break;
+
+	case PORT_INTACK:
+		calc->z80.interrupts &= ~TILEM_INTERRUPT_TIMER1;
+		if (calc->z80.clock < HALT_TEST_CLOCKS
+		    && halt_nacks < HALT_TEST_ACKS)
+			halt_acks[halt_nacks++] = calc->z80.clock;
+		break;
+	}
+}
+
+static void flat_ptimer(TilemCalc *calc TILEM_ATTR_UNUSED,
+                        int id TILEM_ATTR_UNUSED)
+{
+}
+
+/* Create a calculator with all hardware replaced by the flat memory
+   model */
+static TilemCalc * new_flat_calc(void)
+{
+	TilemCalc *calc;
+
+	calc = tilem_calc_new(TILEM_CALC_TI83);
+	if (!calc)
+		return NULL;
+
+	calc->hw.z80_in = flat_in;
+	calc->hw.z80_out = flat_out;
+	calc->hw.z80_rdmem = flat_rdmem;
+	calc->hw.z80_rdmem_m1 = flat_rdmem;
+	calc->hw.z80_wrmem = flat_wrmem;
+	calc->hw.z80_instr = NULL;
+	calc->hw.z80_ptimer = flat_ptimer;
+	calc->hw.mem_ltop = flat_addr;
+	calc->hw.mem_ptol = flat_addr;
+
+	tilem_z80_reset(calc);
+	calc->z80.stop_mask = ~TILEM_STOP_BREAKPOINT;
+	return calc;
+}
+
+/* Instruction timing tests */
+
+/* Clock cycles for unprefixed instructions.  For conditional
+   instructions, this is the time taken if the condition is true (for
+   DJNZ, if B is nonzero after decrementing.)  Zero means the
+   instruction is not tested here. */
+static const byte main_timing[256] = {
+	 4, 10,  7,  6,  4,  4,  7,  4,  4, 11,  7,  6,  4,  4,  7,  4,
+	13, 10,  7,  6,  4,  4,  7,  4, 12, 11,  7,  6,  4,  4,  7,  4,
+	12, 10, 16,  6,  4,  4,  7,  4, 12, 11, 16,  6,  4,  4,  7,  4,
+	12, 10, 13,  6, 11, 11, 10,  4, 12, 11, 13,  6,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 7,  7,  7,  7,  7,  7,  0,  7,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	11, 10, 10, 10, 17, 11,  7, 11, 11, 10, 10,  0, 17, 17,  7, 11,
+	11, 10, 10, 11, 17, 11,  7, 11, 11,  4, 10, 11, 17,  0,  7, 11,
+	11, 10, 10, 19, 17, 11,  7, 11, 11,  4, 10,  4, 17,  0,  7, 11,
+	11, 10, 10,  4, 17, 11,  7, 11, 11,  6, 10,  4, 17,  0,  7, 11
+};
+
+/* Clock cycles for ED-prefixed instructions.  Invalid instructions
+   act as two NOPs.  The block instructions are run with BC = 0001h,
+   so LDIR and CPIR finish after one iteration, while INIR and OTIR
+   repeat. */
+static const byte ed_timing[256] = {
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+	12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+	12, 12, 15, 20,  8, 14,  8, 18, 12, 12, 15, 20,  8, 14,  8, 18,
+	12, 12, 15, 20,  8, 14,  8,  8, 12, 12, 15, 20,  8, 14,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	16, 16, 16, 16,  8,  8,  8,  8, 16, 16, 16, 16,  8,  8,  8,  8,
+	16, 16, 21, 21,  8,  8,  8,  8, 16, 16, 21, 21,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+	 8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8
+};
+
+/* Get timing for a conditional instruction when the condition is
+   false; returns 0 for unconditional instructions */
+static int main_timing_false(byte op)
+{
+	if (op == 0x20 || op == 0x28 || op == 0x30 || op == 0x38)
+		return 7;
+	if ((op & 0xc7) == 0xc0)
+		return 5;
+	if ((op & 0xc7) == 0xc2)
+		return 10;
+	if ((op & 0xc7) == 0xc4)
+		return 10;
+	return 0;
+}
+
+/* Check whether the condition for a JR/JP/CALL/RET instruction is
+   true */
+static int condition_true(byte op, byte f)
+{
+	static const byte flags[4] = { 0x40, 0x01, 0x04, 0x80 };
+	int cc;
+
+	if (op < 0x40)
+		cc = (op >> 3) & 3;
+	else
+		cc = (op >> 3) & 7;
+
+	return (!(f & flags[cc >> 1]) == !(cc & 1));
+}
+
+static int cb_timing(byte op, int indexed)
+{
+	if ((op & 7) != 6 && !indexed)
+		return 8;
+	else if ((op & 0xc0) == 0x40)
+		return (indexed ? 20 : 12);
+	else
+		return (indexed ? 23 : 15);
+}
+
+/* Timing for DD- and FD-prefixed instructions.  Instructions that
+   don't use HL act as if the prefix were a NOP. */
+static int index_timing(byte op)
+{
+	switch (op) {
+	case 0x09: case 0x19: case 0x29: case 0x39: return 15;
+	case 0x21: return 14;
+	case 0x22: case 0x2A: return 20;
+	case 0x23: case 0x2B: return 10;
+	case 0x24: case 0x25: case 0x2C: case 0x2D: return 8;
+	case 0x26: case 0x2E: return 11;
+	case 0x34: case 0x35: return 23;
+	case 0x36: return 19;
+	case 0xE1: return 14;
+	case 0xE3: return 23;
+	case 0xE5: return 15;
+	case 0xE9: return 8;
+	case 0xF9: return 10;
+	}
+
+	if (op >= 0x40 && op < 0xc0 && op != 0x76) {
+		if ((op & 7) == 6 || (op >= 0x70 && op < 0x78))
+			return 19;
+		else
+			return 8;
+	}
+
+	return 4 + main_timing[op];
+}
+
+static int timing_failures;
+
+/* Execute a single instruction, and check the number of clock cycles
+   it takes */
+static void check_timing(TilemCalc *calc, const byte *code, int length,
+                         byte f, int expected)
+{
+	dword clock;
+	char buf[20];
+	int i, n;
+
+	memset(flatmem, 0, sizeof(flatmem));
+	memcpy(flatmem + 0x1000, code, length);
+
+	calc->z80.r.af.d = 0xff00 | f;
+	calc->z80.r.bc.d = 0x0001;
+	calc->z80.r.de.d = 0x4100;
+	calc->z80.r.hl.d = 0x4000;
+	calc->z80.r.ix.d = 0x4000;
+	calc->z80.r.iy.d = 0x4000;
+	calc->z80.r.sp.d = 0x8000;
+	calc->z80.r.pc.d = 0x1000;
+	calc->z80.r.iff1 = calc->z80.r.iff2 = 0;
+	calc->z80.halted = 0;
+
+	clock = calc->z80.clock;
+	tilem_z80_run(calc, 1, NULL);
+	n = calc->z80.clock - clock;
+
+	if (n != expected) {
+		for (i = 0; i < length; i++)
+			sprintf(buf + 2 * i, "%02X", code[i]);
+		printf("%-8s F=%02X: %d cycles (expected %d)\n",
+		       buf, f, n, expected);
+		timing_failures++;
+	}
+}
+
+static int run_timing_tests(void)
+{
+	TilemCalc *calc;
+	byte code[4];
+	int i, j, k, t;
+	byte f;
+
+	calc = new_flat_calc();
+	if (!calc)
+		return 1;
+
+	for (k = 0; k < 2; k++) {
+		f = (k ? 0xff : 0x00);
+
+		for (i = 0; i < 256; i++) {
+			if (!main_timing[i])
+				continue;
+			code[0] = i;
+			t = main_timing_false(i);
+			if (t && !condition_true(i, f))
+				check_timing(calc, code, 3, f, t);
+			else
+				check_timing(calc, code, 3, f, main_timing[i]);
+		}
+
+		for (i = 0; i < 256; i++) {
+			code[0] = 0xCB;
+			code[1] = i;
+			check_timing(calc, code, 2, f, cb_timing(i, 0));
+
+			code[0] = 0xED;
+			check_timing(calc, code, 4, f, ed_timing[i]);
+		}
+
+		for (j = 0; j < 2; j++) {
+			code[0] = (j ? 0xFD : 0xDD);
+			for (i = 0; i < 256; i++) {
+				if (i == 0xCB || i == 0xDD || i == 0xED
+				    || i == 0xFD || i == 0x76)
+					continue;
+				if (main_timing_false(i)
+				    && !condition_true(i, f))
+					t = 4 + main_timing_false(i);
+				else
+					t = index_timing(i);
+				code[1] = i;
+				code[2] = code[3] = 0;
+				check_timing(calc, code, 4, f, t);
+			}
+
+			code[1] = 0xCB;
+			code[2] = 0;
+			for (i = 0; i < 256; i++) {
+				code[3] = i;
+				check_timing(calc, code, 4, f, cb_timing(i, 1));
+			}
+		}
+	}
+
+	tilem_calc_free(calc);
+
+	if (timing_failures) {
+		printf("%d timing tests failed\n", timing_failures);
+		return 1;
+	}
+	printf("All timing tests passed\n");
+	return 0;
+}
+
+/* HALT timing tests */
+
+static void halt_timer(TilemCalc *calc, void *data TILEM_ATTR_UNUSED)
+{
+	calc->z80.interrupts |= TILEM_INTERRUPT_TIMER1;
+}
+
+/* Run a program that waits for a periodic timer interrupt using HALT,
+   calling tilem_z80_run with RUNSIZE clock cycles at a time, and
+   record the clock at which each interrupt is acknowledged */
+static int run_halt_program(int period, int runsize)
+{
+	static const byte prog[] = {
+		0xED, 0x56,         /* IM 1 */
+		0xFB,               /* EI */
+		0x76,               /* loop: HALT */
+		0x3C,               /* INC A */
+		0x18, 0xFC          /* JR loop */
+	};
+	static const byte isr[] = {
+		0xD3, PORT_INTACK,  /* OUT (0FDh),A */
+		0xFB,               /* EI */
+		0xC9                /* RET */
+	};
+	TilemCalc *calc;
+
+	memset(flatmem, 0, sizeof(flatmem));
+	memcpy(flatmem, prog, sizeof(prog));
+	memcpy(flatmem + 0x38, isr, sizeof(isr));
+
+	calc = new_flat_calc();
+	if (!calc)
+		return 1;
+
+	calc->z80.r.sp.d = 0x8000;
+	calc->z80.r.pc.d = 0x0000;
+	tilem_z80_add_timer(calc, period, period, 0, &halt_timer, NULL);
+
+	halt_nacks = 0;
+	while (calc->z80.clock < HALT_TEST_CLOCKS)
+		tilem_z80_run(calc, runsize, NULL);
+
+	tilem_calc_free(calc);
+	return 0;
+}
+
+static int run_halt_tests(void)
+{
+	static const int periods[] = { 1000, 1001, 1002, 1003 };
+	static const int runsizes[] = { 4, 13, 997, 1000, 100000 };
+	static dword ref_acks[HALT_TEST_ACKS];
+	int ref_nacks, i, j, failures = 0;
+
+	for (i = 0; i < (int) (sizeof(periods) / sizeof(periods[0])); i++) {
+		/* running one instruction at a time means the CPU
+		   never skips ahead by more than one HALT cycle */
+		if (run_halt_program(periods[i], 1))
+			return 1;
+		memcpy(ref_acks, halt_acks, halt_nacks * sizeof(dword));
+		ref_nacks = halt_nacks;
+
+		for (j = 0; j < (int) (sizeof(runsizes) / sizeof(runsizes[0]));
+		     j++) {
+			if (run_halt_program(periods[i], runsizes[j]))
+				return 1;
+			if (halt_nacks != ref_nacks
+			    || memcmp(halt_acks, ref_acks,
+			              ref_nacks * sizeof(dword))) {
+				printf("HALT, timer period %d, run size %d:"
+				       " interrupts accepted at different"
+				       " times\n", periods[i], runsizes[j]);
+				failures++;
+			}
+		}
+	}
+
+	if (failures) {
+		printf("%d HALT tests failed\n", failures);
+		return 1;
+	}
+	printf("All HALT tests passed\n");
+	return 0;
+}
+
+/* CP/M program tests */
+
+static int run_cpm_program(const char *filename)
+{
+	TilemCalc *calc;
+	FILE *f;
+	size_t n;
+	double t;
+
+	memset(flatmem, 0, sizeof(flatmem));
+
+	f = fopen(filename, "rb");
+	if (!f) {
+		perror(filename);
+		return 1;
+	}
+	n = fread(flatmem + 0x100, 1, ADDR_BDOS - 0x100, f);
+	fclose(f);
+	if (n == 0) {
+		fprintf(stderr, "%s: empty file\n", filename);
+		return 1;
+	}
+
+	/* 0000: OUT (0FEh),A */
+	flatmem[0x0000] = 0xD3;
+	flatmem[0x0001] = PORT_EXIT;
+	/* 0005: JP BDOS */
+	flatmem[0x0005] = 0xC3;
+	flatmem[0x0006] = ADDR_BDOS & 0xff;
+	flatmem[0x0007] = ADDR_BDOS >> 8;
+	/* BDOS: OUT (0FFh),A / RET */
+	flatmem[ADDR_BDOS] = 0xD3;
+	flatmem[ADDR_BDOS + 1] = PORT_BDOS;
+	flatmem[ADDR_BDOS + 2] = 0xC9;
+
+	calc = new_flat_calc();
+	if (!calc)
+		return 1;
+
+	tilem_perf_counters_enable(calc, 1);
+
+	/* return address 0000 on the stack */
+	calc->z80.r.sp.d = ADDR_BDOS - 2;
+	calc->z80.r.pc.d = 0x100;
+
+	cpm_finished = cpm_errors = cpm_linelen = 0;
+
+	t = host_get_time();
+	while (!cpm_finished)
+		tilem_z80_run(calc, 100000000, NULL);
+	t = host_get_time() - t;
+
+	if (cpm_linelen)
+		cpm_putc('\n');
+
+	printf("%llu instructions, %llu cycles in %.2f s (%.1f MIPS)\n",
+	       (unsigned long long) calc->perf->instructions,
+	       (unsigned long long) calc->perf->cycles, t,
+	       calc->perf->instructions / t * 1e-6);
+
+	tilem_calc_free(calc);
+
+	if (cpm_errors) {
+		printf("%s: %d tests failed\n", filename, cpm_errors);
+		return 1;
+	}
+	return 0;
+}
+
+static void usage(const char *progname, FILE *f)
+{
+	fprintf(f, "Usage: %s [-v] [PROGRAM.COM ...]\n"
+	        "With no arguments, check instruction and HALT timings.\n"
+	        "Otherwise, run the given CP/M programs (e.g. zexdoc.com,\n"
+	        "zexall.com).\n",
+	        progname);
+}
+
+int main(int argc, char **argv)
+{
+	int i, nprograms = 0, status = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-v")) {
+			host_verbose = 1;
+		}
+		else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0], stdout);
+			return 0;
+		}
+		else if (argv[i][0] == '-') {
+			usage(argv[0], stderr);
+			return 1;
+		}
+		else {
+			nprograms++;
+		}
+	}
+
+	if (nprograms == 0) {
+		status = run_timing_tests();
+		if (run_halt_tests())
+			status = 1;
+		return status;
+	}
+
+	for (i = 1; i < argc; i++)
+		if (argv[i][0] != '-' && run_cpm_program(argv[i]))
+			status = 1;
+
+	return status;
+}
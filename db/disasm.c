@@ -334,6 +334,43 @@ const char* tilem_disasm_get_label_at_address(const TilemDisasm* dasm,
 		return NULL;
 }
 
+int tilem_disasm_get_romcall_rst(const TilemDisasm* dasm)
+{
+	int i;
+	dword v;
+
+	/* look for a single-byte macro (RST) with a ROM call
+	   argument */
+	for (i = 0; i < dasm->macros.nsyms; i++) {
+		v = dasm->macros.syms[i].value;
+		if ((v & ~0x38) == 0xc7
+		    && strstr(dasm->macros.syms[i].name, "%c"))
+			return v;
+	}
+	return 0;
+}
+
+static const char* profile_func_name(void* data, dword addr, int romcall)
+{
+	const TilemDisasm* dasm = data;
+	TilemDisasmSymbol* sym;
+
+	if (romcall)
+		sym = find_symbol(&dasm->romcalls, addr);
+	else
+		sym = find_symbol(&dasm->labels, addr);
+
+	return (sym ? sym->name : NULL);
+}
+
+int tilem_disasm_write_profile(const TilemDisasm* dasm, TilemProfile* prof,
+			       FILE* outfile, const char* cmd)
+{
+	return tilem_profile_write_callgrind(prof, outfile, cmd,
+					     &profile_func_name,
+					     (void*) dasm);
+}
+
 typedef struct _TilemDisasmInstruction {
 	int length;
 	const char* pattern;
@@ -54,6 +54,15 @@ int tilem_disasm_get_label(const TilemDisasm* dasm, const char* name,
 const char* tilem_disasm_get_label_at_address(const TilemDisasm* dasm,
 					      dword addr);
 
+/* Get the RST opcode used for ROM calls (as defined by a macro such
+   as B_CALL), or 0 if none. */
+int tilem_disasm_get_romcall_rst(const TilemDisasm* dasm);
+
+/* Write profiling data in callgrind format, naming functions
+   according to the labels and ROM calls defined in DASM. */
+int tilem_disasm_write_profile(const TilemDisasm* dasm, TilemProfile* prof,
+			       FILE* outfile, const char* cmd);
+
 /* Disassemble a line starting at address ADDR.  Store text (up to
    BUFSIZE characters) in BUFFER, and set *NEXTADDR to the address of
    the following line.  If PHYS is 0, use logical addresses; otherwise
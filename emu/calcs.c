@@ -131,6 +131,10 @@ TilemCalc* tilem_calc_copy(TilemCalc* calc)
 	if (!newcalc)
 		return NULL;
 	memcpy(newcalc, calc, sizeof(TilemCalc));
+	newcalc->inputlog = NULL;
+	newcalc->profile = NULL;
+	newcalc->trace = NULL;
+	newcalc->perf = NULL;
 
 	newcalc->hwregs = tilem_try_new_atomic(dword, calc->hw.nhwregs);
 	if (!newcalc->hwregs) {
@@ -183,5 +187,6 @@ void tilem_calc_free(TilemCalc* calc)
 	tilem_free(calc->hwregs);
 	tilem_free(calc->z80.breakpoints);
 	tilem_free(calc->z80.timers);
+	tilem_free(calc->perf);
 	tilem_free(calc);
 }
@@ -96,6 +96,9 @@ static inline void set_busy(TilemCalc* calc, int busymode, int time)
 
 static inline void program_byte(TilemCalc* calc, dword a, byte v)
 {
+	if (calc->perf)
+		calc->perf->flash_programs++;
+
 	calc->mem[a] &= v;
 	calc->flash.progaddr = a;
 	calc->flash.progbyte = v;
@@ -116,6 +119,9 @@ static inline void erase_sector(TilemCalc* calc, dword a, dword l)
 {
 	dword i;
 
+	if (calc->perf)
+		calc->perf->flash_erases++;
+
 	calc->flash.progaddr = a;
 	for (i = 0; i < l; i++)
 		calc->mem[a + i]=0xFF;
@@ -81,132 +81,277 @@ static inline void add_scale1d_smooth(const byte * restrict in, int incount,
 	}
 }
 
-/* Scale a 2-dimensional buffer, multiply by INWIDTH * INHEIGHT, and
-   store in the output buffer. */
+/* Parameters for converting scaled pixels to the output format */
+typedef struct _ScaleInfo {
+	int outpixbytes;        /* bytes per output pixel */
+	int xrgb;               /* output pixels are native-endian
+	                           0xFFRRGGBB words */
+	int copyrows;           /* repeated rows may be copied whole */
+	const byte *cindex;     /* output values (indexed from gray) */
+	const dword *cpalette;  /* output colors (RGB from gray) */
+	int rgbfact;            /* fixed-point factor (RGB from RGB) */
+	int ystart, yend;       /* range of output rows to draw */
+
+	const int *map;         /* input pixel for each output pixel
+	                           (fast scaling) */
+	qword recip;            /* reciprocal of input area (smooth
+	                           scaling) */
+	unsigned int *rowbuf;   /* temporary rows (smooth scaling) */
+	unsigned int *accbuf;
+} ScaleInfo;
+
+/* Store an RGB output pixel */
+static inline void put_rgb(byte * restrict out, dword c, int xrgb)
+{
+	if (xrgb) {
+		c |= 0xff000000;
+		memcpy(out, &c, 4);
+	}
+	else {
+		out[0] = c >> 16;
+		out[1] = c >> 8;
+		out[2] = c;
+	}
+}
+
+/* Division of the smoothed pixel values by the input area, done as a
+   fixed-point multiplication.  The result is exact as long as the
+   dividend is less than 2^48 / D; the dividends here are at most
+   255 * D, so this holds for D (the input area) up to about 10^6
+   pixels. */
+#define RECIP_SHIFT 48
+
+static inline qword get_reciprocal(unsigned int d)
+{
+	return ((qword) 1 << RECIP_SHIFT) / d + 1;
+}
+
+static inline unsigned int recip_divide(unsigned int x, qword recip)
+{
+	return (x * recip) >> RECIP_SHIFT;
+}
+
+/* Scale a 1-dimensional buffer, multiply by F * INCOUNT, and add to
+   the output buffer.  The horizontally scaled row is cached in
+   ROWBUF, since each input row is usually added to two or more output
+   rows. */
+static inline void add_scale_row(const byte * restrict in, int incount,
+                                 unsigned int * restrict out, int outcount,
+                                 int f, int channels,
+                                 unsigned int * restrict rowbuf,
+                                 const byte **rowbuf_in)
+{
+	int n = outcount * channels;
+	int k;
+
+	if (*rowbuf_in != in) {
+		memset(rowbuf, 0, n * sizeof(unsigned int));
+		if (outcount % incount)
+			add_scale1d_smooth(in, incount, rowbuf, outcount,
+			                   1, channels);
+		else
+			add_scale1d_exact(in, incount, rowbuf, outcount,
+			                  1, channels);
+		*rowbuf_in = in;
+	}
+
+	for (k = 0; k < n; k++)
+		out[k] += rowbuf[k] * f;
+}
+
+/* Convert a row of smoothed pixel values to the output format. */
+static inline void store_smooth_row(const unsigned int * restrict acc,
+                                    byte * restrict out, int outwidth,
+                                    const ScaleInfo *info)
+{
+	qword recip = info->recip;
+	int pixbytes = info->outpixbytes;
+	dword c;
+	int j, k, v;
+
+	if (info->cindex) {
+		for (j = 0; j < outwidth; j++)
+			out[j] = info->cindex[recip_divide(acc[j], recip)];
+	}
+	else if (info->cpalette) {
+		for (j = 0; j < outwidth; j++, out += pixbytes) {
+			c = info->cpalette[recip_divide(acc[j], recip)];
+			put_rgb(out, c, info->xrgb);
+		}
+	}
+	else {
+		for (j = 0; j < outwidth; j++, out += pixbytes) {
+			c = 0;
+			for (k = 0; k < 3; k++) {
+				v = recip_divide(acc[k], recip);
+				c = (c << 8) | ((v * info->rgbfact) >> 8);
+			}
+			put_rgb(out, c, info->xrgb);
+			acc += 3;
+		}
+	}
+}
+
+/* Scale a 2-dimensional buffer by averaging, and store in the output
+   buffer.  Each output row is accumulated (multiplied by INWIDTH *
+   INHEIGHT) in INFO->ACCBUF, then converted and stored before moving
+   on to the next.  Only output rows INFO->YSTART through INFO->YEND - 1
+   are drawn.  When enlarging the image, consecutive output rows
+   that lie entirely within the same input row are identical, so they
+   are copied rather than recomputed (if INFO->COPYROWS is set.) */
 static void scale2d_smooth(const byte * restrict in,
-			   int inwidth, int inheight, int inrowstride,
-			   unsigned int * restrict out,
+                           int inwidth, int inheight, int inrowstride,
+                           byte * restrict out,
                            int outwidth, int outheight, int outrowstride,
-                           int channels)
+                           int channels, const ScaleInfo *info)
 {
+	unsigned int * restrict acc = info->accbuf;
+	const byte *rowbuf_in = NULL;
+	const byte *prev_in = NULL;
+	const byte *prevout = NULL;
 	int in_rem, out_rem;
-	int i;
+	int i, r;
 
-	memset(out, 0, outrowstride * sizeof(int));
+	memset(acc, 0, outwidth * channels * sizeof(int));
 
 	in_rem = outheight;
 	out_rem = inheight;
 	i = outheight;
 	while (i > 0) {
-		if (in_rem < out_rem) {
-			if (in_rem) {
-				if (outwidth % inwidth)
-					add_scale1d_smooth(in, inwidth, out,
-					                   outwidth, in_rem,
-					                   channels);
-				else
-					add_scale1d_exact(in, inwidth, out,
-					                  outwidth, in_rem,
-					                  channels);
+		r = outheight - i;
+		if (r < info->ystart || r >= info->yend) {
+			/* skip this row, but continue walking the input */
+			if (in_rem < out_rem) {
+				out_rem -= in_rem;
+				in += inrowstride;
+				in_rem = outheight;
 			}
+			else {
+				in_rem -= out_rem;
+				out += outrowstride;
+				out_rem = inheight;
+				prev_in = NULL;
+				i--;
+			}
+		}
+		else if (in_rem < out_rem) {
+			if (in_rem)
+				add_scale_row(in, inwidth, acc, outwidth,
+				              in_rem, channels,
+				              info->rowbuf, &rowbuf_in);
 			out_rem -= in_rem;
 			in += inrowstride;
 			in_rem = outheight;
 		}
 		else {
 			in_rem -= out_rem;
-			if (outwidth % inwidth)
-				add_scale1d_smooth(in, inwidth, out, outwidth,
-				                   out_rem, channels);
-			else
-				add_scale1d_exact(in, inwidth, out, outwidth,
-				                  out_rem, channels);
+			if (out_rem == inheight && prev_in == in
+			    && info->copyrows) {
+				memcpy(out, prevout,
+				       outwidth * info->outpixbytes);
+			}
+			else {
+				add_scale_row(in, inwidth, acc, outwidth,
+				              out_rem, channels,
+				              info->rowbuf, &rowbuf_in);
+				store_smooth_row(acc, out, outwidth, info);
+				memset(acc, 0, outwidth * channels * sizeof(int));
+				prev_in = (out_rem == inheight ? in : NULL);
+			}
+			prevout = out;
 			out += outrowstride;
 			out_rem = inheight;
 			i--;
-			if (i > 0)
-				memset(out, 0, outrowstride * sizeof(int));
-		}
-	}
-}
-
-/* Quickly scale a 1-dimensional, 1-channel buffer and store in the output
-   buffer. */
-static inline void scale1d_fast(const byte * restrict in, int incount,
-				byte * restrict out, int outcount)
-{
-	int i, e;
-
-	e = outcount - incount / 2;
-	i = outcount;
-	while (i > 0) {
-		if (e >= 0) {
-			*out = *in;
-			out++;
-			e -= incount;
-			i--;
-		}
-		else {
-			e += outcount;
-			in++;
 		}
 	}
 }
 
-/* Quickly scale a 1-dimensional, 3-channel buffer, multiply by the
-   given fixed-point factor, and store in the output buffer. */
-static inline void scale1d_fast_rgb(const byte * restrict in, int incount,
-                                    byte * restrict out, int outcount,
-                                    int outpixbytes, int factor)
+/* Find the input pixel for each output pixel, when quickly scaling a
+   1-dimensional buffer. */
+static void get_fast_map(int incount, int outcount, int * restrict map)
 {
-	int i, e;
+	int i, j, e;
 
 	e = outcount - incount / 2;
-	i = outcount;
-	while (i > 0) {
+	i = j = 0;
+	while (j < outcount) {
 		if (e >= 0) {
-			out[0] = (in[0] * factor) >> 8;
-			out[1] = (in[1] * factor) >> 8;
-			out[2] = (in[2] * factor) >> 8;
-			out += outpixbytes;
+			map[j++] = i;
 			e -= incount;
-			i--;
 		}
 		else {
 			e += outcount;
-			in += 3;
+			i++;
 		}
 	}
 }
 
-
 /* Quickly scale a 2-dimensional buffer and store in the output
-   buffer. */
+   buffer (only rows INFO->YSTART through INFO->YEND - 1.)  When an
+   input row is repeated, the previous output row is copied, if
+   INFO->COPYROWS is set. */
 static void scale2d_fast(const byte * restrict in,
-                         int inwidth, int inheight, int inrowstride,
+                         int inwidth TILEM_ATTR_UNUSED,
+                         int inheight, int inrowstride,
                          byte * restrict out,
                          int outwidth, int outheight, int outrowstride,
-                         int outpixbytes, int rgbfact)
+                         const ScaleInfo *info)
 {
-	int i, e;
+	const int * restrict map = info->map;
+	int pixbytes = info->outpixbytes;
+	const byte *prevout = NULL;
+	const byte *p;
+	byte *o;
+	dword c;
+	int i, j, e, r;
 
 	e = outheight - inheight / 2;
 	i = outheight;
 	while (i > 0) {
-		if (e >= 0) {
-			if (rgbfact)
-				scale1d_fast_rgb(in, inwidth, out, outwidth,
-				                 outpixbytes, rgbfact);
-			else
-				scale1d_fast(in, inwidth, out, outwidth);
+		if (e < 0) {
+			e += outheight;
+			in += inrowstride;
+			prevout = NULL;
+			continue;
+		}
+
+		r = outheight - i;
+		if (r < info->ystart || r >= info->yend) {
+			/* skip this row */
+			prevout = NULL;
 			out += outrowstride;
 			e -= inheight;
 			i--;
+			continue;
+		}
+
+		if (prevout && info->copyrows) {
+			memcpy(out, prevout, outwidth * pixbytes);
+		}
+		else if (info->cindex) {
+			for (j = 0; j < outwidth; j++)
+				out[j] = info->cindex[in[map[j]]];
+		}
+		else if (info->cpalette) {
+			for (j = 0, o = out; j < outwidth; j++, o += pixbytes) {
+				c = info->cpalette[in[map[j]]];
+				put_rgb(o, c, info->xrgb);
+			}
 		}
 		else {
-			e += outheight;
-			in += inrowstride;
+			for (j = 0, o = out; j < outwidth; j++, o += pixbytes) {
+				p = in + 3 * map[j];
+				c = (((p[0] * info->rgbfact) >> 8) << 16
+				     | ((p[1] * info->rgbfact) >> 8) << 8
+				     | ((p[2] * info->rgbfact) >> 8));
+				put_rgb(o, c, info->xrgb);
+			}
 		}
+
+		prevout = out;
+		out += outrowstride;
+		e -= inheight;
+		i--;
 	}
 }
 
@@ -239,29 +384,76 @@ static void* alloc_scalebuf(TilemLCDBuffer *buf, unsigned int size)
 	return buf->tmpbuf;
 }
 
+/* Scale the LCD image to the given size, and convert it using the
+   given parameters (the outpixbytes, cindex, cpalette, and rgbfact
+   fields of INFO.) */
+static void scale_image(TilemLCDBuffer * restrict buf,
+                        byte * restrict buffer,
+                        int imgwidth, int imgheight, int rowstride,
+                        int scaletype, ScaleInfo *info)
+{
+	int dwidth = buf->width;
+	int dheight = buf->height;
+	int channels = (buf->format == TILEM_LCD_BUF_BLACK_128 ? 1 : 3);
+	int *map;
+
+	if (scaletype == TILEM_SCALE_FAST
+	    || (imgwidth % dwidth == 0 && imgheight % dheight == 0)) {
+		map = GETSCALEBUF(int, imgwidth, 1);
+		get_fast_map(dwidth, imgwidth, map);
+		info->map = map;
+
+		scale2d_fast(buf->data, dwidth, dheight, buf->rowstride,
+		             buffer, imgwidth, imgheight, rowstride, info);
+	}
+	else {
+		info->rowbuf = GETSCALEBUF(unsigned int,
+		                           imgwidth * channels, 2);
+		info->accbuf = info->rowbuf + imgwidth * channels;
+		info->recip = get_reciprocal(dwidth * dheight);
+
+		scale2d_smooth(buf->data, dwidth, dheight, buf->rowstride,
+		               buffer, imgwidth, imgheight, rowstride,
+		               channels, info);
+	}
+}
+
 void tilem_draw_lcd_image_indexed(TilemLCDBuffer * restrict buf,
                                   byte * restrict buffer,
                                   int imgwidth, int imgheight,
                                   int rowstride, int scaletype)
+{
+	tilem_draw_lcd_image_indexed_rows(buf, buffer, imgwidth, imgheight,
+	                                  rowstride, scaletype,
+	                                  0, imgheight);
+}
+
+void tilem_draw_lcd_image_indexed_rows(TilemLCDBuffer * restrict buf,
+                                       byte * restrict buffer,
+                                       int imgwidth, int imgheight,
+                                       int rowstride, int scaletype,
+                                       int ystart, int yend)
 {
 	int dwidth = buf->width;
 	int dheight = buf->height;
-	int i, j, v;
-	unsigned int * restrict ibuf;
+	int i;
 	int cbase, cfact;
 	byte cindex[129];
+	ScaleInfo info;
 
 	if (buf->format != TILEM_LCD_BUF_BLACK_128) {
 		fprintf(stderr, "INTERNAL ERROR: cannot draw indexed image from RGB\n");
 		return;
 	}
 
+	if (ystart < 0)
+		ystart = 0;
+	if (yend > imgheight)
+		yend = imgheight;
+
 	if (dwidth == 0 || dheight == 0 || buf->contrast == 0) {
-		for (i = 0; i < imgheight; i++) {
-			for (j = 0; j < imgwidth; j++)
-				buffer[j] = 0;
-			buffer += rowstride;
-		}
+		for (i = ystart; i < yend; i++)
+			memset(buffer + i * rowstride, 0, imgwidth);
 		return;
 	}
 
@@ -270,29 +462,14 @@ void tilem_draw_lcd_image_indexed(TilemLCDBuffer * restrict buf,
 	for (i = 0; i <= 128; i++)
 		cindex[i] = ((i * cfact) >> 7) + cbase;
 
-	if (scaletype == TILEM_SCALE_FAST
-	    || (imgwidth % dwidth == 0 && imgheight % dheight == 0)) {
-		scale2d_fast(buf->data, dwidth, dheight, buf->rowstride,
-		             buffer, imgwidth, imgheight, rowstride, 1, 0);
-
-		for (i = 0; i < imgwidth * imgheight; i++)
-			buffer[i] = cindex[buffer[i]];
-	}
-	else {
-		ibuf = GETSCALEBUF(unsigned int, imgwidth, imgheight);
-
-		scale2d_smooth(buf->data, dwidth, dheight, buf->rowstride,
-		               ibuf, imgwidth, imgheight, imgwidth, 1);
-
-		for (i = 0; i < imgheight; i++) {
-			for (j = 0; j < imgwidth; j++) {
-				v = ibuf[j] / (dwidth * dheight);
-				buffer[j] = cindex[v];
-			}
-			ibuf += imgwidth;
-			buffer += rowstride;
-		}
-	}
+	memset(&info, 0, sizeof(info));
+	info.outpixbytes = 1;
+	info.copyrows = 1;
+	info.cindex = cindex;
+	info.ystart = ystart;
+	info.yend = yend;
+	scale_image(buf, buffer, imgwidth, imgheight, rowstride,
+	            scaletype, &info);
 }
 
 static void get_cpalette(TilemLCDBuffer * restrict buf,
@@ -307,135 +484,39 @@ static void get_cpalette(TilemLCDBuffer * restrict buf,
 	}
 }
 
-static void draw_rgb_from_gray_fast(TilemLCDBuffer * restrict buf,
-                                    byte * restrict buffer,
-                                    int imgwidth, int imgheight,
-                                    int rowstride, int pixbytes,
-                                    const dword * restrict palette)
-{
-	int dwidth = buf->width;
-	int dheight = buf->height;
-	int padbytes = rowstride - (imgwidth * pixbytes);
-	int i, j, v;
-	dword cpalette[129];
-	byte * restrict bbuf;
-
-	get_cpalette(buf, cpalette, palette);
-
-	bbuf = GETSCALEBUF(byte, imgwidth, imgheight);
-
-	scale2d_fast(buf->data, dwidth, dheight, buf->rowstride,
-	             bbuf, imgwidth, imgheight, imgwidth, 1, 0);
-
-	for (i = 0; i < imgheight; i++) {
-		for (j = 0; j < imgwidth; j++) {
-			v = bbuf[j];
-			buffer[0] = cpalette[v] >> 16;
-			buffer[1] = cpalette[v] >> 8;
-			buffer[2] = cpalette[v];
-			buffer += pixbytes;
-		}
-		bbuf += imgwidth;
-		buffer += padbytes;
-	}
-}
-
-static void draw_rgb_from_rgb_fast(TilemLCDBuffer * restrict buf,
-                                   byte * restrict buffer,
-                                   int imgwidth, int imgheight,
-                                   int rowstride, int pixbytes)
-{
-	int dwidth = buf->width;
-	int dheight = buf->height;
-	int factor = buf->contrast * 32;
-
-	if (factor >= (63335 / 63))
-		factor = (65535 / 63);
-
-	scale2d_fast(buf->data, dwidth, dheight, buf->rowstride,
-	             buffer, imgwidth, imgheight, rowstride,
-	             pixbytes, factor);
-}
-
-static void draw_rgb_from_gray_smooth(TilemLCDBuffer * restrict buf,
-                                      byte * restrict buffer,
-                                      int imgwidth, int imgheight,
-                                      int rowstride, int pixbytes,
-                                      const dword * restrict palette)
-{
-	int dwidth = buf->width;
-	int dheight = buf->height;
-	int padbytes = rowstride - (imgwidth * pixbytes);
-	int i, j, v;
-	dword cpalette[129];
-	unsigned int * restrict ibuf;
-
-	get_cpalette(buf, cpalette, palette);
-
-	ibuf = GETSCALEBUF(unsigned int, imgwidth, imgheight);
-
-	scale2d_smooth(buf->data, dwidth, dheight, buf->rowstride,
-	               ibuf, imgwidth, imgheight, imgwidth, 1);
-
-	for (i = 0; i < imgheight; i++) {
-		for (j = 0; j < imgwidth; j++) {
-			v = (ibuf[j] / (dwidth * dheight));
-			buffer[0] = cpalette[v] >> 16;
-			buffer[1] = cpalette[v] >> 8;
-			buffer[2] = cpalette[v];
-			buffer += pixbytes;
-		}
-		ibuf += imgwidth;
-		buffer += padbytes;
-	}
-}
-
-static void draw_rgb_from_rgb_smooth(TilemLCDBuffer * restrict buf,
-                                     byte * restrict buffer,
-                                     int imgwidth, int imgheight,
-                                     int rowstride, int pixbytes)
-{
-	int dwidth = buf->width;
-	int dheight = buf->height;
-	int padbytes = rowstride - (imgwidth * pixbytes);
-	int i, j, k, v;
-	unsigned int * restrict ibuf;
-	int factor = buf->contrast * 32;
-
-	if (factor >= (63335 / 63))
-		factor = (65535 / 63);
-
-	ibuf = GETSCALEBUF(unsigned int, imgwidth * 3, imgheight);
-
-	/* FIXME: should do scaling in linear space, not sRGB */
-
-	scale2d_smooth(buf->data, dwidth, dheight, buf->rowstride,
-	               ibuf, imgwidth, imgheight, imgwidth * 3, 3);
-
-	for (i = 0; i < imgheight; i++) {
-		for (j = 0; j < imgwidth; j++) {
-			for (k = 0; k < 3; k++) {
-				v = (ibuf[k] / (dwidth * dheight));
-				buffer[k] = (v * factor) >> 8;
-			}
-			ibuf += 3;
-			buffer += pixbytes;
-		}
-		buffer += padbytes;
-	}
-}
-
 void tilem_draw_lcd_image_rgb(TilemLCDBuffer * restrict buf,
                               byte * restrict buffer,
                               int imgwidth, int imgheight, int rowstride,
                               int pixbytes, const dword * restrict palette,
                               int scaletype)
+{
+	tilem_draw_lcd_image_rgb_rows(buf, buffer, imgwidth, imgheight,
+	                              rowstride, pixbytes, palette,
+	                              scaletype, 0, imgheight);
+}
+
+/* Draw an RGB image; if XRGB is set, each pixel is stored as a
+   native-endian 32-bit word (0xFFRRGGBB) rather than as bytes R, G,
+   B. */
+static void draw_rgb_rows(TilemLCDBuffer * restrict buf,
+                          byte * restrict buffer,
+                          int imgwidth, int imgheight,
+                          int rowstride, int pixbytes, int xrgb,
+                          const dword * restrict palette,
+                          int scaletype, int ystart, int yend)
 {
 	int dwidth = buf->width;
 	int dheight = buf->height;
 	int i, j;
-	int padbytes = rowstride - (imgwidth * pixbytes);
+	byte *p;
 	dword blankcolor;
+	dword cpalette[129];
+	ScaleInfo info;
+
+	if (ystart < 0)
+		ystart = 0;
+	if (yend > imgheight)
+		yend = imgheight;
 
 	if (dwidth == 0 || dheight == 0 || buf->contrast == 0) {
 		if (buf->format == TILEM_LCD_BUF_BLACK_128)
@@ -443,40 +524,57 @@ void tilem_draw_lcd_image_rgb(TilemLCDBuffer * restrict buf,
 		else
 			blankcolor = 0;
 
-		for (i = 0; i < imgheight; i++) {
+		for (i = ystart; i < yend; i++) {
+			p = buffer + i * rowstride;
 			for (j = 0; j < imgwidth; j++) {
-				buffer[0] = blankcolor >> 16;
-				buffer[1] = blankcolor >> 8;
-				buffer[2] = blankcolor;
-				buffer += pixbytes;
+				put_rgb(p, blankcolor, xrgb);
+				p += pixbytes;
 			}
-			buffer += padbytes;
 		}
 		return;
 	}
 
-	if (scaletype == TILEM_SCALE_FAST
-	    || (imgwidth % dwidth == 0 && imgheight % dheight == 0)) {
+	memset(&info, 0, sizeof(info));
+	info.outpixbytes = pixbytes;
+	info.xrgb = xrgb;
+	info.copyrows = (pixbytes != 4 || xrgb);
+	info.ystart = ystart;
+	info.yend = yend;
 
-		if (buf->format == TILEM_LCD_BUF_BLACK_128)
-			draw_rgb_from_gray_fast(buf, buffer,
-			                        imgwidth, imgheight,
-			                        rowstride, pixbytes,
-			                        palette);
-		else
-			draw_rgb_from_rgb_fast(buf, buffer,
-			                       imgwidth, imgheight,
-			                       rowstride, pixbytes);
+	if (buf->format == TILEM_LCD_BUF_BLACK_128) {
+		get_cpalette(buf, cpalette, palette);
+		info.cpalette = cpalette;
 	}
 	else {
-		if (buf->format == TILEM_LCD_BUF_BLACK_128)
-			draw_rgb_from_gray_smooth(buf, buffer,
-			                          imgwidth, imgheight,
-			                          rowstride, pixbytes,
-			                          palette);
-		else
-			draw_rgb_from_rgb_smooth(buf, buffer,
-			                         imgwidth, imgheight,
-			                         rowstride, pixbytes);
+		/* FIXME: should do smooth scaling in linear space, not
+		   sRGB */
+		info.rgbfact = buf->contrast * 32;
+		if (info.rgbfact >= (63335 / 63))
+			info.rgbfact = (65535 / 63);
 	}
+
+	scale_image(buf, buffer, imgwidth, imgheight, rowstride,
+	            scaletype, &info);
+}
+
+void tilem_draw_lcd_image_rgb_rows(TilemLCDBuffer * restrict buf,
+                                   byte * restrict buffer,
+                                   int imgwidth, int imgheight,
+                                   int rowstride, int pixbytes,
+                                   const dword * restrict palette,
+                                   int scaletype, int ystart, int yend)
+{
+	draw_rgb_rows(buf, buffer, imgwidth, imgheight, rowstride,
+	              pixbytes, 0, palette, scaletype, ystart, yend);
+}
+
+void tilem_draw_lcd_image_xrgb_rows(TilemLCDBuffer * restrict buf,
+                                    byte * restrict buffer,
+                                    int imgwidth, int imgheight,
+                                    int rowstride,
+                                    const dword * restrict palette,
+                                    int scaletype, int ystart, int yend)
+{
+	draw_rgb_rows(buf, buffer, imgwidth, imgheight, rowstride,
+	              4, 1, palette, scaletype, ystart, yend);
 }
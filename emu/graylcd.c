@@ -27,13 +27,129 @@
 #include "tilem.h"
 #include "graylcd.h"
 
-/* Read screen contents and update pixels that have changed */
+/* Index of the lowest set bit in a nonzero byte */
+static inline int lowest_bit(unsigned int x)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(x);
+#else
+	int n = 0;
+	while (!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Update counters for the pixels in one byte that have changed (D
+   is the set of changed bits, OB the old value of the byte, and N
+   the index of the byte's leftmost pixel.)  Each interval is also
+   recorded in the current frame, so that it can be subtracted once
+   the frame leaves the window. */
+static inline void update_pixels(TilemGrayLCD * restrict glcd,
+                                 unsigned int d, unsigned int ob, int n)
+{
+	TilemGrayLCDFrame * restrict frm = &glcd->frames[glcd->framenum];
+	TilemGrayLCDPixel * restrict pix;
+	TilemGrayLCDChange * restrict chg;
+	dword delta;
+	int j, k;
+
+	while (d) {
+		j = lowest_bit(d);
+		d &= d - 1;
+		k = n + 7 - j;
+
+		pix = &glcd->curpixels[k];
+		delta = glcd->t - glcd->tchange[k];
+		glcd->tchange[k] = glcd->t;
+
+		if (TILEM_UNLIKELY(frm->nchanges >= frm->nchanges_a)) {
+			frm->nchanges_a = (frm->nchanges_a ? frm->nchanges_a * 2
+			                   : 256);
+			frm->changes = tilem_renew(TilemGrayLCDChange,
+			                           frm->changes,
+			                           frm->nchanges_a);
+		}
+		chg = &frm->changes[frm->nchanges++];
+		chg->pixel = k;
+		chg->length = delta;
+
+		if (ob & (1 << j)) {
+			pix->ndark += delta;
+			pix->ndarkseg++;
+			chg->dark = 1;
+		}
+		else {
+			pix->nlight += delta;
+			pix->nlightseg++;
+			chg->dark = 0;
+		}
+	}
+}
+
+/* Remove the intervals counted in a frame from the window totals,
+   and empty the frame */
+static void expire_frame(TilemGrayLCD * restrict glcd,
+                         TilemGrayLCDFrame * restrict frm)
+{
+	TilemGrayLCDPixel * restrict pix = glcd->curpixels;
+	const TilemGrayLCDChange * restrict chg = frm->changes;
+	int i;
+
+	for (i = 0; i < frm->nchanges; i++) {
+		if (chg[i].dark) {
+			pix[chg[i].pixel].ndark -= chg[i].length;
+			pix[chg[i].pixel].ndarkseg--;
+		}
+		else {
+			pix[chg[i].pixel].nlight -= chg[i].length;
+			pix[chg[i].pixel].nlightseg--;
+		}
+	}
+	frm->nchanges = 0;
+}
+
+/* Read screen contents and update pixels that have changed.  Most
+   of the screen is usually unchanged from one sample to the next, so
+   the old and new contents are compared 64 bits at a time, and only
+   the changed bits of changed bytes are examined individually. */
+static void update_screen(TilemCalc *calc, TilemGrayLCD * restrict glcd)
+{
+	const byte * restrict np;
+	const byte * restrict op;
+	qword nw, ow;
+	int i, k, nbytes;
+	unsigned int d;
+
+	(*calc->hw.get_lcd)(calc, glcd->newbits);
+
+	np = glcd->newbits;
+	op = glcd->oldbits;
+	glcd->oldbits = glcd->newbits;
+	glcd->newbits = (byte *) op;
+
+	/* buffers are padded with zeroes to a multiple of 8 bytes */
+	nbytes = glcd->bwidth * glcd->height;
+	for (i = 0; i < nbytes; i += 8) {
+		memcpy(&nw, np + i, 8);
+		memcpy(&ow, op + i, 8);
+		if (nw == ow)
+			continue;
+
+		for (k = i; k < i + 8; k++) {
+			d = np[k] ^ op[k];
+			if (d)
+				update_pixels(glcd, d, op[k], k * 8);
+		}
+	}
+}
+
+/* Sample the screen at fixed intervals */
 static void tmr_screen_update(TilemCalc *calc, void *data)
 {
 	TilemGrayLCD *glcd = data;
-	byte *np, *op, nb, ob, d;
-	int i, j, n;
-	dword delta;
 
 	glcd->t++;
 
@@ -41,37 +157,28 @@ static void tmr_screen_update(TilemCalc *calc, void *data)
 		return;
 	glcd->lcdupdatetime = calc->z80.lastlcdwrite;
 
-	(*calc->hw.get_lcd)(calc, glcd->newbits);
+	update_screen(calc, glcd);
+}
 
-	np = glcd->newbits;
-	op = glcd->oldbits;
-	glcd->oldbits = np;
-	glcd->newbits = op;
-	n = 0;
+/* Update the screen whenever the LCD driver reports a change, timing
+   each interval exactly (in CPU clock cycles).  Most changes affect
+   a single byte, so only that byte needs to be compared. */
+static void lcd_changed(TilemCalc *calc, void *data, int ofs, byte value)
+{
+	TilemGrayLCD *glcd = data;
+	unsigned int d;
 
-	for (i = 0; i < glcd->bwidth * glcd->height; i++) {
-		nb = *np;
-		ob = *op;
-		d = nb ^ ob;
-		for (j = 0; j < 8; j++) {
-			if (d & (0x80 >> j)) {
-				delta = glcd->t - glcd->tchange[n];
-				glcd->tchange[n] = glcd->t;
+	glcd->t = calc->z80.clock;
 
-				if (ob & (0x80 >> j)) {
-					glcd->curpixels[n].ndark += delta;
-					glcd->curpixels[n].ndarkseg++;
-				}
-				else {
-					glcd->curpixels[n].nlight += delta;
-					glcd->curpixels[n].nlightseg++;
-				}
-			}
-			n++;
-		}
+	if (ofs < 0) {
+		update_screen(calc, glcd);
+		return;
+	}
 
-		np++;
-		op++;
+	d = value ^ glcd->oldbits[ofs];
+	if (d) {
+		update_pixels(glcd, d, glcd->oldbits[ofs], ofs * 8);
+		glcd->oldbits[ofs] = value;
 	}
 }
 
@@ -82,8 +189,10 @@ TilemGrayLCD* tilem_gray_lcd_new(TilemCalc *calc, int windowsize, int sampleint)
 
 	glcd->bwidth = (calc->hw.lcdwidth + 7) / 8;
 	glcd->height = calc->hw.lcdheight;
-	nbytes = glcd->bwidth * glcd->height;
-	npixels = nbytes * 8;
+	npixels = glcd->bwidth * glcd->height * 8;
+
+	/* pad bit buffers so they can be compared as 64-bit words */
+	nbytes = (glcd->bwidth * glcd->height + 7) & ~7;
 
 	glcd->oldbits = tilem_new_atomic(byte, nbytes);
 	glcd->newbits = tilem_new_atomic(byte, nbytes);
@@ -91,19 +200,30 @@ TilemGrayLCD* tilem_gray_lcd_new(TilemCalc *calc, int windowsize, int sampleint)
 	glcd->tframestart = tilem_new_atomic(dword, windowsize);
 	glcd->framestamp = tilem_new_atomic(dword, windowsize);
 	glcd->curpixels = tilem_new_atomic(TilemGrayLCDPixel, npixels);
-	glcd->framebasepixels = tilem_new_atomic(TilemGrayLCDPixel,
-						 npixels * windowsize);
+	glcd->frames = tilem_new0(TilemGrayLCDFrame, windowsize);
+
+	glcd->calc = calc;
+	glcd->t = (sampleint ? 0 : calc->z80.clock);
 
 	memset(glcd->oldbits, 0, nbytes);
-	memset(glcd->tchange, 0, npixels * sizeof(dword));
-	memset(glcd->tframestart, 0, windowsize * sizeof(dword));
+	memset(glcd->newbits, 0, nbytes);
 	memset(glcd->curpixels, 0, npixels * sizeof(TilemGrayLCDPixel));
-	memset(glcd->framebasepixels, 0, (npixels * windowsize
-					  * sizeof(TilemGrayLCDPixel)));
+	for (i = 0; i < npixels; i++)
+		glcd->tchange[i] = glcd->t;
+	for (i = 0; i < windowsize; i++)
+		glcd->tframestart[i] = glcd->t;
 
-	glcd->calc = calc;
-	glcd->timer_id = tilem_z80_add_timer(calc, sampleint / 2, sampleint, 1,
-					     &tmr_screen_update, glcd);
+	if (sampleint) {
+		glcd->timer_id = tilem_z80_add_timer(calc, sampleint / 2,
+		                                     sampleint, 1,
+		                                     &tmr_screen_update, glcd);
+	}
+	else {
+		glcd->timer_id = 0;
+		(*calc->hw.get_lcd)(calc, glcd->oldbits);
+		calc->lcd.changefunc = &lcd_changed;
+		calc->lcd.changedata = glcd;
+	}
 
 	/* assign arbitrary but unique timestamps to the initial n
 	   frames */
@@ -111,7 +231,6 @@ TilemGrayLCD* tilem_gray_lcd_new(TilemCalc *calc, int windowsize, int sampleint)
 		glcd->framestamp[i] = calc->z80.lastlcdwrite - i;
 
 	glcd->lcdupdatetime = calc->z80.lastlcdwrite - 1;
-	glcd->t = 0;
 	glcd->windowsize = windowsize;
 	glcd->sampleint = sampleint;
 	glcd->framenum = 0;
@@ -121,7 +240,15 @@ TilemGrayLCD* tilem_gray_lcd_new(TilemCalc *calc, int windowsize, int sampleint)
 
 void tilem_gray_lcd_free(TilemGrayLCD *glcd)
 {
-	tilem_z80_remove_timer(glcd->calc, glcd->timer_id);
+	int i;
+
+	if (glcd->sampleint) {
+		tilem_z80_remove_timer(glcd->calc, glcd->timer_id);
+	}
+	else if (glcd->calc->lcd.changedata == glcd) {
+		glcd->calc->lcd.changefunc = NULL;
+		glcd->calc->lcd.changedata = NULL;
+	}
 
 	tilem_free(glcd->oldbits);
 	tilem_free(glcd->newbits);
@@ -129,25 +256,61 @@ void tilem_gray_lcd_free(TilemGrayLCD *glcd)
 	tilem_free(glcd->tframestart);
 	tilem_free(glcd->framestamp);
 	tilem_free(glcd->curpixels);
-	tilem_free(glcd->framebasepixels);
+	for (i = 0; i < glcd->windowsize; i++)
+		tilem_free(glcd->frames[i].changes);
+	tilem_free(glcd->frames);
 	tilem_free(glcd);
 }
 
+/* End the current frame: the oldest frame now leaves the window, and
+   its slot is reused for the next frame */
+static void end_frame(TilemGrayLCD * restrict glcd)
+{
+	glcd->framenum = (glcd->framenum + 1) % glcd->windowsize;
+	expire_frame(glcd, &glcd->frames[glcd->framenum]);
+}
+
+void tilem_gray_lcd_next_frame(TilemGrayLCD *glcd)
+{
+	dword tbase, tlimit;
+	dword * restrict tchange = glcd->tchange;
+	int n, npixels = glcd->bwidth * glcd->height * 8;
+
+	glcd->framestamp[glcd->framenum] = glcd->calc->z80.lastlcdwrite;
+
+	if (!glcd->sampleint)
+		glcd->t = glcd->calc->z80.clock;
+
+	tbase = glcd->tframestart[glcd->framenum];
+	glcd->tframestart[glcd->framenum] = glcd->t;
+	tlimit = glcd->t - tbase;
+
+	/* ensure tchange is later than or equal to tbase, as
+	   get_frame does */
+	for (n = 0; n < npixels; n++)
+		if (tchange[n] - tbase > tlimit)
+			tchange[n] = tbase;
+
+	end_frame(glcd);
+}
+
 /* Update levelbuf with values based on the accumulated grayscale
    data */
-void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
-                              TilemLCDBuffer * restrict buf)
+static void get_frame(TilemGrayLCD * restrict glcd,
+                      TilemLCDBuffer * restrict buf)
 {
 	int i, j, n;
-	unsigned int current, delta, fd, fl;
-	word ndark, nlight, ndarkseg, nlightseg;
+	unsigned int current;
+	dword delta, ndark, nlight;
+	word ndarkseg, nlightseg;
+	qword fd, fl;
 	dword tbase, tlimit;
 	dword lastwrite;
 	byte * restrict bp;
 	byte * restrict op;
 	TilemGrayLCDPixel * restrict pix;
-	TilemGrayLCDPixel * restrict basepix;
 	dword * restrict tchange;
+	byte v, changed;
 
 	if (TILEM_UNLIKELY(buf->height != glcd->height
 	                   || buf->rowstride != glcd->bwidth * 8)) {
@@ -157,6 +320,7 @@ void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
 		                             glcd->height * glcd->bwidth * 8);
 		buf->rowstride = glcd->bwidth * 8;
 		buf->height = glcd->height;
+		tilem_lcd_buffer_set_dirty(buf, 0, buf->height);
 	}
 
 	buf->width = glcd->calc->hw.lcdwidth;
@@ -165,10 +329,18 @@ void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
 	    || (glcd->calc->z80.halted && !glcd->calc->poweronhalt)) {
 		/* screen is turned off */
 		buf->stamp = glcd->calc->z80.lastlcdwrite;
+		if (buf->contrast != 0)
+			tilem_lcd_buffer_set_dirty(buf, 0, buf->height);
 		buf->contrast = 0;
+
+		/* keep the window moving, so that writes to LCD memory
+		   while the screen is off do not pile up */
+		tilem_gray_lcd_next_frame(glcd);
 		return;
 	}
 
+	if (buf->contrast != glcd->calc->lcd.contrast)
+		tilem_lcd_buffer_set_dirty(buf, 0, buf->height);
 	buf->contrast = glcd->calc->lcd.contrast;
 
 	/* If LCD remains unchanged throughout the window, set
@@ -184,6 +356,10 @@ void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
 		buf->stamp = glcd->calc->z80.clock + 0x80000000;
 	glcd->framestamp[glcd->framenum] = lastwrite;
 
+	/* in event-driven mode, the time counter is the CPU clock */
+	if (!glcd->sampleint)
+		glcd->t = glcd->calc->z80.clock;
+
 	/* set tbase to the sample number where the window began; this
 	   is used to limit the weight of unchanging pixels */
 	tbase = glcd->tframestart[glcd->framenum];
@@ -193,71 +369,97 @@ void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
 	bp = glcd->newbits;
 	op = buf->data;
 	pix = glcd->curpixels;
-	basepix = glcd->framebasepixels + (glcd->framenum * glcd->height
-					   * glcd->bwidth * 8);
 	tchange = glcd->tchange;
 
 	(*glcd->calc->hw.get_lcd)(glcd->calc, bp);
 
 	n = 0;
+	changed = 0;
 
 	for (i = 0; i < glcd->bwidth * glcd->height; i++) {
 		for (j = 0; j < 8; j++) {
 			/* check if pixel is currently set */
 			current = *bp & (0x80 >> j);
 
+			/* ensure tchange is later than or equal to tbase */
+			if (tchange[n] - tbase > tlimit) {
+				tchange[n] = tbase;
+			}
+
+			delta = glcd->t - tchange[n];
+
+			/* if the pixel has not changed within the
+			   window, it is simply on or off (this is
+			   the common case, so avoid the division) */
+			if (!pix[n].ndarkseg && !pix[n].nlightseg
+			    && !pix[n].ndark && !pix[n].nlight) {
+				v = ((current && delta) ? 128 : 0);
+				changed |= *op ^ v;
+				*op = v;
+				n++;
+				op++;
+				continue;
+			}
+
 			/* compute number of dark and light samples
 			   within the window */
-			ndark = pix[n].ndark - basepix[n].ndark;
-			nlight = pix[n].nlight - basepix[n].nlight;
+			ndark = pix[n].ndark;
+			nlight = pix[n].nlight;
 
 			/* compute number of dark and light segments
 			   within the window */
-			ndarkseg = pix[n].ndarkseg - basepix[n].ndarkseg;
-			nlightseg = pix[n].nlightseg - basepix[n].nlightseg;
+			ndarkseg = pix[n].ndarkseg;
+			nlightseg = pix[n].nlightseg;
 
 			/* average light segment in this window is
 			   (nlight / nlightseg); average dark segment
 			   is (ndark / ndarkseg) */
 
-			/* ensure tchange is later than or equal to tbase */
-			if (tchange[n] - tbase > tlimit) {
-				tchange[n] = tbase;
-			}
-
 			/* if current segment is longer than average,
 			   count it as well */
-			delta = glcd->t - tchange[n];
-
 			if (current) {
-				if (delta * ndarkseg >= ndark) {
+				if ((qword) delta * ndarkseg >= ndark) {
 					ndark += delta;
 					ndarkseg++;
 				}
 			}
 			else {
-				if (delta * nlightseg >= nlight) {
+				if ((qword) delta * nlightseg >= nlight) {
 					nlight += delta;
 					nlightseg++;
 				}
 			}
 
-			fd = ndark * nlightseg;
-			fl = nlight * ndarkseg;
+			fd = (qword) ndark * nlightseg;
+			fl = (qword) nlight * ndarkseg;
 
 			if (fd + fl == 0)
-				*op = (ndark ? 128 : 0);
+				v = (ndark ? 128 : 0);
 			else
-				*op = ((fd * 128) / (fd + fl));
+				v = ((fd * 128) / (fd + fl));
+
+			changed |= *op ^ v;
+			*op = v;
 
 			n++;
 			op++;
 		}
 		bp++;
+
+		/* end of a row */
+		if ((i + 1) % glcd->bwidth == 0 && changed) {
+			j = i / glcd->bwidth;
+			tilem_lcd_buffer_set_dirty(buf, j, j + 1);
+			changed = 0;
+		}
 	}
 
-	memcpy(basepix, pix, (glcd->height * glcd->bwidth * 8
-			      * sizeof(TilemGrayLCDPixel)));
+	end_frame(glcd);
+}
 
-	glcd->framenum = (glcd->framenum + 1) % glcd->windowsize;
+void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
+                              TilemLCDBuffer * restrict buf)
+{
+	get_frame(glcd, buf);
+	tilem_lcd_buffer_update(buf);
 }
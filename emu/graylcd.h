@@ -22,22 +22,36 @@
 #define _TILEM_GRAYLCD_H
 
 typedef struct _TilemGrayLCDPixel {
-	word ndark;		/* Sum of lengths of dark intervals */
-	word nlight;		/* Sum of lengths of light intervals */
+	dword ndark;		/* Sum of lengths of dark intervals */
+	dword nlight;		/* Sum of lengths of light intervals */
 	word ndarkseg;		/* Number of dark intervals */
 	word nlightseg;		/* Number of light intervals */
 } TilemGrayLCDPixel;
 
+typedef struct _TilemGrayLCDChange {
+	dword pixel;		/* Pixel number */
+	dword length;		/* Length of interval */
+	byte dark;		/* 1 if interval was dark, 0 if light */
+} TilemGrayLCDChange;
+
+typedef struct _TilemGrayLCDFrame {
+	TilemGrayLCDChange *changes; /* Intervals ended during frame */
+	int nchanges;		/* Number of intervals */
+	int nchanges_a;		/* Size of changes array */
+} TilemGrayLCDFrame;
+
 struct _TilemGrayLCD {
 	TilemCalc *calc;	/* Calculator */
 	int timer_id;		/* Screen update timer */
 	dword lcdupdatetime;	/* CPU time of last known LCD update */
 
-	dword t;		/* Time counter */
+	dword t;		/* Time counter (samples, or CPU clock
+				   cycles if SAMPLEINT is zero) */
 	int windowsize;		/* Number of frames in the sampling
 				   window */
 	int framenum;		/* Current frame number */
-	int sampleint;		/* Microseconds per sample */ 
+	int sampleint;		/* Microseconds per sample (0 = timed
+				   by LCD change events) */
 
 	int bwidth;		/* Width of LCD, bytes */
 	int height;		/* Height of LCD, pixels */
@@ -48,10 +62,10 @@ struct _TilemGrayLCD {
 	dword *tframestart;	/* Time at start of frame */
 	dword *framestamp;	/* LCD update time at start of frame */
 
-	TilemGrayLCDPixel *curpixels; /* Current pixel counters */
-	TilemGrayLCDPixel *framebasepixels; /* Pixel counters as of
-					       the start of each
-					       frame */
+	TilemGrayLCDPixel *curpixels; /* Pixel counters summed over
+					 the current window */
+	TilemGrayLCDFrame *frames; /* Intervals counted in each frame
+				      of the window */
 };
 
 #endif
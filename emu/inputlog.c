@@ -0,0 +1,422 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "tilem.h"
+#include "gettext.h"
+
+/*
+
+ OVERVIEW
+
+   The emulator itself is completely deterministic; the only things
+   that can make two runs from the same initial state diverge are the
+   inputs supplied by the outside world (keys, link port, battery
+   level, link emulation mode) and the value seen on the data bus when
+   an IM 0 or IM 2 interrupt is accepted.  The input log records each
+   of these, together with the CPU clock at which it occurred, and can
+   later feed them back in at exactly the same points.
+
+ FILE FORMAT
+
+   The log begins with the 8-byte magic string "TILEMLOG", a version
+   byte (currently 1), and the model ID of the calculator.  This is
+   followed by a sequence of events, each consisting of:
+
+    - one byte giving the event type (TILEM_INPUT_*), ORed with 0x80
+      if the event occurred while the CPU was running (i.e., from
+      within a timer or breakpoint callback);
+
+    - the number of clock ticks since the previous event (or since
+      recording began), as an unsigned LEB128 number;
+
+    - one byte of event data.
+
+ TIMING
+
+   An event recorded while the CPU was stopped (the usual case) took
+   effect between two instructions: after the instruction that ended
+   at the recorded clock, and before the next.  When replaying, we set
+   a timer for one tick later, which fires at the first opportunity
+   during that following instruction - before it can read from any
+   I/O port, and before interrupts are checked.
+
+   An event recorded while the CPU was running happened inside a
+   timer callback; replaying it with a timer set for the same clock
+   value causes it to fire at the same point.
+
+   Because the clock counter wraps around every 2^32 ticks, a timer
+   is kept running (both while recording and replaying) so that we
+   notice the passage of time at least every 2^30 ticks.
+
+*/
+
+#define LOG_MAGIC "TILEMLOG"
+#define LOG_VERSION 1
+
+#define EVENT_ASYNC 0x80
+#define EVENT_TYPE_MASK 0x7f
+
+/* Maximum interval between timer callbacks */
+#define MAX_HOP 0x40000000
+
+enum {
+	LOG_RECORD,
+	LOG_REPLAY
+};
+
+struct _TilemInputLog {
+	TilemCalc *calc;
+	FILE *file;
+	int mode;
+	int timer_id;
+
+	int running;		/* CPU currently running */
+	int applying;		/* replay is applying an event */
+	int error;		/* I/O error or desync reported */
+
+	dword lastclock;	/* CPU clock at last update */
+	qword now;		/* Extended clock at last update */
+	qword evtime;		/* Extended clock of previous event */
+
+	byte battery;		/* Battery level in effect */
+	byte linkemu;		/* Link emulation mode in effect */
+
+	/* Next event to be replayed */
+	int nexttype;		/* 0 if end of log */
+	int nextasync;
+	qword nexttime;
+	byte nextvalue;
+};
+
+/* Update extended clock value */
+static void update_clock(TilemInputLog *log)
+{
+	log->now += (dword) (log->calc->z80.clock - log->lastclock);
+	log->lastclock = log->calc->z80.clock;
+}
+
+static void log_io_error(TilemInputLog *log)
+{
+	if (!log->error)
+		tilem_warning(log->calc, _("Error writing input log"));
+	log->error = 1;
+}
+
+/* Recording */
+
+static void write_event(TilemInputLog *log, int type, byte value)
+{
+	qword delta;
+	byte b;
+
+	update_clock(log);
+	delta = log->now - log->evtime;
+	log->evtime = log->now;
+
+	putc(type | (log->running ? EVENT_ASYNC : 0), log->file);
+	do {
+		b = delta & 0x7f;
+		delta >>= 7;
+		putc(b | (delta ? 0x80 : 0), log->file);
+	} while (delta);
+
+	if (putc(value, log->file) == EOF)
+		log_io_error(log);
+}
+
+static void tmr_record(TilemCalc *calc TILEM_ATTR_UNUSED, void *data)
+{
+	update_clock(data);
+}
+
+TilemInputLog* tilem_input_log_record(TilemCalc *calc, FILE *logfile)
+{
+	TilemInputLog *log;
+
+	fwrite(LOG_MAGIC, 1, 8, logfile);
+	putc(LOG_VERSION, logfile);
+	if (putc(calc->hw.model_id, logfile) == EOF)
+		return NULL;
+
+	log = tilem_new0(TilemInputLog, 1);
+	log->calc = calc;
+	log->file = logfile;
+	log->mode = LOG_RECORD;
+	log->lastclock = calc->z80.clock;
+	log->battery = calc->battery;
+	log->linkemu = calc->linkport.linkemu;
+
+	log->timer_id = tilem_z80_add_timer(calc, MAX_HOP, MAX_HOP, 0,
+	                                    &tmr_record, log);
+	calc->inputlog = log;
+	return log;
+}
+
+/* Replaying */
+
+static int read_event(TilemInputLog *log)
+{
+	int type, b, v, shift;
+	qword delta = 0;
+
+	log->nexttype = 0;
+
+	if ((type = getc(log->file)) == EOF)
+		return 0;
+
+	shift = 0;
+	do {
+		if ((b = getc(log->file)) == EOF || shift > 63)
+			return 0;
+		delta |= (qword) (b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	if ((v = getc(log->file)) == EOF)
+		return 0;
+
+	log->nexttype = type & EVENT_TYPE_MASK;
+	log->nextasync = type & EVENT_ASYNC;
+	log->nexttime = log->evtime + delta;
+	log->nextvalue = v;
+	return log->nexttype;
+}
+
+/* Set timer for the next event to be replayed */
+static void schedule_next(TilemInputLog *log)
+{
+	qword target, t;
+
+	if (log->nexttype == 0 || log->nexttype == TILEM_INPUT_INTERRUPT_BUS)
+		t = MAX_HOP;
+	else {
+		target = log->nexttime + (log->nextasync ? 0 : 1);
+		if (target <= log->now)
+			t = 1;
+		else if (target - log->now > MAX_HOP)
+			t = MAX_HOP;
+		else
+			t = target - log->now;
+	}
+
+	tilem_z80_set_timer(log->calc, log->timer_id, t, 0, 0);
+}
+
+static void apply_event(TilemInputLog *log)
+{
+	TilemCalc *calc = log->calc;
+	byte value = log->nextvalue;
+
+	log->applying = 1;
+
+	switch (log->nexttype) {
+	case TILEM_INPUT_KEY_PRESS:
+		tilem_keypad_press_key(calc, value);
+		break;
+
+	case TILEM_INPUT_KEY_RELEASE:
+		tilem_keypad_release_key(calc, value);
+		break;
+
+	case TILEM_INPUT_GRAYLINK_SEND:
+		tilem_linkport_graylink_send_byte(calc, value);
+		break;
+
+	case TILEM_INPUT_GRAYLINK_GET:
+		tilem_linkport_graylink_get_byte(calc);
+		break;
+
+	case TILEM_INPUT_GRAYLINK_RESET:
+		tilem_linkport_graylink_reset(calc);
+		break;
+
+	case TILEM_INPUT_BLACKLINK_LINES:
+		tilem_linkport_blacklink_set_lines(calc, value);
+		break;
+
+	case TILEM_INPUT_BATTERY:
+		log->battery = calc->battery = value;
+		break;
+
+	case TILEM_INPUT_LINK_EMULATOR:
+		log->linkemu = calc->linkport.linkemu = value;
+		break;
+
+	default:
+		tilem_warning(calc, _("Unknown input log event %d"),
+		              log->nexttype);
+	}
+
+	log->applying = 0;
+}
+
+static void tmr_replay(TilemCalc *calc, void *data)
+{
+	TilemInputLog *log = data;
+	qword target;
+
+	update_clock(log);
+
+	while (log->nexttype && log->nexttype != TILEM_INPUT_INTERRUPT_BUS) {
+		target = log->nexttime + (log->nextasync ? 0 : 1);
+		if (target > log->now)
+			break;
+
+		apply_event(log);
+		log->evtime = log->nexttime;
+		read_event(log);
+	}
+
+	if (!log->nexttype)
+		tilem_z80_stop(calc, TILEM_STOP_REPLAY_END);
+
+	schedule_next(log);
+}
+
+TilemInputLog* tilem_input_log_replay(TilemCalc *calc, FILE *logfile)
+{
+	TilemInputLog *log;
+	char magic[8];
+
+	if (fread(magic, 1, 8, logfile) != 8
+	    || memcmp(magic, LOG_MAGIC, 8)
+	    || getc(logfile) != LOG_VERSION
+	    || getc(logfile) != calc->hw.model_id)
+		return NULL;
+
+	log = tilem_new0(TilemInputLog, 1);
+	log->calc = calc;
+	log->file = logfile;
+	log->mode = LOG_REPLAY;
+	log->lastclock = calc->z80.clock;
+	log->battery = calc->battery;
+	log->linkemu = calc->linkport.linkemu;
+
+	read_event(log);
+
+	log->timer_id = tilem_z80_add_timer(calc, MAX_HOP, 0, 0,
+	                                    &tmr_replay, log);
+	schedule_next(log);
+	calc->inputlog = log;
+	return log;
+}
+
+int tilem_input_log_finished(TilemInputLog *log)
+{
+	return (log->mode == LOG_REPLAY && !log->nexttype);
+}
+
+void tilem_input_log_free(TilemInputLog *log)
+{
+	if (log->calc->inputlog == log)
+		log->calc->inputlog = NULL;
+
+	tilem_z80_remove_timer(log->calc, log->timer_id);
+
+	if (log->mode == LOG_RECORD && fflush(log->file))
+		log_io_error(log);
+
+	tilem_free(log);
+}
+
+/* Hooks called by the core */
+
+int tilem_input_log_event(TilemCalc *calc, int type, int value)
+{
+	TilemInputLog *log = calc->inputlog;
+
+	if (log->mode == LOG_RECORD) {
+		write_event(log, type, value);
+		return 1;
+	}
+	else {
+		/* ignore inputs from anywhere but the log itself,
+		   until the end of the log is reached */
+		return (log->applying || !log->nexttype);
+	}
+}
+
+byte tilem_input_log_bus_byte(TilemCalc *calc, byte value)
+{
+	TilemInputLog *log = calc->inputlog;
+
+	if (log->mode == LOG_RECORD) {
+		write_event(log, TILEM_INPUT_INTERRUPT_BUS, value);
+		return value;
+	}
+
+	update_clock(log);
+
+	if (log->nexttype != TILEM_INPUT_INTERRUPT_BUS
+	    || log->nexttime != log->now) {
+		/* give up - nothing after this point can be
+		   trusted */
+		tilem_warning(calc, _("Replay out of sync at PC=%04X"),
+		              calc->z80.r.pc.w.l);
+		log->error = 1;
+		log->nexttype = 0;
+		tilem_z80_stop(calc, TILEM_STOP_REPLAY_END);
+		schedule_next(log);
+		return value;
+	}
+
+	value = log->nextvalue;
+	log->evtime = log->nexttime;
+	if (!read_event(log))
+		tilem_z80_stop(calc, TILEM_STOP_REPLAY_END);
+	schedule_next(log);
+	return value;
+}
+
+void tilem_input_log_run_begin(TilemCalc *calc)
+{
+	TilemInputLog *log = calc->inputlog;
+
+	if (log->mode == LOG_RECORD) {
+		if (calc->battery != log->battery) {
+			log->battery = calc->battery;
+			write_event(log, TILEM_INPUT_BATTERY, log->battery);
+		}
+		if (calc->linkport.linkemu != log->linkemu) {
+			log->linkemu = calc->linkport.linkemu;
+			write_event(log, TILEM_INPUT_LINK_EMULATOR,
+			            log->linkemu);
+		}
+	}
+	else if (log->nexttype) {
+		/* settings made by the application are overridden
+		   by those in the log */
+		calc->battery = log->battery;
+		calc->linkport.linkemu = log->linkemu;
+	}
+
+	log->running = 1;
+}
+
+void tilem_input_log_run_end(TilemCalc *calc)
+{
+	calc->inputlog->running = 0;
+}
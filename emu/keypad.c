@@ -66,6 +66,10 @@ byte tilem_keypad_read_keys(TilemCalc* calc)
 
 void tilem_keypad_press_key(TilemCalc* calc, int scancode)
 {
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_KEY_PRESS, scancode))
+		return;
+
 	if (scancode == TILEM_KEY_ON) {
 		if (!calc->keypad.onkeydown && calc->keypad.onkeyint)
 			calc->z80.interrupts |= TILEM_INTERRUPT_ON_KEY;
@@ -79,6 +83,10 @@ void tilem_keypad_press_key(TilemCalc* calc, int scancode)
 
 void tilem_keypad_release_key(TilemCalc* calc, int scancode)
 {
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_KEY_RELEASE, scancode))
+		return;
+
 	if (scancode == TILEM_KEY_ON) {
 		if (calc->keypad.onkeydown && calc->keypad.onkeyint)
 			calc->z80.interrupts |= TILEM_INTERRUPT_ON_KEY;
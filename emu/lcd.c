@@ -24,6 +24,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include "tilem.h"
 
 #ifdef DISABLE_LCD_DRIVER_DELAY
@@ -86,6 +87,60 @@ void tilem_lcd_delay_timer(TilemCalc* calc, void* data TILEM_ATTR_UNUSED)
 	calc->lcd.busy = 0;
 }
 
+void tilem_lcd_changed(TilemCalc* calc)
+{
+	calc->z80.lastlcdwrite = calc->z80.clock;
+	if (calc->lcd.changefunc)
+		(*calc->lcd.changefunc)(calc, calc->lcd.changedata, -1, 0);
+}
+
+void tilem_lcd_byte_changed(TilemCalc* calc, int ofs, byte value)
+{
+	calc->z80.lastlcdwrite = calc->z80.clock;
+	if (calc->lcd.changefunc)
+		(*calc->lcd.changefunc)(calc, calc->lcd.changedata, ofs, value);
+}
+
+/* Report a change to byte OFS of T6A04 memory, translating it to
+   the corresponding byte of the screen image (see
+   tilem_lcd_t6a04_get_data) */
+static void t6a04_byte_changed(TilemCalc* calc, int ofs)
+{
+	int width = calc->hw.lcdwidth / 8;
+	int stride = calc->lcd.rowstride;
+	int row = (ofs / stride - calc->lcd.rowshift + 64) % 64;
+	int col = ofs % stride;
+
+	if (row < calc->hw.lcdheight && col < width)
+		tilem_lcd_byte_changed(calc, row * width + col,
+		                       calc->lcdmem[ofs]);
+	else
+		calc->z80.lastlcdwrite = calc->z80.clock;
+}
+
+void tilem_lcd_t6a43_byte_changed(TilemCalc* calc, dword ofs)
+{
+	int width = calc->hw.lcdwidth / 8;
+	int stride = calc->lcd.rowstride;
+	int row = ofs / stride;
+	int col = ofs % stride;
+
+	/* the first 10 bytes of each row are shown at the left, and
+	   the rest of the row is aligned to the right (see
+	   tilem_lcd_t6a43_get_data) */
+	if (col >= 10) {
+		col += width - stride;
+		if (col < 10)
+			col = width;
+	}
+
+	if (row < calc->hw.lcdheight && col < width)
+		tilem_lcd_byte_changed(calc, row * width + col,
+		                       calc->ram[calc->lcd.addr + ofs]);
+	else
+		calc->z80.lastlcdwrite = calc->z80.clock;
+}
+
 byte tilem_lcd_t6a04_status(TilemCalc* calc)
 {
 	return (calc->lcd.busy << 7
@@ -124,7 +179,12 @@ void tilem_lcd_t6a04_control(TilemCalc* calc, byte val)
 
 	}
 
-	calc->z80.lastlcdwrite = calc->z80.clock;
+	/* only the row shift changes the screen image; other commands
+	   need not be reported to the change hook */
+	if ((val >= 0x40) && (val <= 0x7F))
+		tilem_lcd_changed(calc);
+	else
+		calc->z80.lastlcdwrite = calc->z80.clock;
 	SET_BUSY;
 }
 
@@ -136,6 +196,9 @@ byte tilem_lcd_t6a04_read(TilemCalc* calc)
 	int stride = calc->lcd.rowstride;
 	int xlimit;
 
+	if (calc->perf)
+		calc->perf->mem_reads[TILEM_PERF_REGION_LCD]++;
+
 	if (BUSY) return(0);
 
 	if (calc->lcd.mode)
@@ -182,8 +245,14 @@ void tilem_lcd_t6a04_write(TilemCalc* calc, byte sprite)
 	int stride = calc->lcd.rowstride;
 	int xlimit;
 
+	if (calc->perf)
+		calc->perf->mem_writes[TILEM_PERF_REGION_LCD]++;
+
 	if (BUSY) return;
 
+	if (calc->perf)
+		calc->perf->lcd_writes++;
+
 	if (calc->lcd.mode)
 		xlimit = stride;
 	else
@@ -201,6 +270,7 @@ void tilem_lcd_t6a04_write(TilemCalc* calc, byte sprite)
 
 	if (calc->lcd.mode) {
 		*(lcdbuf + calc->lcd.x + stride * calc->lcd.y) = sprite;
+		t6a04_byte_changed(calc, calc->lcd.x + stride * calc->lcd.y);
 
 		/*****/
 		if (calc->lcd.x == 12 && calc->lcd.inc == 5) {
@@ -220,11 +290,13 @@ void tilem_lcd_t6a04_write(TilemCalc* calc, byte sprite)
 		sprite <<= 2;
 		mask = ~(0xFC >> shift);
 		*(lcdbuf + ofs) = (*(lcdbuf + ofs) & mask) | (sprite >> shift);
+		t6a04_byte_changed(calc, ofs);
 		if (shift > 2 && (col >> 3) < (stride - 1)) {
 			ofs++;
 			shift = 8 - shift;
 			mask = ~(0xFC << shift);
 			*(lcdbuf + ofs) = (*(lcdbuf + ofs) & mask) | (sprite << shift);
+			t6a04_byte_changed(calc, ofs);
 		}
 	}
 
@@ -235,7 +307,6 @@ void tilem_lcd_t6a04_write(TilemCalc* calc, byte sprite)
 		case 7: calc->lcd.x++; break;
 	}
 
-	calc->z80.lastlcdwrite = calc->z80.clock;
 	SET_BUSY;
 	return;
 }
@@ -246,12 +317,11 @@ void tilem_lcd_t6a04_get_data(TilemCalc* calc, byte* data)
 	int width = calc->hw.lcdwidth / 8;
 	byte* lcdbuf = calc->lcdmem;
 	int stride = calc->lcd.rowstride;
-	int i, j, k;
+	int i, j;
 
 	for (i = 0; i < calc->hw.lcdheight; i++) {
 		j = (i + calc->lcd.rowshift) % 64;
-		for (k = 0; k < width; k++)
-			data[k] = lcdbuf[j * stride + k];
+		memcpy(data, lcdbuf + j * stride, width);
 		data += width;
 	}
 }
@@ -263,13 +333,18 @@ void tilem_lcd_t6a43_get_data(TilemCalc* calc, byte* data)
 	int stride = calc->lcd.rowstride;
 	int i, j;
 
+	/* the first 10 bytes of each row are shown at the left, and
+	   the rest of the row is aligned to the right, leaving a blank
+	   gap if the row is shorter than the display */
+	j = 10 + width - stride;
+	if (j < 10)
+		j = 10;
+
 	for (i = 0; i < calc->hw.lcdheight; i++) {
-		for (j = 0; j < 10; j++)
-			data[j] = lcdbuf[j];
-		for (; j < 10 + width - stride; j++)
-			data[j] = 0;
-		for (; j < width; j++)
-			data[j] = lcdbuf[j + stride - width];
+		memcpy(data, lcdbuf, 10);
+		memset(data + 10, 0, j - 10);
+		if (j < width)
+			memcpy(data + j, lcdbuf + j + stride - width, width - j);
 
 		data += width;
 		lcdbuf += stride;
@@ -396,6 +396,11 @@ void tilem_linkport_set_mode(TilemCalc* calc, unsigned int mode)
 
 void tilem_linkport_blacklink_set_lines(TilemCalc* calc, byte lines)
 {
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_BLACKLINK_LINES,
+	                              lines & 3))
+		return;
+
 	dbus_set_extlines(calc, lines & 3);
 	dbus_update(calc);
 }
@@ -411,6 +416,10 @@ byte tilem_linkport_blacklink_get_lines(TilemCalc* calc)
 
 void tilem_linkport_graylink_reset(TilemCalc* calc)
 {
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_GRAYLINK_RESET, 0))
+		return;
+
 	calc->linkport.graylinkin = 0;
 	calc->linkport.graylinkinbits = 0;
 	calc->linkport.graylinkout = 0;
@@ -433,6 +442,10 @@ int tilem_linkport_graylink_send_byte(TilemCalc* calc, byte value)
 	if (!tilem_linkport_graylink_ready(calc))
 		return -1;
 
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_GRAYLINK_SEND, value))
+		return -1;
+
 	dbus_set_extlines(calc, 0);
 
 	/* set to 9 because we want to wait for the calc to bring both
@@ -451,6 +464,11 @@ int tilem_linkport_graylink_get_byte(TilemCalc* calc)
 	if (calc->linkport.graylinkinbits != 8)
 		return -1;
 
+	if (calc->inputlog
+	    && !tilem_input_log_event(calc, TILEM_INPUT_GRAYLINK_GET,
+	                              calc->linkport.graylinkin))
+		return -1;
+
 	calc->linkport.graylinkinbits = 0;
 	return calc->linkport.graylinkin;
 }
@@ -38,16 +38,245 @@ void tilem_lcd_buffer_free(TilemLCDBuffer *buf)
 	tilem_free(buf);
 }
 
-void tilem_lcd_get_frame(TilemCalc * restrict calc,
-                         TilemLCDBuffer * restrict buf)
+void tilem_lcd_buffer_copy(TilemLCDBuffer *dest, const TilemLCDBuffer *src)
+{
+	unsigned int size = src->rowstride * src->height;
+
+	if (dest->rowstride * dest->height != size) {
+		tilem_free(dest->data);
+		dest->data = tilem_new_atomic(byte, size);
+	}
+
+	dest->width = src->width;
+	dest->height = src->height;
+	dest->rowstride = src->rowstride;
+	dest->contrast = src->contrast;
+	dest->format = src->format;
+	dest->stamp = src->stamp;
+	if (size)
+		memcpy(dest->data, src->data, size);
+	memcpy(dest->dirty, src->dirty, sizeof(dest->dirty));
+	dest->hash = src->hash;
+	dest->hashvalid = src->hashvalid;
+}
+
+/* Image hashing, using the round and avalanche functions of
+   xxHash64 (four independent lanes per row, so the multiplications
+   can overlap) */
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
+
+static inline qword hash_rotl(qword x, int n)
+{
+	return (x << n) | (x >> (64 - n));
+}
+
+static inline qword hash_round(qword acc, qword input)
+{
+	acc += input * HASH_PRIME2;
+	acc = hash_rotl(acc, 31);
+	return acc * HASH_PRIME1;
+}
+
+static inline qword hash_read(const byte *p)
+{
+	qword v;
+	memcpy(&v, p, 8);
+#ifdef WORDS_BIGENDIAN
+	v = (((v & 0x00000000000000ffULL) << 56)
+	     | ((v & 0x000000000000ff00ULL) << 40)
+	     | ((v & 0x0000000000ff0000ULL) << 24)
+	     | ((v & 0x00000000ff000000ULL) << 8)
+	     | ((v & 0x000000ff00000000ULL) >> 8)
+	     | ((v & 0x0000ff0000000000ULL) >> 24)
+	     | ((v & 0x00ff000000000000ULL) >> 40)
+	     | ((v & 0xff00000000000000ULL) >> 56));
+#endif
+	return v;
+}
+
+static qword hash_row(qword h, const byte *p, unsigned int n)
+{
+	qword v1, v2, v3, v4, tail;
+	unsigned int i;
+
+	v1 = h + HASH_PRIME1 + HASH_PRIME2;
+	v2 = h + HASH_PRIME2;
+	v3 = h;
+	v4 = h - HASH_PRIME1;
+
+	for (; n >= 32; n -= 32, p += 32) {
+		v1 = hash_round(v1, hash_read(p));
+		v2 = hash_round(v2, hash_read(p + 8));
+		v3 = hash_round(v3, hash_read(p + 16));
+		v4 = hash_round(v4, hash_read(p + 24));
+	}
+
+	h = (hash_rotl(v1, 1) + hash_rotl(v2, 7)
+	     + hash_rotl(v3, 12) + hash_rotl(v4, 18));
+
+	for (; n >= 8; n -= 8, p += 8)
+		h = hash_rotl(h ^ hash_round(0, hash_read(p)), 27)
+			* HASH_PRIME1 + HASH_PRIME4;
+
+	tail = n;
+	for (i = 0; i < n; i++)
+		tail = (tail << 8) | p[i];
+	return hash_rotl(h ^ (tail * HASH_PRIME5), 11) * HASH_PRIME1;
+}
+
+qword tilem_lcd_buffer_hash(const TilemLCDBuffer *buf)
+{
+	unsigned int rowbytes;
+	qword h;
+	int y;
+
+	switch (buf->format) {
+	case TILEM_LCD_BUF_SRGB_63:   rowbytes = buf->width * 3; break;
+	default:                      rowbytes = buf->width; break;
+	}
+
+	h = (HASH_PRIME5 + ((qword) buf->width << 32)
+	     + ((qword) buf->height << 16)
+	     + ((qword) buf->format << 8) + buf->contrast);
+
+	for (y = 0; y < buf->height; y++)
+		h = hash_row(h, buf->data + y * buf->rowstride, rowbytes);
+
+	h ^= h >> 33;
+	h *= HASH_PRIME2;
+	h ^= h >> 29;
+	h *= HASH_PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+void tilem_lcd_buffer_update(TilemLCDBuffer *buf)
+{
+	/* recompute the hash only if the image has changed */
+	if (!buf->hashvalid) {
+		buf->hash = tilem_lcd_buffer_hash(buf);
+		buf->hashvalid = 1;
+	}
+}
+
+#define DIRTY_BIT(y) ((y) < TILEM_LCD_BUF_DIRTY_ROWS \
+                      ? (y) : TILEM_LCD_BUF_DIRTY_ROWS - 1)
+
+void tilem_lcd_buffer_set_dirty(TilemLCDBuffer *buf, int ystart, int yend)
+{
+	int i;
+
+	if (ystart >= yend)
+		return;
+
+	buf->hashvalid = 0;
+	for (i = DIRTY_BIT(ystart); i <= DIRTY_BIT(yend - 1); i++)
+		buf->dirty[i / 32] |= (dword) 1 << (i % 32);
+}
+
+void tilem_lcd_buffer_clear_dirty(TilemLCDBuffer *buf)
+{
+	memset(buf->dirty, 0, sizeof(buf->dirty));
+}
+
+static int row_dirty(const TilemLCDBuffer *buf, int y)
+{
+	int i = DIRTY_BIT(y);
+	return ((buf->dirty[i / 32] >> (i % 32)) & 1);
+}
+
+int tilem_lcd_buffer_get_dirty_rows(const TilemLCDBuffer *buf, int start,
+                                    int *ystart, int *yend)
+{
+	int y;
+
+	for (y = start; y < buf->height; y++) {
+		if (row_dirty(buf, y)) {
+			*ystart = y;
+			while (y < buf->height && row_dirty(buf, y))
+				y++;
+			*yend = y;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Set the contrast level of the buffer, and mark the whole buffer as
+   changed if it differs from the previous frame */
+static void set_contrast(TilemLCDBuffer *buf, byte contrast)
+{
+	if (buf->contrast != contrast) {
+		buf->contrast = contrast;
+		tilem_lcd_buffer_set_dirty(buf, 0, buf->height);
+	}
+}
+
+/* Pixel values for each possible byte of LCD memory (1 for black, 0
+   for white) */
+#define PX(b, n) (((b) >> (7 - (n))) & 1)
+#define PX8(b) { PX(b, 0), PX(b, 1), PX(b, 2), PX(b, 3), \
+                 PX(b, 4), PX(b, 5), PX(b, 6), PX(b, 7) }
+#define PX8x2(b) PX8(b), PX8((b) + 1)
+#define PX8x4(b) PX8x2(b), PX8x2((b) + 2)
+#define PX8x16(b) PX8x4(b), PX8x4((b) + 4), PX8x4((b) + 8), PX8x4((b) + 12)
+#define PX8x64(b) PX8x16(b), PX8x16((b) + 16), PX8x16((b) + 32), \
+                  PX8x16((b) + 48)
+
+static const byte pixel_table[256][8] = {
+	PX8x64(0), PX8x64(64), PX8x64(128), PX8x64(192)
+};
+
+/* Convert N bytes of LCD memory into 8*N pixels, each either 0 or
+   VALUE.  Each group of 8 pixels is handled as a single 64-bit word;
+   since the table entries are 0 or 1, multiplying by VALUE cannot
+   carry from one pixel into the next.  Returns nonzero if any pixel
+   differs from what was in the output buffer before. */
+static int unpack_pixels(byte * restrict op, const byte * restrict bp,
+                         unsigned int n, byte value)
+{
+	qword w, old, changed = 0;
+
+	while (n--) {
+		memcpy(&w, pixel_table[*bp++], 8);
+		w *= value;
+		memcpy(&old, op, 8);
+		changed |= old ^ w;
+		memcpy(op, &w, 8);
+		op += 8;
+	}
+
+	return (changed != 0);
+}
+
+/* Unpack the LCD image, and mark changed rows as dirty */
+static void unpack_frame(TilemLCDBuffer * restrict buf,
+                         const byte * restrict bp, int bwidth, byte value)
+{
+	byte * restrict op = buf->data;
+	int i;
+
+	for (i = 0; i < buf->height; i++) {
+		if (unpack_pixels(op, bp, bwidth, value))
+			tilem_lcd_buffer_set_dirty(buf, i, i + 1);
+		op += buf->rowstride;
+		bp += bwidth;
+	}
+}
+
+static void get_frame(TilemCalc * restrict calc,
+                      TilemLCDBuffer * restrict buf)
 {
 	byte * restrict bp;
-	byte * restrict op;
 	int dwidth = calc->hw.lcdwidth;
 	int dheight = calc->hw.lcdheight;
 	unsigned int size;
 	int bwidth = ((calc->hw.lcdwidth + 7) / 8);
-	int i, j;
 
 	if (calc->hw.get_frame) {
 		(*calc->hw.get_frame)(calc, buf);
@@ -61,6 +290,7 @@ void tilem_lcd_get_frame(TilemCalc * restrict calc,
 		buf->data = tilem_new_atomic(byte, dwidth * bwidth * 8);
 		buf->rowstride = bwidth * 8;
 		buf->height = dheight;
+		tilem_lcd_buffer_set_dirty(buf, 0, dheight);
 	}
 
 	size = bwidth * dheight * sizeof(byte);
@@ -78,36 +308,33 @@ void tilem_lcd_get_frame(TilemCalc * restrict calc,
 
 	if (!calc->lcd.active || (calc->z80.halted && !calc->poweronhalt)) {
 		/* screen is turned off */
-		buf->contrast = 0;
+		set_contrast(buf, 0);
 		return;
 	}
 
-	buf->contrast = calc->lcd.contrast;
+	set_contrast(buf, calc->lcd.contrast);
 
 	bp = buf->tmpbuf;
-	op = buf->data;
 	(*calc->hw.get_lcd)(calc, bp);
 
-	for (i = 0; i < bwidth * dheight; i++) {
-		for (j = 0; j < 8; j++) {
-			*op = (*bp << j) & 0x80;
-			op++;
-		}
-		bp++;
-	}
+	unpack_frame(buf, bp, bwidth, 0x80);
 }
 
-/* Do the same thing as tilem_lcd_get_frame, but output is only 0 and 1 */
-void tilem_lcd_get_frame1(TilemCalc * restrict calc,
+void tilem_lcd_get_frame(TilemCalc * restrict calc,
                          TilemLCDBuffer * restrict buf)
+{
+	get_frame(calc, buf);
+	tilem_lcd_buffer_update(buf);
+}
+
+static void get_frame1(TilemCalc * restrict calc,
+                       TilemLCDBuffer * restrict buf)
 {
 	byte * restrict bp;
-	byte * restrict op;
 	int dwidth = calc->hw.lcdwidth;
 	int dheight = calc->hw.lcdheight;
 	unsigned int size;
 	int bwidth = ((calc->hw.lcdwidth + 7) / 8);
-	int i, j;
 
 	if (TILEM_UNLIKELY(buf->height != dheight
 	                   || buf->rowstride != bwidth * 8)) {
@@ -116,6 +343,7 @@ void tilem_lcd_get_frame1(TilemCalc * restrict calc,
 		buf->data = tilem_new_atomic(byte, dwidth * bwidth * 8);
 		buf->rowstride = bwidth * 8;
 		buf->height = dheight;
+		tilem_lcd_buffer_set_dirty(buf, 0, dheight);
 	}
 
 	size = bwidth * dheight * sizeof(byte);
@@ -132,23 +360,22 @@ void tilem_lcd_get_frame1(TilemCalc * restrict calc,
 
 	if (!calc->lcd.active || (calc->z80.halted && !calc->poweronhalt)) {
 		/* screen is turned off */
-		buf->contrast = 0;
+		set_contrast(buf, 0);
 		return;
 	}
 
-	buf->contrast = calc->lcd.contrast;
+	set_contrast(buf, calc->lcd.contrast);
 
 	bp = buf->tmpbuf;
-	op = buf->data;
 	(*calc->hw.get_lcd)(calc, bp);
 
-	for (i = 0; i < bwidth * dheight; i++) {
-		for (j = 0; j < 8; j++) {
-			*op = (*bp << j) & 0x80;
-			if(*op != 0)
-				*op = 1;
-			op++;
-		}
-		bp++;
-	}
+	unpack_frame(buf, bp, bwidth, 1);
+}
+
+/* Do the same thing as tilem_lcd_get_frame, but output is only 0 and 1 */
+void tilem_lcd_get_frame1(TilemCalc * restrict calc,
+                         TilemLCDBuffer * restrict buf)
+{
+	get_frame1(calc, buf);
+	tilem_lcd_buffer_update(buf);
 }
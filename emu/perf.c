@@ -0,0 +1,116 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "tilem.h"
+
+void tilem_perf_counters_enable(TilemCalc* calc, int enable)
+{
+	if (enable) {
+		tilem_free(calc->perf);
+		calc->perf = tilem_new0(TilemPerfCounters, 1);
+	}
+	else {
+		tilem_free(calc->perf);
+		calc->perf = NULL;
+	}
+}
+
+void tilem_perf_counters_reset(TilemCalc* calc)
+{
+	if (calc->perf)
+		memset(calc->perf, 0, sizeof(TilemPerfCounters));
+}
+
+static void write_counter(FILE* outfile, const char* name, int index,
+                          qword value)
+{
+	if (index < 0)
+		fprintf(outfile, "%s %llu\n", name, (unsigned long long) value);
+	else if (value)
+		fprintf(outfile, "%s.%d %llu\n", name, index,
+		        (unsigned long long) value);
+}
+
+static void write_port_counter(FILE* outfile, const char* name, int port,
+                               qword value)
+{
+	if (value)
+		fprintf(outfile, "%s.%02x %llu\n", name, port,
+		        (unsigned long long) value);
+}
+
+int tilem_perf_counters_write(const TilemPerfCounters* perf, FILE* outfile)
+{
+	static const char * const region_names[TILEM_PERF_NUM_REGIONS] = {
+		"flash", "ram", "lcd" };
+	char name[32];
+	int i;
+
+	write_counter(outfile, "instructions", -1, perf->instructions);
+	write_counter(outfile, "cycles", -1, perf->cycles);
+	write_counter(outfile, "halt_cycles", -1, perf->halt_cycles);
+	write_counter(outfile, "interrupts", -1, perf->interrupts);
+
+	for (i = 0; i < TILEM_PERF_MAX_TIMERS; i++)
+		write_counter(outfile, "timer_callbacks", i,
+		              perf->timer_callbacks[i]);
+
+	if (perf->breakpoint_checks)
+		write_counter(outfile, "breakpoint_checks", -1,
+		              perf->breakpoint_checks);
+	if (perf->breakpoint_hits)
+		write_counter(outfile, "breakpoint_hits", -1,
+		              perf->breakpoint_hits);
+
+	for (i = 0; i < TILEM_PERF_NUM_REGIONS; i++) {
+		if (perf->mem_reads[i]) {
+			sprintf(name, "mem_reads.%s", region_names[i]);
+			write_counter(outfile, name, -1, perf->mem_reads[i]);
+		}
+		if (perf->mem_writes[i]) {
+			sprintf(name, "mem_writes.%s", region_names[i]);
+			write_counter(outfile, name, -1, perf->mem_writes[i]);
+		}
+	}
+
+	for (i = 0; i < 256; i++)
+		write_port_counter(outfile, "port_reads", i,
+		                   perf->port_reads[i]);
+	for (i = 0; i < 256; i++)
+		write_port_counter(outfile, "port_writes", i,
+		                   perf->port_writes[i]);
+
+	if (perf->lcd_writes)
+		write_counter(outfile, "lcd_writes", -1, perf->lcd_writes);
+	if (perf->flash_programs)
+		write_counter(outfile, "flash_programs", -1,
+		              perf->flash_programs);
+	if (perf->flash_erases)
+		write_counter(outfile, "flash_erases", -1,
+		              perf->flash_erases);
+
+	return (ferror(outfile) ? -1 : 0);
+}
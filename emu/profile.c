@@ -0,0 +1,557 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tilem.h"
+
+/*
+
+ The profiler keeps a shadow copy of the call stack.  Each CALL or
+ RST that is taken pushes a new frame, and each RET that is taken
+ pops every frame whose return address lies at or below the stack
+ pointer (so that frames abandoned by resetting SP, or by popping a
+ return address and jumping, are eventually discarded as well.)
+ Accepting an interrupt is treated as a call to the service routine.
+
+ A "function" is identified by the physical address at which it was
+ entered, or, for an RST that is followed by an inline ROM call
+ number (B_CALL), by that number.
+
+ Costs are kept in two hash tables: one mapping (function, physical
+ PC) to the number of instructions and clock cycles spent there, and
+ one mapping (caller, call site, callee) to the number of calls and
+ the total inclusive cost.  Both tables use open addressing; a slot
+ is unused if its function index is zero.
+
+*/
+
+#define MAX_DEPTH 256
+
+#define ROOT_FUNC    0xffffffff
+#define ROMCALL_FUNC 0x80000000
+
+typedef struct _ProfFunc {
+	dword key;		/* physical address or ROMCALL_FUNC|number */
+	dword addr;		/* logical address or ROM call number */
+} ProfFunc;
+
+typedef struct _ProfCost {
+	dword func;		/* function index + 1 */
+	dword pc;		/* physical address */
+	qword count;
+	qword cycles;
+} ProfCost;
+
+typedef struct _ProfEdge {
+	dword caller;		/* function index + 1 */
+	dword site;		/* physical address of call */
+	dword callee;		/* function index + 1 */
+	qword calls;
+	qword count;
+	qword cycles;
+} ProfEdge;
+
+typedef struct _ProfFrame {
+	int func;
+	dword site;
+	word sp;		/* location of return address */
+	qword count;		/* totals when the frame was entered */
+	qword cycles;
+} ProfFrame;
+
+struct _TilemProfile {
+	TilemCalc* calc;
+	int romcallrst;
+
+	/* Instruction currently being executed */
+	int pending;
+	word pc;
+	word sp;
+	dword clock;
+
+	/* Totals */
+	qword count;
+	qword cycles;
+
+	int nfuncs;
+	int nfuncs_a;
+	ProfFunc* funcs;
+	int* functab;		/* 2 * nfuncs_a entries */
+
+	int ncosts;
+	int ncosts_a;
+	ProfCost* costs;
+
+	int nedges;
+	int nedges_a;
+	ProfEdge* edges;
+
+	int depth;
+	ProfFrame stack[MAX_DEPTH];
+};
+
+static dword hash3(dword a, dword b, dword c)
+{
+	a = a * 0x9e3779b1u + b;
+	a = (a ^ (a >> 15)) * 0x85ebca77u + c;
+	a = (a ^ (a >> 13)) * 0xc2b2ae3du;
+	return a ^ (a >> 16);
+}
+
+static void rehash_funcs(TilemProfile* prof)
+{
+	dword h, mask = prof->nfuncs_a * 2 - 1;
+	int i;
+
+	memset(prof->functab, 0xff, prof->nfuncs_a * 2 * sizeof(int));
+	for (i = 0; i < prof->nfuncs; i++) {
+		h = hash3(prof->funcs[i].key, 0, 0) & mask;
+		while (prof->functab[h] >= 0)
+			h = (h + 1) & mask;
+		prof->functab[h] = i;
+	}
+}
+
+/* Find or create a function entry */
+static int get_func(TilemProfile* prof, dword key, dword addr)
+{
+	dword h, mask;
+	int i;
+
+	if (prof->nfuncs >= prof->nfuncs_a) {
+		prof->nfuncs_a *= 2;
+		prof->funcs = tilem_renew(ProfFunc, prof->funcs,
+		                          prof->nfuncs_a);
+		tilem_free(prof->functab);
+		prof->functab = tilem_new(int, prof->nfuncs_a * 2);
+		rehash_funcs(prof);
+	}
+
+	mask = prof->nfuncs_a * 2 - 1;
+	h = hash3(key, 0, 0) & mask;
+	while ((i = prof->functab[h]) >= 0) {
+		if (prof->funcs[i].key == key)
+			return i;
+		h = (h + 1) & mask;
+	}
+
+	i = prof->nfuncs++;
+	prof->funcs[i].key = key;
+	prof->funcs[i].addr = addr;
+	prof->functab[h] = i;
+	return i;
+}
+
+/* Find or create a cost entry */
+static ProfCost* get_cost(TilemProfile* prof, dword func, dword pc)
+{
+	ProfCost *old, *c;
+	dword h, mask;
+	int i, n;
+
+	if (prof->ncosts * 2 >= prof->ncosts_a) {
+		old = prof->costs;
+		n = prof->ncosts_a;
+		prof->ncosts_a *= 2;
+		prof->costs = tilem_new0(ProfCost, prof->ncosts_a);
+		mask = prof->ncosts_a - 1;
+		for (i = 0; i < n; i++) {
+			if (!old[i].func)
+				continue;
+			h = hash3(old[i].func, old[i].pc, 0) & mask;
+			while (prof->costs[h].func)
+				h = (h + 1) & mask;
+			prof->costs[h] = old[i];
+		}
+		tilem_free(old);
+	}
+
+	mask = prof->ncosts_a - 1;
+	h = hash3(func, pc, 0) & mask;
+	while ((c = &prof->costs[h])->func) {
+		if (c->func == func && c->pc == pc)
+			return c;
+		h = (h + 1) & mask;
+	}
+
+	prof->ncosts++;
+	c->func = func;
+	c->pc = pc;
+	return c;
+}
+
+/* Find or create a call graph edge */
+static ProfEdge* get_edge(TilemProfile* prof, dword caller, dword site,
+                          dword callee)
+{
+	ProfEdge *old, *e;
+	dword h, mask;
+	int i, n;
+
+	if (prof->nedges * 2 >= prof->nedges_a) {
+		old = prof->edges;
+		n = prof->nedges_a;
+		prof->nedges_a *= 2;
+		prof->edges = tilem_new0(ProfEdge, prof->nedges_a);
+		mask = prof->nedges_a - 1;
+		for (i = 0; i < n; i++) {
+			if (!old[i].caller)
+				continue;
+			h = hash3(old[i].caller, old[i].site,
+			          old[i].callee) & mask;
+			while (prof->edges[h].caller)
+				h = (h + 1) & mask;
+			prof->edges[h] = old[i];
+		}
+		tilem_free(old);
+	}
+
+	mask = prof->nedges_a - 1;
+	h = hash3(caller, site, callee) & mask;
+	while ((e = &prof->edges[h])->caller) {
+		if (e->caller == caller && e->site == site
+		    && e->callee == callee)
+			return e;
+		h = (h + 1) & mask;
+	}
+
+	prof->nedges++;
+	e->caller = caller;
+	e->site = site;
+	e->callee = callee;
+	return e;
+}
+
+static int cur_func(const TilemProfile* prof)
+{
+	return prof->stack[prof->depth - 1].func;
+}
+
+static void add_cost(TilemProfile* prof, dword pc, dword count,
+                     dword cycles)
+{
+	ProfCost* c = get_cost(prof, cur_func(prof) + 1, pc);
+	c->count += count;
+	c->cycles += cycles;
+	prof->count += count;
+	prof->cycles += cycles;
+}
+
+static void push_frame(TilemProfile* prof, dword site, dword key,
+                       dword addr)
+{
+	ProfFrame* f;
+
+	if (prof->depth >= MAX_DEPTH)
+		return;
+
+	f = &prof->stack[prof->depth++];
+	f->func = get_func(prof, key, addr);
+	f->site = site;
+	f->sp = prof->calc->z80.r.sp.w.l;
+	f->count = prof->count;
+	f->cycles = prof->cycles;
+}
+
+static void pop_frame(TilemProfile* prof)
+{
+	ProfFrame* f = &prof->stack[--prof->depth];
+	ProfEdge* e;
+
+	e = get_edge(prof, cur_func(prof) + 1, f->site, f->func + 1);
+
+	e->calls++;
+	e->count += prof->count - f->count;
+	e->cycles += prof->cycles - f->cycles;
+}
+
+static dword read_word(TilemCalc* calc, word addr)
+{
+	dword v;
+	v = calc->mem[(*calc->hw.mem_ltop)(calc, addr)];
+	v |= calc->mem[(*calc->hw.mem_ltop)(calc, (word) (addr + 1))] << 8;
+	return v;
+}
+
+/* Begin a new frame for a CALL or RST instruction */
+static void enter_call(TilemProfile* prof, dword site, dword op)
+{
+	TilemCalc* calc = prof->calc;
+	dword num;
+	word pc;
+
+	if ((int) op == prof->romcallrst) {
+		num = read_word(calc, prof->pc + 1);
+		push_frame(prof, site, ROMCALL_FUNC | num, num);
+	}
+	else {
+		pc = calc->z80.r.pc.w.l;
+		push_frame(prof, site, (*calc->hw.mem_ltop)(calc, pc), pc);
+	}
+}
+
+TilemProfile* tilem_profile_new(TilemCalc* calc, int romcallrst)
+{
+	TilemProfile* prof;
+
+	prof = tilem_new0(TilemProfile, 1);
+	prof->calc = calc;
+	prof->romcallrst = romcallrst;
+
+	prof->nfuncs_a = 64;
+	prof->funcs = tilem_new(ProfFunc, prof->nfuncs_a);
+	prof->functab = tilem_new(int, prof->nfuncs_a * 2);
+	rehash_funcs(prof);
+
+	prof->ncosts_a = 1024;
+	prof->costs = tilem_new0(ProfCost, prof->ncosts_a);
+
+	prof->nedges_a = 256;
+	prof->edges = tilem_new0(ProfEdge, prof->nedges_a);
+
+	prof->stack[0].func = get_func(prof, ROOT_FUNC, 0);
+	prof->depth = 1;
+
+	calc->profile = prof;
+	return prof;
+}
+
+void tilem_profile_detach(TilemProfile* prof)
+{
+	if (prof->calc && prof->calc->profile == prof)
+		prof->calc->profile = NULL;
+	prof->calc = NULL;
+	prof->pending = 0;
+}
+
+void tilem_profile_free(TilemProfile* prof)
+{
+	tilem_profile_detach(prof);
+	tilem_free(prof->funcs);
+	tilem_free(prof->functab);
+	tilem_free(prof->costs);
+	tilem_free(prof->edges);
+	tilem_free(prof);
+}
+
+/* Hooks called by the CPU core */
+
+void tilem_profile_instr_begin(TilemCalc* calc)
+{
+	TilemProfile* prof = calc->profile;
+
+	prof->pending = 1;
+	prof->pc = calc->z80.r.pc.w.l;
+	prof->sp = calc->z80.r.sp.w.l;
+	prof->clock = calc->z80.clock;
+}
+
+void tilem_profile_instr_end(TilemCalc* calc, dword op)
+{
+	TilemProfile* prof = calc->profile;
+	word sp = calc->z80.r.sp.w.l;
+	dword site;
+
+	if (!prof->pending)
+		return;
+	prof->pending = 0;
+
+	site = (*calc->hw.mem_ltop)(calc, prof->pc);
+	add_cost(prof, site, 1, calc->z80.clock - prof->clock);
+	prof->clock = calc->z80.clock;
+
+	/* (op & ~0x38) leaves the prefix bits intact, so only
+	   unprefixed instructions can match 0xc0, 0xc4, or 0xc7 */
+
+	if (op == 0xcd || (op & ~0x38) == 0xc4) {
+		/* CALL - taken if the return address was pushed */
+		if (sp == (word) (prof->sp - 2))
+			enter_call(prof, site, op);
+	}
+	else if ((op & ~0x38) == 0xc7) {
+		/* RST */
+		enter_call(prof, site, op);
+	}
+	else if (op == 0xc9 || (op & ~0x38) == 0xc0
+	         || (op & ~0x38) == 0xed45) {
+		/* RET, RETI, or RETN - taken if the return address
+		   was popped */
+		if (sp == (word) (prof->sp + 2)) {
+			while (prof->depth > 1
+			       && prof->stack[prof->depth - 1].sp <= prof->sp)
+				pop_frame(prof);
+		}
+	}
+}
+
+void tilem_profile_interrupt(TilemCalc* calc)
+{
+	TilemProfile* prof = calc->profile;
+	word pc = calc->z80.r.pc.w.l;
+	dword site, entry;
+
+	site = (*calc->hw.mem_ltop)(calc, read_word(calc, calc->z80.r.sp.w.l));
+	entry = (*calc->hw.mem_ltop)(calc, pc);
+	push_frame(prof, site, entry, pc);
+	add_cost(prof, entry, 0, calc->z80.clock - prof->clock);
+	prof->clock = calc->z80.clock;
+}
+
+/* Output */
+
+static int cmp_costs(const void* a, const void* b)
+{
+	const ProfCost *ca = a, *cb = b;
+	if (ca->func != cb->func)
+		return (ca->func < cb->func ? -1 : 1);
+	if (ca->pc != cb->pc)
+		return (ca->pc < cb->pc ? -1 : 1);
+	return 0;
+}
+
+static int cmp_edges(const void* a, const void* b)
+{
+	const ProfEdge *ea = a, *eb = b;
+	if (ea->caller != eb->caller)
+		return (ea->caller < eb->caller ? -1 : 1);
+	if (ea->site != eb->site)
+		return (ea->site < eb->site ? -1 : 1);
+	if (ea->callee != eb->callee)
+		return (ea->callee < eb->callee ? -1 : 1);
+	return 0;
+}
+
+/* Write a function name in callgrind's compressed form: the full
+   name the first time, and only the ID afterwards */
+static void write_func_name(const TilemProfile* prof, FILE* f,
+                            int i, char* written,
+                            TilemProfileNameFunc namefunc, void* data)
+{
+	const ProfFunc* fn = &prof->funcs[i];
+	const char* name = NULL;
+
+	fprintf(f, "(%d)", i + 1);
+	if (written[i]) {
+		fputc('\n', f);
+		return;
+	}
+	written[i] = 1;
+
+	if (fn->key == ROOT_FUNC) {
+		fputs(" (unknown)\n", f);
+		return;
+	}
+
+	if (namefunc)
+		name = (*namefunc)(data, fn->addr,
+		                   (fn->key & ROMCALL_FUNC) != 0);
+
+	if (name)
+		fprintf(f, " %s\n", name);
+	else if (fn->key & ROMCALL_FUNC)
+		fprintf(f, " romcall_%04X\n", fn->addr);
+	else
+		fprintf(f, " sub_%04X_%06X\n", fn->addr, fn->key);
+}
+
+int tilem_profile_write_callgrind(TilemProfile* prof, FILE* outfile,
+                                  const char* cmd,
+                                  TilemProfileNameFunc namefunc,
+                                  void* data)
+{
+	ProfCost* costs;
+	ProfEdge* edges;
+	char* written;
+	int nc, ne, i, j, k;
+	dword fn;
+
+	/* count calls that are still in progress */
+	while (prof->depth > 1)
+		pop_frame(prof);
+
+	costs = tilem_new(ProfCost, prof->ncosts + 1);
+	for (i = nc = 0; i < prof->ncosts_a; i++)
+		if (prof->costs[i].func)
+			costs[nc++] = prof->costs[i];
+	qsort(costs, nc, sizeof(ProfCost), &cmp_costs);
+
+	edges = tilem_new(ProfEdge, prof->nedges + 1);
+	for (i = ne = 0; i < prof->nedges_a; i++)
+		if (prof->edges[i].caller)
+			edges[ne++] = prof->edges[i];
+	qsort(edges, ne, sizeof(ProfEdge), &cmp_edges);
+
+	written = tilem_new0(char, prof->nfuncs);
+
+	fprintf(outfile, "# callgrind format\n");
+	fprintf(outfile, "version: 1\n");
+	fprintf(outfile, "creator: TilEm\n");
+	if (cmd)
+		fprintf(outfile, "cmd: %s\n", cmd);
+	fprintf(outfile, "positions: instr\n");
+	fprintf(outfile, "events: Instructions Cycles\n");
+	fprintf(outfile, "summary: %llu %llu\n\n",
+	        (unsigned long long) prof->count,
+	        (unsigned long long) prof->cycles);
+
+	i = j = 0;
+	while (i < nc || j < ne) {
+		if (j >= ne || (i < nc && costs[i].func <= edges[j].caller))
+			fn = costs[i].func;
+		else
+			fn = edges[j].caller;
+
+		fputs("fn=", outfile);
+		write_func_name(prof, outfile, fn - 1, written, namefunc, data);
+
+		for (; i < nc && costs[i].func == fn; i++)
+			fprintf(outfile, "0x%06X %llu %llu\n", costs[i].pc,
+			        (unsigned long long) costs[i].count,
+			        (unsigned long long) costs[i].cycles);
+
+		for (; j < ne && edges[j].caller == fn; j++) {
+			k = edges[j].callee - 1;
+			fputs("cfn=", outfile);
+			write_func_name(prof, outfile, k, written,
+			                namefunc, data);
+			fprintf(outfile, "calls=%llu 0x%06X\n",
+			        (unsigned long long) edges[j].calls,
+			        ((prof->funcs[k].key & ROMCALL_FUNC)
+			         ? 0 : prof->funcs[k].key));
+			fprintf(outfile, "0x%06X %llu %llu\n", edges[j].site,
+			        (unsigned long long) edges[j].count,
+			        (unsigned long long) edges[j].cycles);
+		}
+
+		fputc('\n', outfile);
+	}
+
+	tilem_free(costs);
+	tilem_free(edges);
+	tilem_free(written);
+
+	return (ferror(outfile) ? -1 : 0);
+}
@@ -37,6 +37,11 @@ typedef uint64_t qword;
 typedef struct _TilemHardware TilemHardware;
 typedef struct _TilemCalc TilemCalc;
 typedef struct _TilemLCDBuffer TilemLCDBuffer;
+typedef struct _TilemInputLog TilemInputLog;
+typedef struct _TilemProfile TilemProfile;
+typedef struct _TilemTrace TilemTrace;
+typedef struct _TilemPerfCounters TilemPerfCounters;
+typedef struct _TilemVideoWriter TilemVideoWriter;
 
 /* Useful macros */
 #if __GNUC__ >= 3
@@ -181,7 +186,8 @@ enum {
 	TILEM_STOP_LINK_READ_BYTE = 32,    /* graylink finished reading byte */
 	TILEM_STOP_LINK_WRITE_BYTE = 64,   /* graylink finished writing byte */
 	TILEM_STOP_LINK_ERROR = 128,       /* graylink encountered error */
-	TILEM_STOP_AUDIO_BUFFER = 256	   /* audio filter filled buffer */
+	TILEM_STOP_AUDIO_BUFFER = 256,	   /* audio filter filled buffer */
+	TILEM_STOP_REPLAY_END = 512	   /* input log replay finished */
 };
 
 /* Types of interrupt */
@@ -429,6 +435,14 @@ typedef struct _TilemLCD {
 	int x, y;		/* Current position */
 	int rowshift;		/* Starting row for display */
 	byte busy;
+
+	/* Function called whenever the screen image (as returned by
+	   get_lcd) may have changed.  OFS is the index of the changed
+	   byte in the image, and VALUE its new contents; if OFS is -1,
+	   any part of the image may have changed.  See
+	   tilem_lcd_changed and tilem_lcd_byte_changed. */
+	void (*changefunc)(TilemCalc* calc, void* data, int ofs, byte value);
+	void* changedata;
 } TilemLCD;
 
 /* Reset LCD driver */
@@ -455,6 +469,20 @@ void tilem_lcd_t6a43_get_data(TilemCalc* calc, byte* data);
 /* Callback for TILEM_TIMER_LCD_DELAY */
 void tilem_lcd_delay_timer(TilemCalc* calc, void* data);
 
+/* Record that the LCD contents or settings have changed.  Drivers
+   must call this after every change that may affect the display,
+   unless the change is limited to a single byte of the screen image,
+   in which case they may call tilem_lcd_byte_changed instead. */
+void tilem_lcd_changed(TilemCalc* calc);
+
+/* Record that byte OFS of the screen image (as returned by get_lcd)
+   has changed to VALUE. */
+void tilem_lcd_byte_changed(TilemCalc* calc, int ofs, byte value);
+
+/* Record a change to byte OFS (relative to lcd.addr) of T6A43 display
+   memory */
+void tilem_lcd_t6a43_byte_changed(TilemCalc* calc, dword ofs);
+
 
 
 /* DBUS link port driver */
@@ -807,6 +835,12 @@ struct _TilemCalc {
 	byte battery;		/* Battery level (units of 0.1 V) */
 
 	dword* hwregs;
+
+	TilemInputLog* inputlog; /* Input log being recorded or
+				    replayed (if any) */
+	TilemProfile* profile;	 /* Active profiler (if any) */
+	TilemTrace* trace;	 /* Active execution trace (if any) */
+	TilemPerfCounters* perf; /* Performance counters (if enabled) */
 };
 
 /* Get a list of supported hardware models */
@@ -851,12 +885,20 @@ enum {
 				   an integer factor */
 };
 
-/* LCD buffer formats */
+/* LCD buffer formats.  There are deliberately no packed display
+   formats (such as RGB565 or XRGB8888): images are scaled before
+   they are displayed or saved, and the scaling functions below
+   already write packed pixels (see tilem_draw_lcd_image_xrgb_rows),
+   so a packed frame would only add a conversion pass. */
 enum {
 	TILEM_LCD_BUF_BLACK_128, /* Linear black 0-128 */
 	TILEM_LCD_BUF_SRGB_63    /* sRGB 0-63 */
 };
 
+/* Maximum number of rows tracked individually by the dirty mask of a
+   TilemLCDBuffer; any further rows share the last bit */
+#define TILEM_LCD_BUF_DIRTY_ROWS 256
+
 /* Buffer representing a snapshot of the LCD state */
 struct _TilemLCDBuffer {
 	word width;             /* Width of LCD */
@@ -868,6 +910,13 @@ struct _TilemLCDBuffer {
 	dword tmpbufsize;       /* Size of temporary buffer */
 	byte *data;             /* Image data (rowstride*height bytes) */
 	void *tmpbuf;           /* Temporary buffer used for scaling */
+	dword dirty[TILEM_LCD_BUF_DIRTY_ROWS / 32];
+	                        /* Rows changed since the mask was
+	                           last cleared (one bit per row) */
+
+	qword hash;             /* Hash of the image (see
+	                           tilem_lcd_buffer_hash) */
+	int hashvalid;          /* Hash is up to date */
 };
 
 /* Create new TilemLCDBuffer. */
@@ -877,8 +926,38 @@ TilemLCDBuffer* tilem_lcd_buffer_new(void)
 /* Free  a TilemLCDBuffer. */
 void tilem_lcd_buffer_free(TilemLCDBuffer *buf);
 
+/* Mark rows YSTART through YEND - 1 of the buffer as changed. */
+void tilem_lcd_buffer_set_dirty(TilemLCDBuffer *buf, int ystart, int yend);
+
+/* Mark all rows of the buffer as unchanged. */
+void tilem_lcd_buffer_clear_dirty(TilemLCDBuffer *buf);
+
+/* Copy the image, contrast, timestamp, and dirty mask of SRC into
+   DEST. */
+void tilem_lcd_buffer_copy(TilemLCDBuffer *dest, const TilemLCDBuffer *src);
+
+/* Update BUF's hash after its image has changed.  (For use by frame
+   extraction functions.) */
+void tilem_lcd_buffer_update(TilemLCDBuffer *buf);
+
+/* Compute a 64-bit hash of the image, including its size, format,
+   and contrast level.  The frame extraction functions store this in
+   BUF->hash, recomputing it only if rows have changed, so consumers
+   can cheaply skip frames identical to ones they have already
+   seen. */
+qword tilem_lcd_buffer_hash(const TilemLCDBuffer *buf);
+
+/* Find the first group of consecutive changed rows, beginning at or
+   after row START.  If there is one, set *YSTART and *YEND to the
+   first changed row and the row after the last, and return 1;
+   otherwise return 0. */
+int tilem_lcd_buffer_get_dirty_rows(const TilemLCDBuffer *buf, int start,
+                                    int *ystart, int *yend);
+
 /* Convert current LCD memory contents to a TilemLCDBuffer (i.e., a
-   monochrome snapshot.) */
+   monochrome snapshot.)  Rows whose contents change are marked as
+   dirty (this is also true of the other functions that fill in a
+   TilemLCDBuffer from the emulated LCD.) */
 void tilem_lcd_get_frame(TilemCalc * restrict calc,
                          TilemLCDBuffer * restrict buf);
 
@@ -910,6 +989,32 @@ void tilem_draw_lcd_image_rgb(TilemLCDBuffer * restrict frm,
                               int pixbytes, const dword * restrict palette,
                               int scaletype);
 
+/* Same as the above functions, but only rows YSTART through YEND - 1
+   of the output image are drawn; BUFFER still points to the start of
+   the image (row 0.) */
+void tilem_draw_lcd_image_indexed_rows(TilemLCDBuffer * restrict frm,
+                                       byte * restrict buffer,
+                                       int imgwidth, int imgheight,
+                                       int rowstride, int scaletype,
+                                       int ystart, int yend);
+void tilem_draw_lcd_image_rgb_rows(TilemLCDBuffer * restrict frm,
+                                   byte * restrict buffer,
+                                   int imgwidth, int imgheight,
+                                   int rowstride, int pixbytes,
+                                   const dword * restrict palette,
+                                   int scaletype, int ystart, int yend);
+
+/* Convert and scale rows YSTART through YEND - 1 of the image to a
+   buffer of native-endian 32-bit pixels (0xFFRRGGBB), as used by
+   Cairo's CAIRO_FORMAT_RGB24 and Qt's QImage::Format_RGB32.
+   PALETTE is used only for monochrome/grayscale buffers. */
+void tilem_draw_lcd_image_xrgb_rows(TilemLCDBuffer * restrict frm,
+                                    byte * restrict buffer,
+                                    int imgwidth, int imgheight,
+                                    int rowstride,
+                                    const dword * restrict palette,
+                                    int scaletype, int ystart, int yend);
+
 /* Calculate a color palette for use with the above functions.
    RLIGHT, GLIGHT, BLIGHT are the RGB components (0 to 255) of the
    lightest possible color; RDARK, GDARK, BDARK are the RGB components
@@ -933,7 +1038,14 @@ typedef struct _TilemGrayLCD TilemGrayLCD;
 
 /* Create a new LCD and attach to a calculator.  Sampling for
    grayscale is done across WINDOWSIZE frames, with samples taken
-   every SAMPLEINT microseconds. */
+   every SAMPLEINT microseconds.
+
+   If SAMPLEINT is zero, the screen is not sampled; instead, each
+   change reported by the LCD driver is timed exactly, to the CPU
+   clock cycle.  This gives accurate results for programs that flip
+   pixels faster than any practical sampling rate, and costs nothing
+   while the screen is static.  Only one LCD may be attached this way
+   to a given calculator. */
 TilemGrayLCD* tilem_gray_lcd_new(TilemCalc *calc, int windowsize,
                                  int sampleint);
 
@@ -947,6 +1059,12 @@ void tilem_gray_lcd_free(TilemGrayLCD *glcd);
 void tilem_gray_lcd_get_frame(TilemGrayLCD * restrict glcd,
                               TilemLCDBuffer * restrict frm);
 
+/* Advance the frame counter and internal state as
+   tilem_gray_lcd_get_frame() does, without generating an image.
+   Call this in place of tilem_gray_lcd_get_frame() for frames that
+   will not be displayed, so that the sampling window keeps moving. */
+void tilem_gray_lcd_next_frame(TilemGrayLCD *glcd);
+
 
 /* Audio filtering */
 
@@ -1042,6 +1160,280 @@ int tilem_audio_filter_buffer_count(TilemAudioFilter *af);
 int tilem_audio_filter_buffer_remaining(TilemAudioFilter *af);
 
 
+/* Input recording and replay */
+
+/* Event types */
+enum {
+	TILEM_INPUT_KEY_PRESS = 1,     /* Key pressed (scancode) */
+	TILEM_INPUT_KEY_RELEASE,       /* Key released (scancode) */
+	TILEM_INPUT_GRAYLINK_SEND,     /* GrayLink sent byte */
+	TILEM_INPUT_GRAYLINK_GET,      /* GrayLink received byte */
+	TILEM_INPUT_GRAYLINK_RESET,    /* GrayLink reset */
+	TILEM_INPUT_BLACKLINK_LINES,   /* BlackLink line state */
+	TILEM_INPUT_BATTERY,	       /* Battery level */
+	TILEM_INPUT_LINK_EMULATOR,     /* Link emulation mode */
+	TILEM_INPUT_INTERRUPT_BUS      /* Data bus value for IM 0/2 */
+};
+
+/* Begin recording all external inputs to LOGFILE, starting from the
+   calculator's current state.  Every key press and release, GrayLink
+   and BlackLink transfer, change to calc->battery or
+   calc->linkport.linkemu, and interrupt bus value is logged along
+   with the CPU clock at which it occurred.  Returns NULL if the log
+   header cannot be written. */
+TilemInputLog* tilem_input_log_record(TilemCalc* calc, FILE* logfile);
+
+/* Begin replaying a log created by tilem_input_log_record().  The
+   calculator must be in exactly the same state as when recording
+   began (typically, by loading the same ROM and state files.)  While
+   replaying, inputs from any other source are ignored, and
+   emulation will stop with TILEM_STOP_REPLAY_END when the end of the
+   log is reached.  Returns NULL if the file is not a valid log for
+   this calculator model. */
+TilemInputLog* tilem_input_log_replay(TilemCalc* calc, FILE* logfile);
+
+/* Check whether a replay has reached the end of the log. */
+int tilem_input_log_finished(TilemInputLog* log);
+
+/* Stop recording or replaying, and detach from the calculator.  The
+   log file is flushed but not closed.  This must be called before
+   the calculator is freed. */
+void tilem_input_log_free(TilemInputLog* log);
+
+/* Notify the input log of an event (called internally, only if
+   calc->inputlog is set.)  Returns zero if the input should be
+   ignored. */
+int tilem_input_log_event(TilemCalc* calc, int type, int value);
+
+/* Record or replay the data bus value for an interrupt (called
+   internally.) */
+byte tilem_input_log_bus_byte(TilemCalc* calc, byte value);
+
+/* Notify the input log that the CPU is starting or stopping (called
+   internally.) */
+void tilem_input_log_run_begin(TilemCalc* calc);
+void tilem_input_log_run_end(TilemCalc* calc);
+
+
+/* Profiling */
+
+/* Callback used to name functions when writing a profile.  ADDR is
+   the logical address at which the function was entered or, if
+   ROMCALL is nonzero, the ROM call number.  Return NULL if the
+   function has no name. */
+typedef const char* (*TilemProfileNameFunc)(void* data, dword addr,
+                                            int romcall);
+
+/* Begin profiling.  Each instruction executed, and the clock cycles
+   it takes, are counted per physical address, per function; calls
+   between functions are counted along with their inclusive cost.
+   If ROMCALLRST is nonzero, it is the RST opcode (e.g. 0xEF) which
+   the OS uses for ROM calls; an RST with that opcode is treated as
+   a call to the function whose number follows. */
+TilemProfile* tilem_profile_new(TilemCalc* calc, int romcallrst);
+
+/* Stop profiling, but keep the data collected so far.  This must be
+   called (or the profile freed) before the calculator is freed. */
+void tilem_profile_detach(TilemProfile* prof);
+
+/* Stop profiling and free the profile. */
+void tilem_profile_free(TilemProfile* prof);
+
+/* Write profile to OUTFILE in callgrind format (as used by
+   KCachegrind.)  Calls still in progress are counted as if they had
+   returned.  CMD is a description of the program being profiled, or
+   NULL; NAMEFUNC, if not NULL, is used to look up function names.
+   Returns zero on success, or -1 on a write error. */
+int tilem_profile_write_callgrind(TilemProfile* prof, FILE* outfile,
+                                  const char* cmd,
+                                  TilemProfileNameFunc namefunc,
+                                  void* data);
+
+/* Notify the profiler that an instruction is beginning or has
+   finished (called internally, only if calc->profile is set.) */
+void tilem_profile_instr_begin(TilemCalc* calc);
+void tilem_profile_instr_end(TilemCalc* calc, dword op);
+
+/* Notify the profiler that an interrupt has been accepted (called
+   internally.) */
+void tilem_profile_interrupt(TilemCalc* calc);
+
+
+/* Execution tracing */
+
+/* Trace flags */
+enum {
+	TILEM_TRACE_REGISTERS = 1, /* Record register values */
+	TILEM_TRACE_MEMORY = 2	   /* Record memory and I/O accesses */
+};
+
+/* Types of memory access */
+enum {
+	TILEM_TRACE_MEM_READ = 1,
+	TILEM_TRACE_MEM_WRITE,
+	TILEM_TRACE_PORT_READ,
+	TILEM_TRACE_PORT_WRITE
+};
+
+/* Registers recorded in a trace (AF, BC, DE, HL, IX, IY, SP, AF',
+   BC', DE', HL') */
+#define TILEM_TRACE_NREGS 11
+
+/* Maximum number of accesses recorded per instruction */
+#define TILEM_TRACE_MAX_ACCESSES 15
+
+typedef struct _TilemTraceAccess {
+	byte type;		/* Type of access (TILEM_TRACE_MEM_READ,
+				   etc.) */
+	byte value;		/* Value read or written */
+	word addr;		/* Logical address or port number */
+} TilemTraceAccess;
+
+typedef struct _TilemTraceEntry {
+	dword pc;		/* Logical address of instruction */
+	word page;		/* Memory page containing instruction */
+	dword op;		/* Opcode (as passed to TILEM_BREAK_EXECUTE
+				   breakpoints) */
+	byte interrupt;		/* Interrupt accepted after instruction */
+	byte has_regs;		/* REGS is valid */
+	word regs[TILEM_TRACE_NREGS]; /* Registers after instruction */
+	int naccesses;		/* Number of memory/port accesses
+				   (including those made while
+				   accepting an interrupt just
+				   before this instruction) */
+	TilemTraceAccess accesses[TILEM_TRACE_MAX_ACCESSES];
+} TilemTraceEntry;
+
+/* Begin recording an execution trace.  The most recently executed
+   instructions are stored, in compressed form, in a ring buffer of
+   (at least) SIZE bytes.  With no FLAGS, each instruction costs about
+   four bytes. */
+TilemTrace* tilem_trace_new(TilemCalc* calc, int size, unsigned flags);
+
+/* Stop tracing and free the trace.  This must be done before the
+   calculator is freed. */
+void tilem_trace_free(TilemTrace* trace);
+
+/* Discard all recorded instructions. */
+void tilem_trace_clear(TilemTrace* trace);
+
+/* Retrieve up to MAX of the most recently executed instructions,
+   oldest first.  Returns the number of entries stored. */
+int tilem_trace_get_entries(TilemTrace* trace, TilemTraceEntry* entries,
+                            int max);
+
+/* Write up to MAX of the most recently executed instructions to
+   OUTFILE, in human-readable form.  Returns zero on success, or -1
+   on a write error. */
+int tilem_trace_write(TilemTrace* trace, FILE* outfile, int max);
+
+/* Automatically write the last MAX instructions to OUTFILE whenever
+   emulation stops for one of the given REASONS (TILEM_STOP_*); if
+   REASONS includes TILEM_STOP_EXCEPTION, dump on any hardware
+   exception, even if the calculator is reset rather than stopped.
+   If OUTFILE is NULL, disable automatic dumps. */
+void tilem_trace_set_autodump(TilemTrace* trace, FILE* outfile,
+                              dword reasons, int max);
+
+/* Record an executed instruction (called internally, only if
+   calc->trace is set.) */
+void tilem_trace_instr(TilemCalc* calc, dword op);
+
+/* Note that an interrupt has been accepted (called internally.) */
+void tilem_trace_interrupt(TilemCalc* calc);
+
+/* Note that emulation has stopped, or an exception has occurred
+   (called internally.) */
+void tilem_trace_stop(TilemCalc* calc, dword reason);
+
+
+/* Performance counters */
+
+/* Memory regions counted separately */
+enum {
+	TILEM_PERF_REGION_FLASH = 0, /* ROM or Flash */
+	TILEM_PERF_REGION_RAM,	     /* RAM */
+	TILEM_PERF_REGION_LCD,	     /* LCD controller memory (accessed
+					through I/O ports) */
+	TILEM_PERF_NUM_REGIONS
+};
+
+/* Number of timer IDs counted separately; callbacks for timers with
+   higher IDs are counted in the last slot */
+#define TILEM_PERF_MAX_TIMERS 32
+
+struct _TilemPerfCounters {
+	qword instructions;	/* Instructions executed (a HALT
+				   counts once per timer event) */
+	qword cycles;		/* Clock cycles elapsed while running */
+	qword halt_cycles;	/* Cycles skipped while halted */
+	qword interrupts;	/* Interrupts accepted */
+	qword timer_callbacks[TILEM_PERF_MAX_TIMERS]; /* Timer callbacks
+							 fired, by ID */
+	qword breakpoint_checks; /* Breakpoint address comparisons */
+	qword breakpoint_hits;	/* Breakpoints triggered */
+	qword mem_reads[TILEM_PERF_NUM_REGIONS]; /* Data reads (not
+						    including opcode
+						    fetches) */
+	qword mem_writes[TILEM_PERF_NUM_REGIONS]; /* Memory writes */
+	qword port_reads[256];	/* Port reads, by port number */
+	qword port_writes[256];	/* Port writes, by port number */
+	qword lcd_writes;	/* Bytes written to LCD controller */
+	qword flash_programs;	/* Flash bytes programmed */
+	qword flash_erases;	/* Flash sectors erased */
+};
+
+/* Enable or disable performance counters.  While enabled, the
+   counters are available as calc->perf; counting slows emulation
+   slightly.  Enabling resets the counters to zero. */
+void tilem_perf_counters_enable(TilemCalc* calc, int enable);
+
+/* Reset all counters to zero. */
+void tilem_perf_counters_reset(TilemCalc* calc);
+
+/* Write counters to OUTFILE, one per line, as "NAME VALUE".  Counters
+   that are zero are omitted, except for the first four.  Returns zero
+   on success, or -1 on a write error. */
+int tilem_perf_counters_write(const TilemPerfCounters* perf,
+                              FILE* outfile);
+
+
+/* Video output */
+
+/* Video stream formats */
+enum {
+	TILEM_VIDEO_Y4M,     /* YUV4MPEG2, 4:4:4 (BT.601, limited range) */
+	TILEM_VIDEO_RGB24    /* Raw RGB, 3 bytes per pixel, no header */
+};
+
+/* Begin writing an uncompressed video stream to OUTFILE, which may
+   be a pipe to an external encoder.  Frames are WIDTH x HEIGHT pixels
+   (the LCD image is scaled to fit) and are written at a constant rate
+   of FPS frames per second of emulated time.  PALETTE (256 colors,
+   as returned by tilem_color_palette_new) is used for monochrome and
+   grayscale images.  Only one frame is kept in memory, however long
+   the recording.  Returns NULL if the header cannot be written. */
+TilemVideoWriter* tilem_video_writer_new(FILE* outfile, int format,
+                                         int width, int height, int fps,
+                                         const dword* palette);
+
+/* Add an LCD image, to be shown for DURATION microseconds.  Output
+   frames are written as they fall due; images shown too briefly to
+   appear in any output frame are skipped without being converted,
+   and repeated images (according to BUF->hash) are converted only
+   once.  Returns zero on success, or -1 on a write error. */
+int tilem_video_writer_add_frame(TilemVideoWriter* vw,
+                                 TilemLCDBuffer* buf, dword duration);
+
+/* Get the number of output frames written so far. */
+dword tilem_video_writer_get_frame_count(const TilemVideoWriter* vw);
+
+/* Flush the output file (which is not closed) and free the writer.
+   Returns zero if the whole stream was written successfully, or -1
+   on a write error. */
+int tilem_video_writer_free(TilemVideoWriter* vw);
+
+
 /* Miscellaneous functions */
 
 /* Guess calculator type for a ROM file */
@@ -0,0 +1,401 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "tilem.h"
+#include "trace.h"
+
+/*
+
+ RECORD FORMAT
+
+   Each instruction is stored as a variable-length record:
+
+    - a header byte (see REC_* below);
+
+    - the difference between this instruction's address and the
+      previous one's, as a signed LEB128 number (zigzag encoded);
+
+    - if REC_PAGE is set, two bytes: the memory page XORed with the
+      previous record's page;
+
+    - the opcode, in 1, 2, or 4 bytes (REC_OP_MASK);
+
+    - if REC_REGS is set, a two-byte mask indicating which registers
+      have changed since the previous record, followed by each of
+      those registers XORed with its previous value;
+
+    - if REC_MEMORY is set, a count byte followed by four bytes (type,
+      value, address) for each access;
+
+    - one byte giving the total length of the record.
+
+   Every field is relative to the preceding record, so the buffer can
+   only be decoded from newest to oldest, starting from the state
+   saved in the TilemTrace structure; the trailing length byte makes
+   that possible.
+
+*/
+
+#define REC_OP_MASK   0x03	/* opcode length: 1, 2, or 4 bytes */
+#define REC_PAGE      0x04	/* memory page changed */
+#define REC_REGS      0x08	/* registers recorded */
+#define REC_MEMORY    0x10	/* memory accesses recorded */
+#define REC_INTERRUPT 0x20	/* interrupt accepted after instruction */
+
+/* Longest possible record */
+#define MAX_RECORD_SIZE (1 + 3 + 2 + 4 + 2 + 2 * TILEM_TRACE_NREGS \
+                         + 1 + 4 * TILEM_TRACE_MAX_ACCESSES + 1)
+
+#define MIN_BUFFER_SIZE 256
+
+static void get_regs(TilemCalc *calc, word *regs)
+{
+	regs[0] = calc->z80.r.af.w.l;
+	regs[1] = calc->z80.r.bc.w.l;
+	regs[2] = calc->z80.r.de.w.l;
+	regs[3] = calc->z80.r.hl.w.l;
+	regs[4] = calc->z80.r.ix.w.l;
+	regs[5] = calc->z80.r.iy.w.l;
+	regs[6] = calc->z80.r.sp.w.l;
+	regs[7] = calc->z80.r.af2.w.l;
+	regs[8] = calc->z80.r.bc2.w.l;
+	regs[9] = calc->z80.r.de2.w.l;
+	regs[10] = calc->z80.r.hl2.w.l;
+}
+
+TilemTrace* tilem_trace_new(TilemCalc *calc, int size, unsigned flags)
+{
+	TilemTrace *trace;
+	dword n;
+
+	for (n = MIN_BUFFER_SIZE; n < (dword) size && n < 0x40000000; n <<= 1)
+		;
+
+	trace = tilem_new0(TilemTrace, 1);
+	trace->calc = calc;
+	trace->flags = flags;
+	trace->buf = tilem_new_atomic(byte, n);
+	trace->mask = n - 1;
+
+	calc->trace = trace;
+	return trace;
+}
+
+void tilem_trace_free(TilemTrace *trace)
+{
+	if (trace->calc->trace == trace)
+		trace->calc->trace = NULL;
+	tilem_free(trace->buf);
+	tilem_free(trace);
+}
+
+void tilem_trace_clear(TilemTrace *trace)
+{
+	trace->head = trace->last = trace->dumppos = 0;
+	trace->lastpc = 0;
+	trace->lastpage = 0;
+	memset(trace->lastregs, 0, sizeof(trace->lastregs));
+	trace->halted = 0;
+	trace->naccesses = 0;
+}
+
+void tilem_trace_set_autodump(TilemTrace *trace, FILE *outfile,
+                              dword reasons, int max)
+{
+	trace->dumpfile = outfile;
+	trace->dumpreasons = reasons;
+	trace->dumpmax = max;
+	trace->dumppos = trace->head;
+}
+
+/* Recording */
+
+void tilem_trace_instr(TilemCalc *calc, dword op)
+{
+	TilemTrace *trace = calc->trace;
+	byte rec[MAX_RECORD_SIZE];
+	word regs[TILEM_TRACE_NREGS];
+	unsigned hdr, n, i, regmask;
+	int delta;
+	dword z;
+
+	/* a halted CPU repeats the HALT instruction; record it only
+	   once */
+	if (op == 0x76 && trace->halted && trace->pc == trace->lastpc
+	    && trace->page == trace->lastpage) {
+		trace->naccesses = 0;
+		return;
+	}
+
+	n = 1;
+
+	delta = (int) ((trace->pc - trace->lastpc + 0x8000) & 0xffff) - 0x8000;
+	z = (delta < 0 ? ((dword) ~delta << 1) | 1 : (dword) delta << 1);
+	do {
+		rec[n] = z & 0x7f;
+		z >>= 7;
+		if (z)
+			rec[n] |= 0x80;
+		n++;
+	} while (z);
+
+	if (trace->page != trace->lastpage) {
+		hdr = REC_PAGE;
+		rec[n++] = (trace->page ^ trace->lastpage);
+		rec[n++] = (trace->page ^ trace->lastpage) >> 8;
+	}
+	else {
+		hdr = 0;
+	}
+
+	rec[n++] = op;
+	if (op > 0xffff) {
+		hdr |= 2;
+		rec[n++] = op >> 8;
+		rec[n++] = op >> 16;
+		rec[n++] = op >> 24;
+	}
+	else if (op > 0xff) {
+		hdr |= 1;
+		rec[n++] = op >> 8;
+	}
+
+	if (trace->flags & TILEM_TRACE_REGISTERS) {
+		hdr |= REC_REGS;
+		get_regs(calc, regs);
+		regmask = 0;
+		for (i = 0; i < TILEM_TRACE_NREGS; i++)
+			if (regs[i] != trace->lastregs[i])
+				regmask |= (1 << i);
+
+		rec[n++] = regmask;
+		rec[n++] = regmask >> 8;
+		for (i = 0; i < TILEM_TRACE_NREGS; i++) {
+			if (regmask & (1 << i)) {
+				rec[n++] = (regs[i] ^ trace->lastregs[i]);
+				rec[n++] = (regs[i] ^ trace->lastregs[i]) >> 8;
+				trace->lastregs[i] = regs[i];
+			}
+		}
+	}
+
+	if (trace->naccesses) {
+		hdr |= REC_MEMORY;
+		rec[n++] = trace->naccesses;
+		for (i = 0; i < (unsigned) trace->naccesses; i++) {
+			rec[n++] = trace->accesses[i].type;
+			rec[n++] = trace->accesses[i].value;
+			rec[n++] = trace->accesses[i].addr;
+			rec[n++] = trace->accesses[i].addr >> 8;
+		}
+		trace->naccesses = 0;
+	}
+
+	rec[0] = hdr;
+	n++;
+	rec[n - 1] = n;
+
+	trace->last = trace->head;
+	for (i = 0; i < n; i++)
+		trace->buf[(trace->head + i) & trace->mask] = rec[i];
+	trace->head += n;
+
+	trace->lastpc = trace->pc;
+	trace->lastpage = trace->page;
+	trace->halted = (op == 0x76);
+}
+
+void tilem_trace_interrupt(TilemCalc *calc)
+{
+	TilemTrace *trace = calc->trace;
+
+	if (trace->head != trace->last)
+		trace->buf[trace->last & trace->mask] |= REC_INTERRUPT;
+
+	/* the instruction following the interrupt must be recorded,
+	   even if it is the same HALT */
+	trace->halted = 0;
+}
+
+void tilem_trace_stop(TilemCalc *calc, dword reason)
+{
+	TilemTrace *trace = calc->trace;
+
+	if (!trace->dumpfile || !(reason & trace->dumpreasons)
+	    || trace->head == trace->dumppos)
+		return;
+
+	trace->dumppos = trace->head;
+	fprintf(trace->dumpfile, "* stopped (reason %#x) at %02X:%04X\n",
+	        (unsigned) reason, calc->mempagemap[(calc->z80.r.pc.w.l >> 14)],
+	        calc->z80.r.pc.w.l);
+	tilem_trace_write(trace, trace->dumpfile, trace->dumpmax);
+	fflush(trace->dumpfile);
+}
+
+/* Decoding */
+
+int tilem_trace_get_entries(TilemTrace *trace, TilemTraceEntry *entries,
+                            int max)
+{
+	TilemTraceEntry *e;
+	dword pc = trace->lastpc;
+	word page = trace->lastpage;
+	word regs[TILEM_TRACE_NREGS];
+	qword start, end, limit;
+	byte rec[MAX_RECORD_SIZE];
+	unsigned hdr, len, n, i, regmask, shift;
+	dword z;
+	int count = 0;
+
+	memcpy(regs, trace->lastregs, sizeof(regs));
+
+	limit = (trace->head > trace->mask ? trace->head - trace->mask - 1 : 0);
+	end = trace->head;
+
+	while (count < max && end > limit) {
+		len = trace->buf[(end - 1) & trace->mask];
+		if (len < 4 || len > MAX_RECORD_SIZE || end - limit < len)
+			break;
+		start = end - len;
+		for (i = 0; i < len; i++)
+			rec[i] = trace->buf[(start + i) & trace->mask];
+
+		e = &entries[max - 1 - count];
+		hdr = rec[0];
+		e->pc = pc;
+		e->page = page;
+		e->interrupt = (hdr & REC_INTERRUPT ? 1 : 0);
+		e->has_regs = (hdr & REC_REGS ? 1 : 0);
+		e->naccesses = 0;
+
+		n = 1;
+		z = shift = 0;
+		do {
+			z |= (dword) (rec[n] & 0x7f) << shift;
+			shift += 7;
+		} while (rec[n++] & 0x80);
+		pc = (pc - ((z & 1) ? ~(z >> 1) : (z >> 1))) & 0xffff;
+
+		if (hdr & REC_PAGE) {
+			page ^= rec[n] | (rec[n + 1] << 8);
+			n += 2;
+		}
+
+		e->op = rec[n++];
+		if ((hdr & REC_OP_MASK) == 1) {
+			e->op |= rec[n++] << 8;
+		}
+		else if ((hdr & REC_OP_MASK) == 2) {
+			e->op |= ((dword) rec[n] << 8
+			          | (dword) rec[n + 1] << 16
+			          | (dword) rec[n + 2] << 24);
+			n += 3;
+		}
+
+		if (hdr & REC_REGS) {
+			memcpy(e->regs, regs, sizeof(regs));
+			regmask = rec[n] | (rec[n + 1] << 8);
+			n += 2;
+			for (i = 0; i < TILEM_TRACE_NREGS; i++) {
+				if (regmask & (1 << i)) {
+					regs[i] ^= rec[n] | (rec[n + 1] << 8);
+					n += 2;
+				}
+			}
+		}
+
+		if (hdr & REC_MEMORY) {
+			e->naccesses = rec[n++];
+			for (i = 0; i < (unsigned) e->naccesses; i++) {
+				e->accesses[i].type = rec[n];
+				e->accesses[i].value = rec[n + 1];
+				e->accesses[i].addr = rec[n + 2] | (rec[n + 3] << 8);
+				n += 4;
+			}
+		}
+
+		end = start;
+		count++;
+	}
+
+	if (count < max)
+		memmove(entries, entries + max - count,
+		        count * sizeof(TilemTraceEntry));
+	return count;
+}
+
+static const char * const reg_names[TILEM_TRACE_NREGS] = {
+	"AF", "BC", "DE", "HL", "IX", "IY", "SP",
+	"AF'", "BC'", "DE'", "HL'" };
+
+static const char * const access_names[] = {
+	"?", "R", "W", "IN", "OUT" };
+
+int tilem_trace_write(TilemTrace *trace, FILE *outfile, int max)
+{
+	TilemTraceEntry *entries, *e;
+	int count, i, j;
+
+	if (max <= 0)
+		return 0;
+
+	entries = tilem_new(TilemTraceEntry, max);
+	count = tilem_trace_get_entries(trace, entries, max);
+
+	for (i = 0; i < count; i++) {
+		e = &entries[i];
+		fprintf(outfile, "%02X:%04X  ", e->page, e->pc);
+		if (e->op > 0xffff)
+			fprintf(outfile, "%08X", e->op);
+		else if (e->op > 0xff)
+			fprintf(outfile, "%04X    ", e->op);
+		else
+			fprintf(outfile, "%02X      ", e->op);
+
+		if (e->has_regs) {
+			for (j = 0; j < TILEM_TRACE_NREGS; j++)
+				if (i == 0 || !entries[i - 1].has_regs
+				    || e->regs[j] != entries[i - 1].regs[j])
+					fprintf(outfile, " %s=%04X",
+					        reg_names[j], e->regs[j]);
+		}
+
+		for (j = 0; j < e->naccesses; j++) {
+			fprintf(outfile, " %s:%04X=%02X",
+			        access_names[e->accesses[j].type <= 4
+			                     ? e->accesses[j].type : 0],
+			        e->accesses[j].addr, e->accesses[j].value);
+		}
+
+		if (e->interrupt)
+			fputs(" <interrupt>", outfile);
+		putc('\n', outfile);
+	}
+
+	tilem_free(entries);
+	return (ferror(outfile) ? -1 : 0);
+}
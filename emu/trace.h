@@ -0,0 +1,82 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TILEM_TRACE_H
+#define _TILEM_TRACE_H
+
+struct _TilemTrace {
+	TilemCalc *calc;	/* Calculator */
+	unsigned flags;		/* TILEM_TRACE_* flags */
+
+	byte *buf;		/* Ring buffer */
+	dword mask;		/* Size of ring buffer, minus one */
+	qword head;		/* Total number of bytes written */
+	qword last;		/* Position of most recent record */
+	qword dumppos;		/* Value of head at last automatic dump */
+
+	/* State as of the most recent record */
+	dword lastpc;
+	word lastpage;
+	word lastregs[TILEM_TRACE_NREGS];
+	int halted;		/* most recent record was a HALT */
+
+	/* Current instruction */
+	dword pc;		/* Logical address */
+	word page;		/* Memory page */
+	int naccesses;
+	TilemTraceAccess accesses[TILEM_TRACE_MAX_ACCESSES];
+
+	FILE *dumpfile;		/* File for automatic dumps */
+	dword dumpreasons;	/* Stop reasons triggering a dump */
+	int dumpmax;		/* Number of instructions to dump */
+};
+
+/* Note the address of the instruction about to be executed. */
+static inline void tilem_trace_begin(TilemCalc *calc)
+{
+	TilemTrace *trace = calc->trace;
+	trace->pc = calc->z80.r.pc.w.l;
+	trace->page = calc->mempagemap[trace->pc >> 14];
+}
+
+/* Note a memory or I/O access made by the current instruction.
+   Reads from the four bytes following the start of the instruction
+   are assumed to be operand fetches, and are not recorded. */
+static inline void tilem_trace_access(TilemCalc *calc, int type,
+                                      dword addr, byte value)
+{
+	TilemTrace *trace = calc->trace;
+
+	if (TILEM_LIKELY(trace == NULL)
+	    || !(trace->flags & TILEM_TRACE_MEMORY)
+	    || trace->naccesses >= TILEM_TRACE_MAX_ACCESSES)
+		return;
+
+	if (type == TILEM_TRACE_MEM_READ
+	    && ((addr - trace->pc) & 0xffff) < 4)
+		return;
+
+	trace->accesses[trace->naccesses].type = type;
+	trace->accesses[trace->naccesses].addr = addr;
+	trace->accesses[trace->naccesses].value = value;
+	trace->naccesses++;
+}
+
+#endif
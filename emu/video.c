@@ -0,0 +1,169 @@
+/*
+ * libtilemcore - Graphing calculator emulation library
+ *
+ * Copyright (C) 2026 The TilEm developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "tilem.h"
+
+struct _TilemVideoWriter {
+	FILE *outfile;
+	int format;
+	int width, height;
+	int fps;
+	dword *palette;
+
+	qword time;             /* End of last image (microseconds) */
+	dword nframes;          /* Number of frames written */
+	int error;              /* Write error occurred */
+
+	byte *rgb;              /* Scaled RGB image */
+	byte *frame;            /* Converted output frame */
+	unsigned int framesize;
+	qword framehash;        /* Hash of the image in frame */
+	int framevalid;         /* Frame holds a converted image */
+};
+
+TilemVideoWriter* tilem_video_writer_new(FILE* outfile, int format,
+                                         int width, int height, int fps,
+                                         const dword* palette)
+{
+	TilemVideoWriter *vw;
+
+	if (width <= 0 || height <= 0 || fps <= 0)
+		return NULL;
+
+	if (format == TILEM_VIDEO_Y4M) {
+		fprintf(outfile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+		        width, height, fps);
+		if (ferror(outfile))
+			return NULL;
+	}
+	else if (format != TILEM_VIDEO_RGB24) {
+		return NULL;
+	}
+
+	vw = tilem_new0(TilemVideoWriter, 1);
+	vw->outfile = outfile;
+	vw->format = format;
+	vw->width = width;
+	vw->height = height;
+	vw->fps = fps;
+
+	vw->palette = tilem_new_atomic(dword, 256);
+	memcpy(vw->palette, palette, 256 * sizeof(dword));
+
+	vw->framesize = width * height * 3;
+	vw->rgb = tilem_new_atomic(byte, vw->framesize);
+	if (format == TILEM_VIDEO_Y4M) {
+		vw->frame = tilem_new_atomic(byte, vw->framesize);
+	}
+	else {
+		vw->frame = vw->rgb;
+	}
+
+	return vw;
+}
+
+/* Convert RGB pixels to Y'CbCr planes (BT.601, limited range) */
+static void convert_y4m(const byte * restrict rgb, byte * restrict frame,
+                        unsigned int npixels)
+{
+	byte * restrict yp = frame;
+	byte * restrict up = frame + npixels;
+	byte * restrict vp = frame + 2 * npixels;
+	int r, g, b;
+	unsigned int i;
+
+	for (i = 0; i < npixels; i++, rgb += 3) {
+		r = rgb[0];
+		g = rgb[1];
+		b = rgb[2];
+		yp[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+		up[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+		vp[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+	}
+}
+
+/* Convert an LCD image into the output frame */
+static void convert_frame(TilemVideoWriter *vw, TilemLCDBuffer *buf)
+{
+	if (vw->framevalid && buf->hashvalid && buf->hash == vw->framehash)
+		return;
+
+	tilem_draw_lcd_image_rgb(buf, vw->rgb, vw->width, vw->height,
+	                         vw->width * 3, 3, vw->palette,
+	                         TILEM_SCALE_SMOOTH);
+
+	if (vw->format == TILEM_VIDEO_Y4M)
+		convert_y4m(vw->rgb, vw->frame, vw->width * vw->height);
+
+	vw->framehash = (buf->hashvalid ? buf->hash
+	                 : tilem_lcd_buffer_hash(buf));
+	vw->framevalid = 1;
+}
+
+int tilem_video_writer_add_frame(TilemVideoWriter* vw,
+                                 TilemLCDBuffer* buf, dword duration)
+{
+	FILE *f = vw->outfile;
+	qword end = vw->time + duration;
+
+	/* output frame N is shown at N / fps seconds; write every frame
+	   that falls within this image's interval */
+	while ((qword) vw->nframes * 1000000 < end * vw->fps) {
+		convert_frame(vw, buf);
+
+		if (vw->format == TILEM_VIDEO_Y4M)
+			fputs("FRAME\n", f);
+		fwrite(vw->frame, 1, vw->framesize, f);
+		vw->nframes++;
+	}
+
+	vw->time = end;
+
+	if (ferror(f))
+		vw->error = 1;
+	return (vw->error ? -1 : 0);
+}
+
+dword tilem_video_writer_get_frame_count(const TilemVideoWriter* vw)
+{
+	return vw->nframes;
+}
+
+int tilem_video_writer_free(TilemVideoWriter* vw)
+{
+	int status;
+
+	if (fflush(vw->outfile) || ferror(vw->outfile))
+		vw->error = 1;
+	status = (vw->error ? -1 : 0);
+
+	if (vw->frame != vw->rgb)
+		tilem_free(vw->frame);
+	tilem_free(vw->rgb);
+	tilem_free(vw->palette);
+	tilem_free(vw);
+	return status;
+}
@@ -141,7 +141,7 @@ void x1_z80_out(TilemCalc* calc, dword port, byte value)
 	switch(port&0x1f) {
 	case 0x00:
 		calc->lcd.addr = ((value & 0x1f) << 8);
-		calc->z80.lastlcdwrite = calc->z80.clock;
+		tilem_lcd_changed(calc);
 		break;
 
 	case 0x01:
@@ -193,7 +193,7 @@ void x1_z80_out(TilemCalc* calc, dword port, byte value)
 				calc->lcd.rowstride = 20;
 				break;
 			}
-			calc->z80.lastlcdwrite = calc->z80.clock;
+			tilem_lcd_changed(calc);
 		}
 		break;
 
@@ -39,7 +39,8 @@ void x1_z80_wrmem(TilemCalc* calc, dword A, byte v)
 		if ((((pa - 0x8000 - calc->lcd.addr) >> 6)
 		     < (unsigned) calc->lcd.rowstride)
 		    && calc->hwregs[HW_VERSION] < 2)
-			calc->z80.lastlcdwrite = calc->z80.clock;
+			tilem_lcd_t6a43_byte_changed(calc, pa - 0x8000
+			                             - calc->lcd.addr);
 	}
 }
 
@@ -95,7 +95,7 @@ void x5_z80_out(TilemCalc* calc, dword port, byte value)
 	switch(port&0xff) {
 	case 0x00:
 		calc->lcd.addr = ((value & 0x3f) << 8);
-		calc->z80.lastlcdwrite = calc->z80.clock;
+		tilem_lcd_changed(calc);
 		break;
 
 	case 0x01:
@@ -146,7 +146,7 @@ void x5_z80_out(TilemCalc* calc, dword port, byte value)
 			calc->lcd.rowstride = 20;
 			break;
 		}
-		calc->z80.lastlcdwrite = calc->z80.clock;
+		tilem_lcd_changed(calc);
 		break;
 
 	case 0x05:
@@ -37,7 +37,8 @@ void x5_z80_wrmem(TilemCalc* calc, dword A, byte v)
 
 		if (((pa - 0x20000 - calc->lcd.addr) >> 6)
 		    < (unsigned) calc->lcd.rowstride)
-			calc->z80.lastlcdwrite = calc->z80.clock;
+			tilem_lcd_t6a43_byte_changed(calc, pa - 0x20000
+			                             - calc->lcd.addr);
 	}
 }
 
@@ -751,7 +751,7 @@ void xc_z80_out(TilemCalc* calc, dword port, byte value)
 			else
 				calc->lcd.contrast = 41 - level;
 
-			calc->z80.lastlcdwrite = calc->z80.clock;
+			tilem_lcd_changed(calc);
 			tilem_z80_set_timer(calc, TIMER_BACKLIGHT_OFF,
 			                    0, 0, 0);
 		}
@@ -828,7 +828,7 @@ void xc_z80_ptimer(TilemCalc* calc, int id)
 		calc->hwregs[BACKLIGHT_ON] = 0;
 		calc->hwregs[BACKLIGHT_LEVEL] = 0;
 		calc->lcd.contrast = 0;
-		calc->z80.lastlcdwrite = calc->z80.clock;
+		tilem_lcd_changed(calc);
 		break;
 	}
 }
@@ -378,6 +378,8 @@ static void write_reg(TilemCalc* calc, byte index, word value)
 
 	if ((reg = get_reg(calc, index))) {
 		*reg = value & get_reg_mask(index);
+		/* registers do not affect the image from xc_get_lcd, so
+		   the change hook need not be called */
 		calc->z80.lastlcdwrite = calc->z80.clock;
 
 		/* Setting either R20 or R21 resets both LCD_CUR_X and
@@ -443,6 +445,9 @@ byte xc_lcd_read(TilemCalc* calc)
 	dword state = calc->hwregs[LCD_READ_STATE];
 	word value;
 
+	if (calc->perf)
+		calc->perf->mem_reads[TILEM_PERF_REGION_LCD]++;
+
 	if (index == 0x22) {
 		/* Note: TRI has no effect on reads.  There is
 		   (apparently) no way for the CPU to read the least
@@ -537,15 +542,32 @@ static inline int update_row(TilemCalc *calc, dword mode)
 	}
 }
 
-static void put_pixel(TilemCalc* calc, dword mode, dword r, dword g, dword b)
+/* Get byte J of row I of the monochrome screen image (see
+   xc_get_lcd) */
+static inline byte get_lcd_byte(const byte* restrict lcdmem, int i, int j)
+{
+	const byte* restrict p = lcdmem + (i * WIDTH + j * 8) * 3;
+	unsigned x = 0;
+	int k;
+
+	for (k = 0; k < 8; k++) {
+		if (!(p[(i+j+k*2)%3] & 0x20))
+			x |= (0x80 >> k);
+		p += 3;
+	}
+	return x;
+}
+
+static inline void put_pixel(TilemCalc* calc, dword mode,
+                             dword r, dword g, dword b)
 {
 	dword row = calc->hwregs[LCD_CUR_Y];
 	dword col = calc->hwregs[LCD_CUR_X];
 	byte* restrict p;
 
-	if (row >= HEIGHT)
+	if (TILEM_UNLIKELY(row >= HEIGHT))
 		row %= HEIGHT;
-	if (col >= WIDTH)
+	if (TILEM_UNLIKELY(col >= WIDTH))
 		col %= WIDTH;
 
 	if (calc->hwregs[LCD_R01] & R01_FLIP_COLUMNS)
@@ -563,7 +585,12 @@ static void put_pixel(TilemCalc* calc, dword mode, dword r, dword g, dword b)
 		p[2] = r & 0x3f;
 	}
 
-	calc->z80.lastlcdwrite = calc->z80.clock;
+	/* only compute the mono byte if someone is listening */
+	if (calc->lcd.changefunc)
+		tilem_lcd_byte_changed(calc, row * (WIDTH / 8) + col / 8,
+		                       get_lcd_byte(calc->lcdmem, row, col / 8));
+	else
+		calc->z80.lastlcdwrite = calc->z80.clock;
 
 	if (mode & R03_COLFIRST) {
 		if (update_col(calc, mode))
@@ -575,7 +602,7 @@ static void put_pixel(TilemCalc* calc, dword mode, dword r, dword g, dword b)
 	}
 }
 
-static void put_pixel16(TilemCalc* calc, dword mode, dword value)
+static inline void put_pixel16(TilemCalc* calc, dword mode, dword value)
 {
 	dword r, g, b;
 
@@ -630,6 +657,11 @@ void xc_lcd_write(TilemCalc* calc, byte val)
 	word mode;
 	dword value, r, g, b;
 
+	if (calc->perf) {
+		calc->perf->lcd_writes++;
+		calc->perf->mem_writes[TILEM_PERF_REGION_LCD]++;
+	}
+
 	/* no warning about implicitly resetting LCD_READ_STATE here;
 	   the OS does so sometimes (when highlighting/unhighlighting
 	   history entries), and for huge blocks of pixels at a time */
@@ -638,33 +670,33 @@ void xc_lcd_write(TilemCalc* calc, byte val)
 	value = (calc->hwregs[LCD_WRITE_BUFFER] << 8 | val);
 	calc->hwregs[LCD_WRITE_BUFFER] = value;
 
-	if (index == 0x22) {
+	if (TILEM_LIKELY(index == 0x22)) {
 		mode = calc->hwregs[LCD_R03];
-		if (mode & R03_18BIT) {
-			/* 18-bit mode */
-			state++;
-			if (state >= 3) {
-				state = 0;
-				if (mode & R03_18BIT_UNPACKED) {
-					value &= 0xfcfcfc;
-					r = (value >> 18);
-					g = (value >> 10);
-					b = (value >> 2);
-				}
-				else {
-					value &= 0x3ffff;
-					r = (value >> 12);
-					g = (value >> 6);
-					b = value;
-				}
-				put_pixel(calc, mode, r, g, b);
-			}
-		}
-		else {
-			/* 16-bit mode */
-			state = !state;
-			if (state == 0)
+		if (TILEM_LIKELY(!(mode & R03_18BIT))) {
+			/* 16-bit mode (used for nearly all pixel data) */
+			calc->hwregs[LCD_WRITE_STATE] = !state;
+			if (state)
 				put_pixel16(calc, mode, value);
+			return;
+		}
+
+		/* 18-bit mode */
+		state++;
+		if (state >= 3) {
+			state = 0;
+			if (mode & R03_18BIT_UNPACKED) {
+				value &= 0xfcfcfc;
+				r = (value >> 18);
+				g = (value >> 10);
+				b = (value >> 2);
+			}
+			else {
+				value &= 0x3ffff;
+				r = (value >> 12);
+				g = (value >> 6);
+				b = value;
+			}
+			put_pixel(calc, mode, r, g, b);
 		}
 		calc->hwregs[LCD_WRITE_STATE] = state;
 	}
@@ -677,20 +709,11 @@ void xc_lcd_write(TilemCalc* calc, byte val)
 
 void xc_get_lcd(TilemCalc* calc, byte* data)
 {
-	int i, j, k;
-	const byte* restrict p;
-	unsigned x;
-
-	p = calc->lcdmem;
-	for (i = 0; i < 240; i++) {
-		for (j = 0; j < 40; j++) {
-			x = 0;
-			for (k = 0; k < 8; k++) {
-				if (!(p[(i+j+k*2)%3] & 0x20))
-					x |= (0x80 >> k);
-				p += 3;
-			}
-			*data = x;
+	int i, j;
+
+	for (i = 0; i < HEIGHT; i++) {
+		for (j = 0; j < WIDTH / 8; j++) {
+			*data = get_lcd_byte(calc->lcdmem, i, j);
 			data++;
 		}
 	}
@@ -884,6 +907,7 @@ void xc_get_frame(TilemCalc* calc, TilemLCDBuffer* buf)
 	int imgpos1, imgoffs1, imgsize1;
 	int imgpos2, imgoffs2, imgsize2;
 	int i, tmp;
+	byte row[WIDTH * 3];
 
 	if (TILEM_UNLIKELY(buf->height != HEIGHT
 	                   || buf->rowstride != WIDTH * 3)) {
@@ -893,6 +917,7 @@ void xc_get_frame(TilemCalc* calc, TilemLCDBuffer* buf)
 		buf->rowstride = WIDTH * 3;
 		buf->height = HEIGHT;
 		memset(buf->data, 0, WIDTH * HEIGHT * 3);
+		tilem_lcd_buffer_set_dirty(buf, 0, HEIGHT);
 	}
 
 	buf->format = TILEM_LCD_BUF_SRGB_63;
@@ -901,11 +926,15 @@ void xc_get_frame(TilemCalc* calc, TilemLCDBuffer* buf)
 
 	if (!calc->lcd.active || (calc->z80.halted && !calc->poweronhalt)) {
 		/* screen is turned off */
+		if (buf->contrast != 0)
+			tilem_lcd_buffer_set_dirty(buf, 0, HEIGHT);
 		buf->contrast = 0;
 		memset(buf->data, 0, buf->height * buf->rowstride);
 		return;
 	}
 
+	if (buf->contrast != calc->lcd.contrast)
+		tilem_lcd_buffer_set_dirty(buf, 0, HEIGHT);
 	buf->contrast = calc->lcd.contrast;
 
 	ndl_black = (calc->hwregs[LCD_R61] & R61_NDL_BLACK);
@@ -1004,14 +1033,38 @@ void xc_get_frame(TilemCalc* calc, TilemLCDBuffer* buf)
 	imgoffs2 = p0start * 3;
 	imgsize2 = p0size * 3;
 
+	if (!nfloat_start && !nfloat_end && !imgsize2 && !interlace_cols
+	    && imgsize1 == WIDTH * 3 && imgoffs1 % (WIDTH * 3) == 0
+	    && !invert_levels && !msb_only) {
+		/* plain full-screen image, as normally used by the
+		   OS: rows are copied unchanged (see fill_image), so
+		   compare and copy them directly */
+		for (i = 0; i < HEIGHT; i++) {
+			if (memcmp(dest, src, WIDTH * 3)) {
+				memcpy(dest, src, WIDTH * 3);
+				tilem_lcd_buffer_set_dirty(buf, i, i + 1);
+			}
+			dest += WIDTH * 3;
+			src += WIDTH * 3;
+		}
+		return;
+	}
+
+	/* each row is built in a temporary buffer, so that we can
+	   tell which rows have changed */
 	for (i = 0; i < HEIGHT; i++) {
-		fill_row(dest, src,
+		fill_row(row, src,
 		         nfloat_start, nfloat_end,
 		         imgpos1, imgoffs1, imgsize1,
 		         imgpos2, imgoffs2, imgsize2,
 		         flip_rows, interlace_cols,
 		         0, invert_levels, msb_only, ndl_black);
 
+		if (memcmp(dest, row, WIDTH * 3)) {
+			memcpy(dest, row, WIDTH * 3);
+			tilem_lcd_buffer_set_dirty(buf, i, i + 1);
+		}
+
 		dest += WIDTH * 3;
 		src += WIDTH * 3;
 	}
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include "tilem.h"
 #include "z80.h"
+#include "trace.h"
 #include "gettext.h"
 
 /* Timer manipulation */
@@ -649,6 +650,25 @@ void tilem_z80_set_breakpoint_data(TilemCalc* calc, int id, void* data)
 }
 
 
+/* Performance counters */
+
+static inline void perf_timer(TilemCalc* calc, int tmr)
+{
+	if (tmr >= TILEM_PERF_MAX_TIMERS)
+		tmr = TILEM_PERF_MAX_TIMERS - 1;
+	calc->perf->timer_callbacks[tmr]++;
+}
+
+static inline void perf_mem(TilemCalc* calc, qword* counts, dword addr)
+{
+	dword pa = (*calc->hw.mem_ltop)(calc, addr);
+
+	if (pa < calc->hw.romsize)
+		counts[TILEM_PERF_REGION_FLASH]++;
+	else
+		counts[TILEM_PERF_REGION_RAM]++;
+}
+
 static inline void check_timers(TilemCalc* calc)
 {
 	int tmr;
@@ -665,6 +685,9 @@ static inline void check_timers(TilemCalc* calc)
 		callback = calc->z80.timers[tmr].callback;
 		callbackdata = calc->z80.timers[tmr].callbackdata;
 
+		if (TILEM_UNLIKELY(calc->perf != NULL))
+			perf_timer(calc, tmr);
+
 		timer_unset(&calc->z80, tmr);
 		timer_set(&calc->z80, tmr, calc->z80.timers[tmr].period,
 			  calc->z80.timers[tmr].period, 0, t);
@@ -681,6 +704,9 @@ static inline void check_timers(TilemCalc* calc)
 		callback = calc->z80.timers[tmr].callback;
 		callbackdata = calc->z80.timers[tmr].callbackdata;
 
+		if (TILEM_UNLIKELY(calc->perf != NULL))
+			perf_timer(calc, tmr);
+
 		timer_unset(&calc->z80, tmr);
 		timer_set(&calc->z80, tmr, calc->z80.timers[tmr].period,
 			  calc->z80.timers[tmr].period, 1, t);
@@ -697,6 +723,9 @@ static inline void check_breakpoints(TilemCalc* calc, int list, dword addr)
 	void* testdata;
 
 	for (bp = list; bp; bp = calc->z80.breakpoints[bp].next) {
+		if (TILEM_UNLIKELY(calc->perf != NULL))
+			calc->perf->breakpoint_checks++;
+
 		masked = addr & calc->z80.breakpoints[bp].mask;
 		if (masked < calc->z80.breakpoints[bp].start
 		    || masked > calc->z80.breakpoints[bp].end)
@@ -708,6 +737,9 @@ static inline void check_breakpoints(TilemCalc* calc, int list, dword addr)
 		if (testfunc && !(*testfunc)(calc, addr, testdata))
 			continue;
 
+		if (TILEM_UNLIKELY(calc->perf != NULL))
+			calc->perf->breakpoint_hits++;
+
 		calc->z80.stop_breakpoint = bp;
 		tilem_z80_stop(calc, TILEM_STOP_BREAKPOINT);
 	}
@@ -740,6 +772,9 @@ static inline byte z80_readb(TilemCalc* calc, dword addr)
 	byte b;
 	addr &= 0xffff;
 	b = (*calc->hw.z80_rdmem)(calc, addr);
+	tilem_trace_access(calc, TILEM_TRACE_MEM_READ, addr, b);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_reads, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mr,
 			      calc->z80.breakpoint_mpr, addr);
 	return b;
@@ -750,10 +785,16 @@ static inline dword z80_readw(TilemCalc* calc, dword addr)
 	dword v;
 	addr &= 0xffff;
 	v = (*calc->hw.z80_rdmem)(calc, addr);
+	tilem_trace_access(calc, TILEM_TRACE_MEM_READ, addr, v);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_reads, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mr,
 			      calc->z80.breakpoint_mpr, addr);
 	addr = (addr + 1) & 0xffff;
 	v |= (*calc->hw.z80_rdmem)(calc, addr) << 8;
+	tilem_trace_access(calc, TILEM_TRACE_MEM_READ, addr, v >> 8);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_reads, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mr,
 			      calc->z80.breakpoint_mpr, addr);
 	return v;
@@ -765,6 +806,9 @@ static inline byte z80_input(TilemCalc* calc, dword addr)
 	addr &= 0xffff;
 	check_timers(calc);
 	b = (*calc->hw.z80_in)(calc, addr);
+	tilem_trace_access(calc, TILEM_TRACE_PORT_READ, addr, b);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		calc->perf->port_reads[addr & 0xff]++;
 	check_breakpoints(calc, calc->z80.breakpoint_pr, addr);
 	return b;
 }
@@ -773,6 +817,9 @@ static inline void z80_writeb(TilemCalc* calc, dword addr, byte value)
 {
 	addr &= 0xffff;
 	(*calc->hw.z80_wrmem)(calc, addr, value);
+	tilem_trace_access(calc, TILEM_TRACE_MEM_WRITE, addr, value);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_writes, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mw,
 			      calc->z80.breakpoint_mpw, addr);
 	calc->z80.lastwrite = calc->z80.clock;
@@ -782,11 +829,17 @@ static inline void z80_writew(TilemCalc* calc, dword addr, word value)
 {
 	addr &= 0xffff;
 	(*calc->hw.z80_wrmem)(calc, addr, value);
+	tilem_trace_access(calc, TILEM_TRACE_MEM_WRITE, addr, value);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_writes, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mw,
 			      calc->z80.breakpoint_mpw, addr);
 	addr = (addr + 1) & 0xffff;
 	value >>= 8;
 	(*calc->hw.z80_wrmem)(calc, addr, value);
+	tilem_trace_access(calc, TILEM_TRACE_MEM_WRITE, addr, value);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		perf_mem(calc, calc->perf->mem_writes, addr);
 	check_mem_breakpoints(calc, calc->z80.breakpoint_mw,
 			      calc->z80.breakpoint_mpw, addr);
 	calc->z80.lastwrite = calc->z80.clock;
@@ -797,6 +850,9 @@ static inline void z80_output(TilemCalc* calc, dword addr, byte value)
 	addr &= 0xffff;
 	check_timers(calc);
 	(*calc->hw.z80_out)(calc, addr, value);
+	tilem_trace_access(calc, TILEM_TRACE_PORT_WRITE, addr, value);
+	if (TILEM_UNLIKELY(calc->perf != NULL))
+		calc->perf->port_writes[addr & 0xff]++;
 	check_breakpoints(calc, calc->z80.breakpoint_pw, addr);
 }
 
@@ -857,6 +913,7 @@ static void z80_execute(TilemCalc* calc)
 	byte busbyte;
 	dword op;
 	dword t1, t2;
+	dword clock0 = z80->clock;
 
 	z80->stopping = 0;
 	z80->stop_reason = 0;
@@ -869,15 +926,26 @@ static void z80_execute(TilemCalc* calc)
 
 	while (!z80->stopping) {
 		z80->exception = 0;
+		if (TILEM_UNLIKELY(calc->profile != NULL))
+			tilem_profile_instr_begin(calc);
+		if (TILEM_UNLIKELY(calc->trace != NULL))
+			tilem_trace_begin(calc);
 		op = (*calc->hw.z80_rdmem_m1)(calc, calc->z80.r.pc.w.l);
 		PC++;
 		Rl++;
 		op = z80_execute_opcode(calc, op);
 		check_breakpoints(calc, z80->breakpoint_op, op);
 		check_timers(calc);
+		if (TILEM_UNLIKELY(calc->trace != NULL))
+			tilem_trace_instr(calc, op);
+		if (TILEM_UNLIKELY(calc->perf != NULL))
+			calc->perf->instructions++;
 
 		if (z80->interrupts && IFF1 && op != 0xfb
 		    && op != 0xddfb && op != 0xfdfb) {
+			if (TILEM_UNLIKELY(calc->profile != NULL))
+				tilem_profile_instr_end(calc, op);
+
 			IFF1 = IFF2 = 0;
 			Rl++;
 			z80->halted = 0;
@@ -897,6 +965,11 @@ static void z80_execute(TilemCalc* calc)
 
 			busbyte = rand() & 0xff;
 
+			/* ...but when recording or replaying, the value
+			   must be reproducible */
+			if (TILEM_UNLIKELY(calc->inputlog != NULL) && IM != 1)
+				busbyte = tilem_input_log_bus_byte(calc, busbyte);
+
 			switch (IM) {
 			case 0:
 				delay(2);
@@ -917,6 +990,12 @@ static void z80_execute(TilemCalc* calc)
 				PC = readw((IR & 0xff00) | busbyte);
 				delay(19);
 			}
+			if (TILEM_UNLIKELY(calc->profile != NULL))
+				tilem_profile_interrupt(calc);
+			if (TILEM_UNLIKELY(calc->trace != NULL))
+				tilem_trace_interrupt(calc);
+			if (TILEM_UNLIKELY(calc->perf != NULL))
+				calc->perf->interrupts++;
 			check_mem_breakpoints(calc, z80->breakpoint_mx, z80->breakpoint_mpx, PC);
 			check_timers(calc);
 		}
@@ -951,18 +1030,42 @@ static void z80_execute(TilemCalc* calc)
 				return;
 			}
 
-			z80->clock += t1 & ~3;
+			/* Stop just short of the timer, so that it
+			   fires at the end of the next HALT cycle -
+			   the same point at which it would fire if
+			   we were not skipping ahead.  (Landing
+			   exactly on the timer would raise the
+			   interrupt here, and it would only be
+			   accepted after one more HALT cycle.  As
+			   that happens only when this timer is the
+			   nearest one, the clock at which the
+			   interrupt is accepted would depend on what
+			   other timers, such as the end of the
+			   current tilem_z80_run, happen to be
+			   set.) */
+			t1 = (t1 - 1) & ~3;
+			z80->clock += t1;
 			Rl += t1 / 4;
+			if (TILEM_UNLIKELY(calc->perf != NULL))
+				calc->perf->halt_cycles += t1;
 			check_timers(calc);
 		}
 
+		if (TILEM_UNLIKELY(calc->profile != NULL))
+			tilem_profile_instr_end(calc, op);
+
 		if (TILEM_UNLIKELY(z80->exception)) {
+			if (calc->trace)
+				tilem_trace_stop(calc, TILEM_STOP_EXCEPTION);
 			if (z80->emuflags & TILEM_Z80_BREAK_EXCEPTIONS)
 				tilem_z80_stop(calc, TILEM_STOP_EXCEPTION);
 			if (!(z80->emuflags & TILEM_Z80_IGNORE_EXCEPTIONS))
 				tilem_calc_reset(calc);
 		}
 	}
+
+	if (calc->perf)
+		calc->perf->cycles += z80->clock - clock0;
 }
 
 static void tmr_stop(TilemCalc* calc, void* data TILEM_ATTR_UNUSED)
@@ -973,7 +1076,13 @@ static void tmr_stop(TilemCalc* calc, void* data TILEM_ATTR_UNUSED)
 dword tilem_z80_run(TilemCalc* calc, int clocks, int* remaining)
 {
 	int tmr = tilem_z80_add_timer(calc, clocks, 0, 0, &tmr_stop, 0);
+	if (calc->inputlog)
+		tilem_input_log_run_begin(calc);
 	z80_execute(calc);
+	if (calc->inputlog)
+		tilem_input_log_run_end(calc);
+	if (calc->trace && calc->z80.stop_reason)
+		tilem_trace_stop(calc, calc->z80.stop_reason);
 	if (remaining)
 		*remaining = tilem_z80_get_timer_clocks(calc, tmr);
 	tilem_z80_remove_timer(calc, tmr);
@@ -983,7 +1092,13 @@ dword tilem_z80_run(TilemCalc* calc, int clocks, int* remaining)
 dword tilem_z80_run_time(TilemCalc* calc, int microseconds, int* remaining)
 {
 	int tmr = tilem_z80_add_timer(calc, microseconds, 0, 1, &tmr_stop, 0);
+	if (calc->inputlog)
+		tilem_input_log_run_begin(calc);
 	z80_execute(calc);
+	if (calc->inputlog)
+		tilem_input_log_run_end(calc);
+	if (calc->trace && calc->z80.stop_reason)
+		tilem_trace_stop(calc, calc->z80.stop_reason);
 	if (remaining)
 		*remaining = tilem_z80_get_timer_microseconds(calc, tmr);
 	tilem_z80_remove_timer(calc, tmr);
@@ -239,7 +239,7 @@ switch (op) {
  case 0x86:
 	 offs = (int) (signed char) readb(PC++);
 	 add8(A, readb(RegHL + offs));
-	 delay(7);
+	 delay(15);
 	 break;
 
  case 0x8C: UNDOCUMENTED(4); adc8(A, RegH); delay(4); break;
@@ -330,7 +330,7 @@ switch (op) {
 
  case 0xF9:			/* LD SP, IX */
 	 SP = RegHL;
-	 delay(4);
+	 delay(6);
 	 break;
 
  default:
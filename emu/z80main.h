@@ -850,7 +850,7 @@ switch (op) {
 	 break;
  case 0xF9:			/* LD SP, HL */
 	 SP = HL;
-	 delay(4);
+	 delay(6);
 	 break;
  case 0xFA:			/* JP M, nn */
 	 WZ = readw(PC);
@@ -49,8 +49,16 @@ QHash<TilemCalc*, Calc*> Calc::m_table;
 	Abstracts away the use of libtilemcore and load/save of roms
 */
 
+// flag in m_lcd_middle marking a frame the GUI hasn't taken yet ; the
+// frame handoff is the one in gui/emulator.c (see lcd_middle in
+// gui/emulator.h), keep the two in step
+#define LCD_FRAME_FRESH 4
+
 Calc::Calc(QObject *p)
- : QObject(p), m_calc(0), m_lcd(0), m_lcd_comp(0)
+ : QObject(p), m_calc(0), m_lcd(0), m_lcd_prev(0),
+   m_lcd_gray(0), m_lcd_target(0), m_lcd_settled(0),
+   m_lcd_low(-1), m_lcd_high(-1),
+   m_lcd_back(1), m_lcd_front(0), m_lcd_middle(2)
 {
 	
 }
@@ -64,8 +72,11 @@ Calc::~Calc()
 	// release memory
 	tilem_calc_free(m_calc);
 	
-	delete m_lcd_comp;
-	delete m_lcd;
+	delete[] m_lcd;
+	delete[] m_lcd_prev;
+	delete[] m_lcd_gray;
+	delete[] m_lcd_target;
+	delete[] m_lcd_settled;
 }
 
 QString Calc::name() const
@@ -357,11 +368,12 @@ void Calc::load(const QString& file)
 		tilem_calc_free(m_calc);
 		m_calc = 0;
 		
-		delete m_lcd_comp;
-		m_lcd_comp = 0;
-		
-		delete m_lcd;
-		m_lcd = 0;
+		delete[] m_lcd;
+		delete[] m_lcd_prev;
+		delete[] m_lcd_gray;
+		delete[] m_lcd_target;
+		delete[] m_lcd_settled;
+		m_lcd = m_lcd_prev = m_lcd_gray = m_lcd_target = m_lcd_settled = 0;
 	}
 	
 	m_romFile = file;
@@ -411,8 +423,25 @@ void Calc::load(const QString& file)
 	m_link_lock = false;
 	
 	// instant LCD state and "composite" LCD state (grayscale is a bitch...)
-	m_lcd = new unsigned char[m_calc->hw.lcdwidth * m_calc->hw.lcdheight / 8];
-	m_lcd_comp = new unsigned int[m_calc->hw.lcdwidth * m_calc->hw.lcdheight];
+	const int w = m_calc->hw.lcdwidth, h = m_calc->hw.lcdheight;
+	
+	m_lcd = new unsigned char[w * h / 8]();
+	m_lcd_prev = new unsigned char[w * h / 8]();
+	m_lcd_gray = new unsigned char[w * h];
+	m_lcd_target = new unsigned char[w];
+	m_lcd_settled = new unsigned char[h]();
+	memset(m_lcd_gray, 0xff, w * h);
+	m_lcd_low = m_lcd_high = -1;
+	
+	m_lcd_comp = QImage(w, h, QImage::Format_RGB32);
+	m_lcd_comp.fill(0xffffffff);
+	
+	for ( int i = 0; i < 3; ++i )
+		m_lcd_frames[i] = m_lcd_comp.copy();
+	
+	m_lcd_front = 0;
+	m_lcd_back = 1;
+	m_lcd_middle.fetchAndStoreOrdered(2);
 	
 	m_calc->lcd.emuflags = TILEM_LCD_REQUIRE_DELAY;
 	m_calc->flash.emuflags = TILEM_FLASH_REQUIRE_DELAY;
@@ -585,6 +614,8 @@ dword Calc::run(int amount, emulator emu)
 // 	if ( m_calc->z80.stop_reason )
 // 		qDebug("stop:%i", m_calc->z80.stop_reason);
 	
+	updateLcdFrame();
+	
 	return m_calc->z80.stop_reason;
 }
 
@@ -608,15 +639,62 @@ void Calc::keyRelease(int sk)
 	tilem_keypad_release_key(m_calc, sk);
 }
 
+/*
+	Take the latest frame produced by the emulation thread, if the GUI
+	hasn't seen it yet. Returns true if lcdImage() has changed.
+*/
 bool Calc::lcdUpdate()
 {
 	if ( m_load_lock || !m_calc )
 		return false;
 	
+	if ( !(m_lcd_middle.fetchAndAddOrdered(0) & LCD_FRAME_FRESH) )
+		return false;
+	
+	// swap our frame with the newest one ; the emulation thread
+	// never touches the front frame so no locking is needed
+	m_lcd_front = m_lcd_middle.fetchAndStoreOrdered(m_lcd_front) & ~LCD_FRAME_FRESH;
+	
+	return true;
+}
+
+/*
+	Blend one row of LCD pixels into the composite gray levels (each
+	level moves 1/8 of the way toward its target, rounding down) and
+	store the result as RGB32. Returns true if any pixel changed.
+	
+	The inner loop has no branches or table lookups, so that the
+	compiler can vectorize it.
+*/
+static bool blendRow(const unsigned char *target, unsigned char *gray,
+					QRgb *out, int w)
+{
+	int diff = 0;
+	
+	for ( int x = 0; x < w; ++x )
+	{
+		const int t = target[x], old = gray[x];
+		const int g = t + (((old - t) * 7) >> 3);
+		
+		diff |= g ^ old;
+		gray[x] = g;
+		out[x] = 0xff000000u | (unsigned int)g * 0x010101u;
+	}
+	
+	return diff != 0;
+}
+
+/*
+	Compose the current LCD state (called from the emulation thread,
+	with m_run locked) and hand it over to the GUI if it changed.
+*/
+void Calc::updateLcdFrame()
+{
 	// low : black, high : white
 	unsigned int low, high;
 	const int cc = int(m_calc->lcd.contrast);
-	const unsigned int end = m_calc->hw.lcdheight * m_calc->hw.lcdwidth;
+	const int w = m_calc->hw.lcdwidth, h = m_calc->hw.lcdheight;
+	const int bw = w / 8;
 	
 	// contrast determination
 	if ( m_calc->lcd.active && !(m_calc->z80.halted && !m_calc->poweronhalt) )
@@ -648,26 +726,48 @@ bool Calc::lcdUpdate()
 		low = high = 0xff;
 	}
 	
-	// update "composite" LCD data
+	if ( int(low) != m_lcd_low || int(high) != m_lcd_high )
+	{
+		for ( int b = 0; b < 256; ++b )
+			for ( int k = 0; k < 8; ++k )
+				m_lcd_expand[b][k] = b & (0x80 >> k) ? low : high;
+		
+		m_lcd_low = low;
+		m_lcd_high = high;
+		memset(m_lcd_settled, 0, h);
+	}
+	
+	// update "composite" LCD data (blending for grayscale), skipping
+	// rows whose LCD bytes are unchanged and whose blend has converged
 	bool changed = false;
 	
-	for ( unsigned int idx = 0; idx < end; ++idx )
+	for ( int y = 0; y < h; ++y )
 	{
-		unsigned int v = m_lcd[idx >> 3] & (0x80 >> (idx & 7)) ? low : high;
+		const unsigned char *raw = m_lcd + y * bw;
+		unsigned char *prev = m_lcd_prev + y * bw;
 		
-		// blending for grayscale
-		unsigned int g = v + ((qRed(m_lcd_comp[idx]) - v) * 7) / 8;
+		if ( m_lcd_settled[y] && !memcmp(raw, prev, bw) )
+			continue;
 		
-		v = qRgb(g, g, g);
+		memcpy(prev, raw, bw);
 		
-		if ( v != m_lcd_comp[idx] )
-		{
-			changed = true;
-			m_lcd_comp[idx] = v;
-		}
+		for ( int i = 0; i < bw; ++i )
+			memcpy(m_lcd_target + i * 8, m_lcd_expand[raw[i]], 8);
+		
+		const bool rowChanged = blendRow(m_lcd_target, m_lcd_gray + y * w,
+						reinterpret_cast<QRgb*>(m_lcd_comp.scanLine(y)), w);
+		
+		m_lcd_settled[y] = !rowChanged;
+		changed |= rowChanged;
 	}
 	
-	return changed;
+	if ( !changed )
+		return;
+	
+	QImage& frame = m_lcd_frames[m_lcd_back];
+	memcpy(frame.bits(), m_lcd_comp.constBits(), m_lcd_comp.byteCount());
+	
+	m_lcd_back = m_lcd_middle.fetchAndStoreOrdered(m_lcd_back | LCD_FRAME_FRESH) & ~LCD_FRAME_FRESH;
 }
 
 int Calc::lcdWidth() const
@@ -680,9 +780,9 @@ int Calc::lcdHeight() const
 	return m_calc ? m_calc->hw.lcdheight : 0;
 }
 
-const unsigned int* Calc::lcdData() const
+const QImage& Calc::lcdImage() const
 {
-	return m_lcd_comp;
+	return m_lcd_frames[m_lcd_front];
 }
 
 /*
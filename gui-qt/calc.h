@@ -27,8 +27,10 @@
 #include <tilem.h>
 
 #include <QHash>
+#include <QImage>
 #include <QObject>
 #include <QMutex>
+#include <QAtomicInt>
 #include <QByteArray>
 #include <QScriptValue>
 #include <QReadWriteLock>
@@ -70,7 +72,7 @@ class Calc : public QObject
 		bool lcdUpdate();
 		int lcdWidth() const;
 		int lcdHeight() const;
-		const unsigned int* lcdData() const;
+		const QImage& lcdImage() const;
 		
 		void resetLink();
 		
@@ -138,6 +140,8 @@ class Calc : public QObject
 		typedef dword (*emulator)(TilemCalc *c, int amount, int *remaining);
 		dword run(int amount, emulator emu);
 		
+		void updateLcdFrame();
+		
 		QString m_romFile, m_name;
 		
 		QMutex m_run;
@@ -145,8 +149,25 @@ class Calc : public QObject
 		
 		QList<int> m_breakIds;
 		
-		unsigned char *m_lcd;
-		unsigned int *m_lcd_comp;
+		// raw LCD bits (this frame and the last one composed)
+		unsigned char *m_lcd, *m_lcd_prev;
+		
+		// "composite" LCD state : gray level of each pixel, and
+		// whether each row has stopped changing
+		unsigned char *m_lcd_gray, *m_lcd_target;
+		unsigned char *m_lcd_settled;
+		QImage m_lcd_comp;
+		
+		// target gray levels for the 8 pixels of each LCD byte
+		unsigned char m_lcd_expand[256][8];
+		int m_lcd_low, m_lcd_high;
+		
+		// finished frames : the emulation thread owns m_lcd_back,
+		// the GUI owns m_lcd_front, and m_lcd_middle holds the
+		// third index (plus a flag if the GUI hasn't taken it yet)
+		QImage m_lcd_frames[3];
+		int m_lcd_back, m_lcd_front;
+		QAtomicInt m_lcd_middle;
 		
 		volatile bool m_load_lock, m_link_lock, m_broadcast;
 		
@@ -194,7 +194,7 @@ class CalcThread : public QThread
 */
 
 CalcView::CalcView(const QString& file, QWidget *p)
-: QFrame(p), m_link(0), m_thread(0), m_hovered(-1), m_scale(1.0), m_skinLess(false), m_skin(0), m_screen(0), m_keymask(0)
+: QFrame(p), m_link(0), m_thread(0), m_hovered(-1), m_scale(1.0), m_skinLess(false), m_skin(0), m_keymask(0)
 {
 	setFocusPolicy(Qt::StrongFocus);
 	setFrameShape(QFrame::StyledPanel);
@@ -263,7 +263,6 @@ CalcView::~CalcView()
 	m_thread->stop();
 	
 	// cleanup
-	delete m_screen;
 	delete m_keymask;
 	delete m_skin;
 }
@@ -297,11 +296,7 @@ void CalcView::reset()
 
 void CalcView::takeScreenshot()
 {
-	const int w = m_calc->lcdWidth();
-	const int h = m_calc->lcdHeight();
-	const void *cd = m_calc->lcdData();
-	
-	QImage cpy(static_cast<const unsigned char*>(cd), w, h, QImage::Format_RGB32);
+	QImage cpy = m_calc->lcdImage().copy();
 	
 	QList<QByteArray> fmts = QImageWriter::supportedImageFormats();
 	
@@ -392,9 +387,9 @@ void CalcView::updateView()
 {
 	if ( m_skinLess )
 	{
-		QBitmap msk(m_screen->size() * m_scale);
+		QBitmap msk(QSize(m_lcdW, m_lcdH) * m_scale);
 		msk.fill(Qt::color1);
-		setFixedSize(m_screen->size() * m_scale);
+		setFixedSize(QSize(m_lcdW, m_lcdH) * m_scale);
 		setMask(msk);
 	} else {
 		QSize sz = m_skin->size() * m_scale;
@@ -533,7 +528,6 @@ void CalcView::setupSkin()
 	// cleanup previous images
 	delete m_keymask;
 	delete m_skin;
-	delete m_screen;
 	
 	QString fn = QDir("skins").filePath(m_model + ".skin");
 	
@@ -565,7 +559,6 @@ void CalcView::loadSkin(Settings& s)
 	}
 	
 	m_skin = new QPixmap(s.resource(s.value("skin")));
-	m_screen = new QImage(m_lcdW, m_lcdH, QImage::Format_RGB32);
 	m_keymask = new QImage(QImage(s.resource(s.value("keymask"))).createHeuristicMask());
 	
 	updateView();
@@ -636,27 +629,10 @@ void CalcView::setScale(float s)
 
 void CalcView::updateLCD()
 {
-	// update QImage and schedule widget repaint
+	// take the latest frame and schedule widget repaint ; the
+	// frame is scaled into the skin when painting
 	if ( m_calc->lcdUpdate() )
 	{
-		const int w = m_calc->lcdWidth();
-		const int h = m_calc->lcdHeight();
-		
-		QRgb *d = reinterpret_cast<QRgb*>(m_screen->bits());
-		const unsigned int *cd = m_calc->lcdData();
-		
-		// write LCD into skin image
-		for ( int i = 0; i < m_lcdH; ++i )
-		{
-			for ( int j = 0; j < m_lcdW; ++j )
-			{
-				int y = (h * i) / m_lcdH;
-				int x = (w * j) / m_lcdW;
-				
-				d[i * m_lcdW + j] = cd[y * w + x];
-			}
-		}
-		
 		if ( m_skinLess )
 			repaint(0, 0, m_lcdW * m_scale, m_lcdH * m_scale);
 		else
@@ -962,7 +938,7 @@ void CalcView::paintEvent(QPaintEvent *e)
 	
 	if ( m_skinLess )
 	{
-		p.drawImage(0, 0, *m_screen);
+		p.drawImage(QRect(0, 0, m_lcdW, m_lcdH), m_calc->lcdImage());
 		return;
 	}
 	
@@ -972,7 +948,7 @@ void CalcView::paintEvent(QPaintEvent *e)
 		p.drawPixmap(0, 0, *m_skin);
 	} else {
 		// screen repaint
-		p.drawImage(m_lcdX, m_lcdY, *m_screen);
+		p.drawImage(QRect(m_lcdX, m_lcdY, m_lcdW, m_lcdH), m_calc->lcdImage());
 		return;
 	}
 	
@@ -994,7 +970,7 @@ void CalcView::paintEvent(QPaintEvent *e)
 	foreach ( int k, m_pressed )
 		p.drawPolygon(m_kBoundaries.at(k), Qt::WindingFill);
 	
-	p.drawImage(m_lcdX, m_lcdY, *m_screen);
+	p.drawImage(QRect(m_lcdX, m_lcdY, m_lcdW, m_lcdH), m_calc->lcdImage());
 }
 
 void CalcView::focusInEvent(QFocusEvent *e)
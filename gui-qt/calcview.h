@@ -165,7 +165,7 @@ class CalcView : public QFrame
 		float m_scale;
 		bool m_skinLess;
 		QPixmap *m_skin;
-		QImage *m_screen, *m_keymask;
+		QImage *m_keymask;
 }; 
 
 #endif // _CALC_VIEW_H_
@@ -15,6 +15,9 @@ CONFIG += debug
 
 #DEFINES += TILEM_QT_LINK_DEBUG
 
+# tilem.h uses the C99 restrict keyword, which C++ lacks
+DEFINES += restrict=__restrict
+
 !disable_link:!win32:system(pkg-config --exists ticonv tifiles2 ticables2 ticalcs2):CONFIG *= enable_link
 
 # link support
@@ -23,150 +23,242 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <gtk/gtk.h>
 #include <ticalcs.h>
 #include <tilem.h>
 #include "gui.h"
 
+struct _TilemGifWriter {
+	FILE *fp;
+	int width;
+	int height;
+	int depth;              /* bits per pixel */
+	int transparent;        /* transparent color index, or -1 */
+	gboolean animated;
+	int nframes;
+	byte *prev;             /* previous frame (full size) */
+	byte *sub;              /* changed region of the current frame */
+};
+
+static void put_short(FILE *fp, int value)
+{
+	fputc(value & 0xff, fp);
+	fputc((value >> 8) & 0xff, fp);
+}
+
+static void write_global_header(TilemGifWriter *gw, const byte *palette,
+                                int palette_size)
+{
+	int i;
+
+	fwrite("GIF89a", 1, 6, gw->fp);
+	put_short(gw->fp, gw->width);
+	put_short(gw->fp, gw->height);
+
+	/* Flags: global color table present, 8-bit color resolution,
+	   table contains 2^depth entries */
+	fputc(0xf0 | (gw->depth - 1), gw->fp);
+	/* Background color index */
+	fputc(0, gw->fp);
+	/* Pixel aspect ratio (unknown) */
+	fputc(0, gw->fp);
+
+	fwrite(palette, 3, palette_size, gw->fp);
+	for (i = palette_size; i < (1 << gw->depth); i++) {
+		fputc(0, gw->fp);
+		fputc(0, gw->fp);
+		fputc(0, gw->fp);
+	}
+}
 
-static void write_global_header(FILE* fp, int width, int height, byte* palette, int palette_size);
-static void write_global_footer(FILE* fp);
-static void write_extension_block(FILE* fout, word delay);
-static void write_image_block_start(FILE *fp, int width, int height);
-static void write_image_block_end(FILE *fp);
-static void write_comment(FILE* fp);
-static void write_application_extension(FILE * fp) ;
-
-static void write_global_header(FILE* fp, int width, int height, byte* palette, int palette_size) {
-	
-	/* Magic number for Gif file format */
-    	char global_header_magic_number[] = {'G', 'I', 'F', '8', '9', 'a'};
-    	/* Size of canvas width on 2 bytes, heigth on 2 bytes */
-	char global_header_canvas[] = {96, 0, 64, 0 };
-
-	global_header_canvas[0] = width; 
-	global_header_canvas[1] = (width >> 8) ; 
-	global_header_canvas[2] = height; 
-	global_header_canvas[3] = (height >> 8); 
-
-	/* Flag */
-	/* The 11th byte is a set of flags  : 
-	bit 0:    Global Color Table Flag (GCTF)
-        bit 1..3: Color Resolution
-        bit 4:    Sort Flag to Global Color Table
-        bit 5..7: Size of Global Color Table: 2^(1+n)
-	It means "use the GCT wich is given after (from the size bit 5..7) and a resolution bit 1..3 
-	The Background color is an index in the Global Color Table
-	*/
-	/* FIXME : if we change the palette size, we need to change this flag too and I don't do this currently */
-    	char global_header_flag[] = { 0xf7 };
-	/* The index in global color table */
-	char global_header_background_index[] = {0x00};
-	/* Aspect pixel ratio (unknown) */
-	char global_header_aspect_pixel_ratio[] = {0x00};
-	
-	
-	fwrite(global_header_magic_number, 6, 1, fp);
-	fwrite(global_header_canvas, 4, 1, fp);
-	fwrite(global_header_flag, 1, 1, fp);
-	fwrite(global_header_background_index, 1, 1, fp);
-	fwrite(global_header_aspect_pixel_ratio, 1, 1, fp);
-	
-	//byte* palette = tilem_color_palette_new_packed(255, 255, 255, 0, 0, 0, 2.2);
-	
-	fwrite(palette, palette_size * 3, 1, fp);
+static void write_comment(FILE *fp)
+{
+	static const char comment[] = {
+		0x21, 0xfe, 8, 'T', 'i', 'l', 'E', 'm', '2', 0, 0, 0 };
+	fwrite(comment, 12, 1, fp);
 }
 
-static void write_global_footer(FILE* fp) {
+/* Netscape looping extension (loop 65535 times) */
+static void write_application_extension(FILE *fp)
+{
+	static const char ext[] = {
+		0x21, 0xff, 0x0b,
+		'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+		0x03, 0x01, 0xff, 0xff, 0x00 };
+	fwrite(ext, 19, 1, fp);
+}
 
-	/* This value means end of gif file */	
-	char footer_trailer[1] = { 0x3b};
-	
-	fwrite(footer_trailer, 1, 1,fp);
+/* Graphic control extension, giving the frame delay (in 1/100
+   second) and transparent color */
+static void write_extension_block(TilemGifWriter *gw, int delay)
+{
+	FILE *fp = gw->fp;
+
+	fputc(0x21, fp);
+	fputc(0xf9, fp);
+	fputc(4, fp);
+	/* Flags: leave the previous frame in place, and mark
+	   transparency if used */
+	fputc(0x04 | (gw->transparent >= 0 ? 0x01 : 0), fp);
+	put_short(fp, delay);
+	fputc(gw->transparent >= 0 ? gw->transparent : 0, fp);
+	fputc(0, fp);
 }
 
+static void write_image_block(TilemGifWriter *gw, int left, int top,
+                              int width, int height,
+                              const byte *pixels, int rowstride)
+{
+	FILE *fp = gw->fp;
+
+	fputc(0x2c, fp);
+	put_short(fp, left);
+	put_short(fp, top);
+	put_short(fp, width);
+	put_short(fp, height);
+	/* Flags: no local color table, not interlaced */
+	fputc(0, fp);
 
-static void write_extension_block(FILE* fp, word delay) {
-
-	/* Extension block introduced by 0x21 ('!'), size before extension_block_terminator, flag byte, delay (10/100) 2 bytes   */
-	char extension_block_header[2] = {0x21, 0xf9};
-	/* Size before extension_block_terminator */
-	char extension_block_size[1] = { 0x04} ;
-	/* Flag (unknown) */
-	char extension_block_flag[1] = { 0x00} ;
-	/* Delay (x/100 sec) on 2 bytes*/
-	char extension_block_delay[2] = {10, 0} ;
-	extension_block_delay[0] = delay;
-	/* The index designed by this variable become transparent even if palette gives a black(or something else) color. */ 
-	char extension_block_transparent_index[1] = {0xff};
-	/* End of extension block */
-	char extension_block_terminator[1] = {0x00};
-
-	fwrite(extension_block_header, 2, 1, fp);
-    	fwrite(extension_block_size, 1, 1, fp);
-    	fwrite(extension_block_flag, 1, 1, fp);
-    	fwrite(extension_block_delay, 2, 1, fp);
-    	fwrite(extension_block_transparent_index, 1, 1, fp);
-    	fwrite(extension_block_terminator, 1, 1, fp);
+	tilem_gif_encode_image(fp, pixels, width, height, rowstride,
+	                       gw->depth);
 
+	/* End of image data */
+	fputc(0, fp);
 }
 
-static void write_image_block_start(FILE *fp, int width, int height) {
+TilemGifWriter * tilem_gif_writer_new(FILE *fp, int width, int height,
+                                      const byte *palette, int palette_size,
+                                      gboolean animated)
+{
+	TilemGifWriter *gw;
+	int ncolors;
+
+	g_return_val_if_fail(fp != NULL, NULL);
+	g_return_val_if_fail(width > 0 && height > 0, NULL);
+	g_return_val_if_fail(palette_size > 0 && palette_size <= 256, NULL);
+
+	gw = g_new0(TilemGifWriter, 1);
+	gw->fp = fp;
+	gw->width = width;
+	gw->height = height;
+	gw->animated = animated;
+
+	/* reserve an extra color for transparency if possible */
+	if (animated && palette_size < 256) {
+		gw->transparent = palette_size;
+		ncolors = palette_size + 1;
+	}
+	else {
+		gw->transparent = -1;
+		ncolors = palette_size;
+	}
 
-	/* Header */
-	char image_block_header[] = { 0x2c};
-	/* Left corner x (2 bytes), left corner y (2 bytes), width (2 bytes), height (2 bytes) */
-	char image_block_canvas[] = { 0, 0, 0, 0, 96, 0, 64, 0};
-	
-	image_block_canvas[4] = width; 
-	image_block_canvas[5] = (width >> 8) ; 
-	image_block_canvas[6] = height; 
-	image_block_canvas[7] = (height >> 8); 
-	/* Flag */
-	char image_block_flag[] = { 0x00 };
+	gw->depth = 1;
+	while ((1 << gw->depth) < ncolors)
+		gw->depth++;
 
-        fwrite(image_block_header, 1, 1, fp);
-    	fwrite(image_block_canvas, 8, 1, fp);
-    	fwrite(image_block_flag, 1, 1, fp);
+	write_global_header(gw, palette, palette_size);
+	if (animated)
+		write_application_extension(fp);
+	write_comment(fp);
 
+	return gw;
 }
 
-static void write_image_block_end(FILE *fp) {
-	
- 	/* Give an end to the image block */
-	char image_block_end[1] = {0x00};
+void tilem_gif_writer_add_frame(TilemGifWriter *gw, const byte *image,
+                                int delay)
+{
+	int width = gw->width, height = gw->height;
+	int left, top, right, bottom, x, y;
+	const byte *cur, *prev;
+	byte *sub;
+
+	g_return_if_fail(gw != NULL);
+	g_return_if_fail(image != NULL);
+
+	if (gw->animated)
+		write_extension_block(gw, CLAMP(delay, 0, 0xffff));
+
+	if (!gw->animated || gw->nframes == 0) {
+		write_image_block(gw, 0, 0, width, height, image, width);
+		if (gw->animated) {
+			gw->prev = g_new(byte, width * height);
+			gw->sub = g_new(byte, width * height);
+			memcpy(gw->prev, image, width * height);
+		}
+		gw->nframes++;
+		return;
+	}
 
-	fwrite(image_block_end, 1, 1,fp);
-}
+	/* find the rectangle containing all changed pixels */
+	left = width;
+	right = -1;
+	top = height;
+	bottom = -1;
+	for (y = 0; y < height; y++) {
+		cur = image + y * width;
+		prev = gw->prev + y * width;
+		if (!memcmp(cur, prev, width))
+			continue;
+
+		if (top > y)
+			top = y;
+		bottom = y;
+
+		for (x = 0; x < left && cur[x] == prev[x]; x++)
+			;
+		left = x;
+		for (x = width - 1; x > right && cur[x] == prev[x]; x--)
+			;
+		right = x;
+	}
 
-static void write_comment(FILE* fp) {
+	if (bottom < 0) {
+		/* nothing changed; write a single pixel to carry the
+		   delay */
+		left = right = top = bottom = 0;
+	}
 
-	char comment[] = {0x21, 0xfe, 8, 'T', 'i', 'l', 'E', 'm', '2', 0, 0, 0};
-	fwrite(comment, 12, 1, fp);
+	width = right - left + 1;
+	height = bottom - top + 1;
+
+	if (gw->transparent >= 0) {
+		/* unchanged pixels are transparent, giving longer
+		   runs for the LZW coder */
+		sub = gw->sub;
+		for (y = top; y <= bottom; y++) {
+			cur = image + y * gw->width;
+			prev = gw->prev + y * gw->width;
+			for (x = left; x <= right; x++)
+				*sub++ = (cur[x] == prev[x]
+				          ? gw->transparent : cur[x]);
+		}
+		write_image_block(gw, left, top, width, height,
+		                  gw->sub, width);
+	}
+	else {
+		write_image_block(gw, left, top, width, height,
+		                  image + top * gw->width + left, gw->width);
+	}
+
+	for (y = top; y <= bottom; y++)
+		memcpy(gw->prev + y * gw->width + left,
+		       image + y * gw->width + left, width);
+
+	gw->nframes++;
 }
 
-static void write_application_extension(FILE * fp) {
-
-	/* Magic number to start the block */
-	char application_extension_magic_number[] = { 0x21, 0xff, 0x0b };
-	/* Application name */
-	char application_extension_application_name[] = { 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0' };
-	/* magic number */
-	char application_extension_data_follow[] = { 0x03, 0x01 };
-	/* 0 to 65535 loop */
-	char application_extension_number_of_loop[] = { 0xff, 0xff};
-	/* the end of the block */	
-	char application_extension_terminator[] = { 0x00 };
-	
-	//char gif_infos[31] = {
-        //0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0xff, 0xff, 0x00	};
-
-	//fwrite(gif_infos, 19, 1, fp);
-	fwrite(application_extension_magic_number, 3, 1, fp);
-	fwrite(application_extension_application_name, 11, 1, fp);
-	fwrite(application_extension_data_follow, 2, 1, fp);
-	fwrite(application_extension_number_of_loop, 2, 1, fp);
-	fwrite(application_extension_terminator, 1, 1, fp);
+void tilem_gif_writer_finish(TilemGifWriter *gw)
+{
+	g_return_if_fail(gw != NULL);
+
+	/* Trailer */
+	fputc(0x3b, gw->fp);
+
+	g_free(gw->prev);
+	g_free(gw->sub);
+	g_free(gw);
 }
 
 /* Apparently, most current web browsers are seriously and
@@ -183,13 +275,42 @@ static void write_application_extension(FILE * fp) {
    longer. */
 #define MIN_FRAME_DELAY 6
 
-void tilem_animation_write_gif(TilemAnimation *anim, byte* palette, int palette_size, FILE *fp)
+/* Number of frames to convert at once */
+#define FRAME_BATCH_SIZE 64
+
+/* Convert a batch of frames and add them to the file */
+static void write_frames(TilemAnimConverter *conv, TilemGifWriter *gw,
+                         TilemAnimFrame **frames, const int *delays,
+                         int nframes, const byte *index_map)
+{
+	byte *images[FRAME_BATCH_SIZE];
+	int width, height, i, j;
+
+	tilem_anim_converter_get_images(conv, frames, nframes, images,
+	                                &width, &height);
+
+	for (i = 0; i < nframes; i++) {
+		if (index_map)
+			for (j = 0; j < width * height; j++)
+				images[i][j] = index_map[images[i][j]];
+
+		tilem_gif_writer_add_frame(gw, images[i], delays[i]);
+		g_free(images[i]);
+	}
+}
+
+void tilem_animation_write_gif(TilemAnimation *anim, const byte *palette,
+                               int palette_size, const byte *index_map,
+                               FILE *fp)
 {
 	GdkPixbufAnimation *ganim;
-	int width, height, delay, n;
+	TilemGifWriter *gw;
+	TilemAnimConverter *conv;
+	int width, height, delay, n, nbatch;
 	gdouble time_stretch, t;
-	byte *image;
 	TilemAnimFrame *frm, *next;
+	TilemAnimFrame *batch[FRAME_BATCH_SIZE];
+	int delays[FRAME_BATCH_SIZE];
 	gboolean is_static;
 
 	g_return_if_fail(TILEM_IS_ANIMATION(anim));
@@ -204,14 +325,15 @@ void tilem_animation_write_gif(TilemAnimation *anim, byte* palette, int palette_
 	frm = tilem_animation_next_frame(anim, NULL);
 	g_return_if_fail(frm != NULL);
 
-	write_global_header(fp, width, height, palette, palette_size);
+	gw = tilem_gif_writer_new(fp, width, height, palette, palette_size,
+	                          !is_static);
+	g_return_if_fail(gw != NULL);
 
-	if (!is_static)
-		write_application_extension(fp);
-
-	write_comment(fp);
+	conv = tilem_anim_converter_new(anim);
 
 	t = MIN_FRAME_DELAY * 5.0;
+	n = 0;
+	nbatch = 0;
 
 	/* FIXME: combine multiple frames by averaging rather than
 	   simply taking the last one */
@@ -230,22 +352,25 @@ void tilem_animation_write_gif(TilemAnimation *anim, byte* palette, int palette_
 			}
 
 			t -= n * 10.0;
-			if (n > 0xffff)
-				n = 0xffff;
-			else if (n < MIN_FRAME_DELAY)
+			if (n < MIN_FRAME_DELAY)
 				n = MIN_FRAME_DELAY;
-			write_extension_block(fp, n);
 		}
 
-		tilem_animation_get_indexed_image(anim, frm, &image,
-		                                  &width, &height);
-		write_image_block_start(fp, width, height);
-		GifEncode(fp, image, 8, width * height);
-		write_image_block_end(fp);
-		g_free(image);
+		batch[nbatch] = frm;
+		delays[nbatch] = n;
+		nbatch++;
+
+		if (nbatch == FRAME_BATCH_SIZE) {
+			write_frames(conv, gw, batch, delays, nbatch, index_map);
+			nbatch = 0;
+		}
 
 		frm = next;
 	}
 
-	write_global_footer(fp);
+	if (nbatch > 0)
+		write_frames(conv, gw, batch, delays, nbatch, index_map);
+
+	tilem_anim_converter_free(conv);
+	tilem_gif_writer_finish(gw);
 }
@@ -36,10 +36,32 @@
 
 #define GAMMA 2.2
 
+/* Maximum number of frames between keyframes */
+#define KEYFRAME_INTERVAL 100
+
+/* Maximum number of frames waiting for color analysis */
+#define MAX_ANALYSIS_QUEUE 8
+
+/* Frame data is stored as the XOR of the frame with the previous
+   frame (or, for a keyframe, the frame itself), compressed with a
+   simple run-length code:
+
+     00-7F      (n + 1) literal bytes follow
+     80-BF x    x repeated ((n & 3F) + 3) times
+     C0-FF x    ((n & 3F) << 8 | x) + 1 zero bytes
+
+   Consecutive frames usually differ in only a few rows, so most
+   frames need only a few bytes.  Frames are decoded on demand,
+   starting from the nearest keyframe (or from the most recently
+   decoded frame, when playing forwards.) */
+
 struct _TilemAnimFrame {
 	struct _TilemAnimFrame *next;
+	struct _TilemAnimFrame *key; /* keyframe this frame is based on */
 	unsigned duration : 24;
 	unsigned contrast : 8;
+	dword index;                 /* position in the animation */
+	dword size;                  /* size of encoded data */
 	byte data[1];
 };
 
@@ -49,7 +71,18 @@ struct _TilemAnimation {
 	int num_frames;
 	TilemAnimFrame *start;
 	TilemAnimFrame *end;
+	TilemAnimFrame *penult; /* frame before end */
 	dword last_stamp;
+	qword last_hash;
+
+	byte *last_data;        /* contents of end frame */
+	byte *zero_data;        /* all zeroes (base for keyframes) */
+	byte *enc_buf;          /* buffer for encoding new frames */
+	int frames_since_key;
+	int bytes_since_key;
+
+	const TilemAnimFrame *dec_frame; /* most recently decoded frame */
+	byte *dec_data;                  /* contents of dec_frame */
 
 	TilemLCDBuffer *temp_buffer;
 
@@ -76,9 +109,31 @@ struct _TilemAnimation {
 	guint8 *cq_image_buf;
 	int cq_image_buf_size;
 
+	/* Color analysis of new frames is done in a separate thread,
+	   so that recording does not slow down emulation.  Frames are
+	   passed to the thread by reference (frame data is never
+	   modified once added), strictly in order, so the palette does
+	   not depend on timing.  If the thread falls behind, further
+	   frames wait in the frame list until the queue has room, or
+	   until the palette is needed. */
+	GThread *an_thread;
+	GAsyncQueue *an_queue;
+	volatile gint an_queued;       /* number of frames in an_queue */
+	volatile gint an_deferred;     /* frames that had to wait */
+	const TilemAnimFrame *an_pending; /* first frame not yet queued */
+	const TilemAnimFrame *an_frame; /* frame in an_data */
+	byte *an_data;
+	byte *an_image;
+	TilemLCDBuffer *an_buffer;
+
 	gboolean out_of_memory;
 };
 
+typedef struct _AnalysisItem {
+	const TilemAnimFrame *frame; /* frame to analyze (NULL to stop) */
+	int contrast;                /* adjusted contrast level */
+} AnalysisItem;
+
 struct _TilemAnimationClass {
 	GdkPixbufAnimationClass parent_class;
 };
@@ -125,6 +180,115 @@ static void free_frame(TilemAnimFrame *frm)
 	g_free(frm);
 }
 
+/* Maximum size of encoded data for a frame of SIZE bytes */
+#define MAX_ENCODED_SIZE(size) ((size) + (size) / 2 + 16)
+
+/* Encode the difference between CUR and PREV */
+static int encode_delta(byte * restrict out, const byte * restrict cur,
+                        const byte * restrict prev, int size)
+{
+	byte *p = out, *lit = NULL;
+	int i = 0, j, n, k;
+	byte v;
+
+	while (i < size) {
+		/* unchanged bytes */
+		for (j = i; j < size && cur[j] == prev[j]; j++)
+			;
+		if (j - i >= 2 || (j == size && j > i)) {
+			for (n = j - i; n > 0; n -= 16384) {
+				k = (n > 16384 ? 16383 : n - 1);
+				*p++ = 0xc0 | (k >> 8);
+				*p++ = k & 0xff;
+			}
+			i = j;
+			lit = NULL;
+			continue;
+		}
+
+		/* repeated difference */
+		v = cur[i] ^ prev[i];
+		for (j = i + 1; j < size && j - i < 66; j++)
+			if ((cur[j] ^ prev[j]) != v)
+				break;
+		if (j - i >= 3) {
+			*p++ = 0x80 | (j - i - 3);
+			*p++ = v;
+			i = j;
+			lit = NULL;
+			continue;
+		}
+
+		/* literal byte */
+		if (lit && *lit < 0x7f) {
+			(*lit)++;
+		}
+		else {
+			lit = p++;
+			*lit = 0;
+		}
+		*p++ = v;
+		i++;
+	}
+
+	return p - out;
+}
+
+/* Apply an encoded difference to DATA */
+static void apply_delta(byte * restrict data, const byte * restrict in,
+                        dword insize)
+{
+	const byte *end = in + insize;
+	byte c, v;
+	int n;
+
+	while (in < end) {
+		c = *in++;
+		if (c < 0x80) {
+			for (n = c + 1; n > 0; n--)
+				*data++ ^= *in++;
+		}
+		else if (c < 0xc0) {
+			v = *in++;
+			for (n = (c & 0x3f) + 3; n > 0; n--)
+				*data++ ^= v;
+		}
+		else {
+			data += ((c & 0x3f) << 8 | *in++) + 1;
+		}
+	}
+}
+
+/* Get the contents of a frame.  The returned buffer is valid until
+   the next call. */
+static const byte * decode_frame(TilemAnimation *anim,
+                                 const TilemAnimFrame *frm)
+{
+	const TilemAnimFrame *f;
+
+	if (anim->dec_frame == frm)
+		return anim->dec_data;
+
+	if (anim->dec_frame && anim->dec_frame->key == frm->key
+	    && anim->dec_frame->index < frm->index) {
+		f = anim->dec_frame->next;
+	}
+	else {
+		memset(anim->dec_data, 0, anim->frame_size);
+		f = frm->key;
+	}
+
+	while (1) {
+		apply_delta(anim->dec_data, f->data, f->size);
+		if (f == frm)
+			break;
+		f = f->next;
+	}
+
+	anim->dec_frame = frm;
+	return anim->dec_data;
+}
+
 static int adjust_contrast(TilemAnimation *anim, int contrast)
 {
 	TilemAnimFrame *frm;
@@ -154,7 +318,132 @@ static void set_lcdbuf_from_frame(TilemAnimation *anim,
 	buf->format = anim->lcdbuf_format;
 	buf->rowstride = anim->frame_rowstride;
 	buf->contrast = adjust_contrast(anim, frm->contrast);
-	buf->data = (byte *) frm->data;
+	buf->data = (byte *) decode_frame(anim, frm);
+}
+
+/* Add a frame to the color histogram (in the analysis thread) */
+static void analyze_frame(TilemAnimation *anim, const AnalysisItem *item)
+{
+	const TilemAnimFrame *frm = item->frame;
+	int width = anim->display_width, height = anim->display_height;
+
+	/* frames arrive in order, so each delta applies to the
+	   previous frame */
+	if (frm->key == frm) {
+		memset(anim->an_data, 0, anim->frame_size);
+	}
+	else {
+		g_return_if_fail(anim->an_frame != NULL);
+		g_return_if_fail(anim->an_frame->key == frm->key);
+		g_return_if_fail(anim->an_frame->index + 1 == frm->index);
+	}
+
+	apply_delta(anim->an_data, frm->data, frm->size);
+	anim->an_frame = frm;
+
+	anim->an_buffer->width = width;
+	anim->an_buffer->height = height;
+	anim->an_buffer->format = anim->lcdbuf_format;
+	anim->an_buffer->rowstride = anim->frame_rowstride;
+	anim->an_buffer->contrast = item->contrast;
+	anim->an_buffer->data = anim->an_data;
+	tilem_draw_lcd_image_rgb(anim->an_buffer, anim->an_image,
+	                         width, height, 3 * width,
+	                         3, anim->palette, TILEM_SCALE_FAST);
+	anim->an_buffer->data = NULL;
+
+	color_histogram_add_pixels(anim->cq_hist, anim->an_image,
+	                           width * height);
+}
+
+static gpointer analysis_main(gpointer data)
+{
+	TilemAnimation *anim = data;
+	AnalysisItem *item;
+
+	while (1) {
+		item = g_async_queue_pop(anim->an_queue);
+		if (!item->frame) {
+			g_free(item);
+			break;
+		}
+
+		analyze_frame(anim, item);
+		g_free(item);
+		g_atomic_int_add(&anim->an_queued, -1);
+	}
+
+	return NULL;
+}
+
+/* Queue pending frames for color analysis, in order.  If LIMIT is
+   set, stop when the queue is full. */
+static void queue_pending(TilemAnimation *anim, gboolean limit)
+{
+	AnalysisItem *item;
+	const TilemAnimFrame *frm;
+
+	while ((frm = anim->an_pending)) {
+		if (limit && (g_atomic_int_get(&anim->an_queued)
+		              >= MAX_ANALYSIS_QUEUE))
+			return;
+
+		/* (a zero-length frame may yet be replaced, so it
+		   can't be handed to the analysis thread) */
+		if (frm->duration == 0)
+			return;
+
+		if (!anim->an_thread) {
+			if (!anim->an_data) {
+				anim->an_data = g_new(byte, anim->frame_size);
+				anim->an_image = g_new(byte,
+				                       (anim->display_width
+				                        * anim->display_height
+				                        * 3));
+				anim->an_buffer = tilem_lcd_buffer_new();
+			}
+			anim->an_thread = g_thread_new("Animation analysis",
+			                               &analysis_main, anim);
+		}
+
+		item = g_new(AnalysisItem, 1);
+		item->frame = frm;
+		item->contrast = adjust_contrast(anim, frm->contrast);
+		g_atomic_int_inc(&anim->an_queued);
+		g_async_queue_push(anim->an_queue, item);
+
+		anim->an_pending = frm->next;
+	}
+}
+
+/* Queue a new frame for color analysis (in the core thread) */
+static void queue_analysis(TilemAnimation *anim, const TilemAnimFrame *frm)
+{
+	if (!anim->an_pending)
+		anim->an_pending = frm;
+
+	queue_pending(anim, TRUE);
+
+	/* don't wait for the analysis thread; the frame stays
+	   pending until there is room */
+	if (anim->an_pending)
+		g_atomic_int_inc(&anim->an_deferred);
+}
+
+/* Wait for all frames to be analyzed */
+static void finish_analysis(TilemAnimation *anim)
+{
+	AnalysisItem *item;
+
+	queue_pending(anim, FALSE);
+
+	if (!anim->an_thread)
+		return;
+
+	item = g_new0(AnalysisItem, 1);
+	g_async_queue_push(anim->an_queue, item);
+	g_thread_join(anim->an_thread);
+	anim->an_thread = NULL;
 }
 
 static void generate_cq_palette(TilemAnimation *anim)
@@ -164,6 +453,8 @@ static void generate_cq_palette(TilemAnimation *anim)
 	if (anim->cq_pal || !anim->cq_hist)
 		return;
 
+	finish_analysis(anim);
+
 	if (anim->cq_grayscale)
 		anim->cq_pal = color_palette_new_gray(256);
 	else if (anim->cq_rgb_fixed)
@@ -298,6 +589,19 @@ static void tilem_animation_finalize(GObject *obj)
 
 	g_return_if_fail(TILEM_IS_ANIMATION(anim));
 
+	/* frames not yet analyzed are no longer needed */
+	anim->an_pending = NULL;
+	finish_analysis(anim);
+	if (anim->an_queue)
+		g_async_queue_unref(anim->an_queue);
+	anim->an_queue = NULL;
+	g_free(anim->an_data);
+	g_free(anim->an_image);
+	anim->an_data = anim->an_image = NULL;
+	if (anim->an_buffer)
+		tilem_lcd_buffer_free(anim->an_buffer);
+	anim->an_buffer = NULL;
+
 	while (anim->start) {
 		frm = anim->start;
 		anim->start = frm->next;
@@ -310,6 +614,14 @@ static void tilem_animation_finalize(GObject *obj)
 		tilem_lcd_buffer_free(anim->temp_buffer);
 	anim->temp_buffer = NULL;
 
+	g_free(anim->last_data);
+	g_free(anim->zero_data);
+	g_free(anim->enc_buf);
+	g_free(anim->dec_data);
+	anim->last_data = anim->zero_data = NULL;
+	anim->enc_buf = anim->dec_data = NULL;
+	anim->dec_frame = NULL;
+
 	if (anim->palette)
 		tilem_free(anim->palette);
 	anim->palette = NULL;
@@ -517,14 +829,25 @@ TilemAnimation * tilem_animation_new(int display_width, int display_height,
 		color_histogram_add_fixed_colors
 			(anim->cq_hist, ti84pc_system_colors,
 			 G_N_ELEMENTS(ti84pc_system_colors));
+
+		anim->an_queue = g_async_queue_new();
 	}
 
 	anim->temp_buffer = tilem_lcd_buffer_new();
 	anim->palette = tilem_color_palette_new(255, 255, 255, 0, 0, 0, GAMMA);
 
-	dummy_frame = alloc_frame(anim->frame_size);
+	anim->last_data = g_new0(byte, anim->frame_size);
+	anim->zero_data = g_new0(byte, anim->frame_size);
+	anim->enc_buf = g_new(byte, MAX_ENCODED_SIZE(anim->frame_size));
+	anim->dec_data = g_new(byte, anim->frame_size);
+
+	/* blank keyframe, replaced by the first real frame */
+	dummy_frame = alloc_frame(1);
+	dummy_frame->key = dummy_frame;
 	dummy_frame->duration = 0;
 	dummy_frame->contrast = 0;
+	dummy_frame->index = 0;
+	dummy_frame->size = 0;
 	anim->start = anim->end = dummy_frame;
 
 	return anim;
@@ -534,7 +857,9 @@ gboolean tilem_animation_append_frame(TilemAnimation *anim,
                                       const TilemLCDBuffer *buf,
                                       int duration)
 {
-	TilemAnimFrame *frm;
+	TilemAnimFrame *frm, *end;
+	gboolean replace, key;
+	int size;
 
 	g_return_val_if_fail(TILEM_IS_ANIMATION(anim), FALSE);
 	g_return_val_if_fail(anim->end != NULL, FALSE);
@@ -547,50 +872,83 @@ gboolean tilem_animation_append_frame(TilemAnimation *anim,
 	if (anim->out_of_memory)
 		return FALSE;
 
-	if (anim->end->contrast == buf->contrast
+	/* if the image hasn't changed, extend the previous frame (a
+	   different hash means the image has certainly changed; an
+	   equal hash must be confirmed by comparing the data) */
+	if (anim->end->duration > 0
+	    && anim->end->contrast == buf->contrast
 	    && (anim->last_stamp == buf->stamp
-	        || !memcmp(anim->end->data, buf->data, anim->frame_size))) {
+	        || ((!buf->hashvalid || anim->last_hash == buf->hash)
+	            && !memcmp(anim->last_data, buf->data,
+	                       anim->frame_size)))) {
 		anim->end->duration += duration;
 	}
 	else {
-		if (anim->end->duration == 0) {
-			frm = anim->end;
-		}
-		else {
-			frm = alloc_frame(anim->frame_size);
-			if (!frm) {
-				anim->out_of_memory = TRUE;
-				return FALSE;
-			}
-			anim->end->next = frm;
-			anim->end = frm;
+		end = anim->end;
+
+		/* a zero-length frame is replaced, rather than kept */
+		replace = (end->duration == 0);
+
+		key = (replace
+		       || anim->frames_since_key >= KEYFRAME_INTERVAL
+		       || anim->bytes_since_key >= anim->frame_size);
+
+		size = encode_delta(anim->enc_buf, buf->data,
+		                    (key ? anim->zero_data : anim->last_data),
+		                    anim->frame_size);
+
+		frm = alloc_frame(size);
+		if (!frm) {
+			anim->out_of_memory = TRUE;
+			return FALSE;
 		}
 
 		frm->contrast = buf->contrast;
 		frm->duration = duration;
-		memcpy(frm->data, buf->data, anim->frame_size);
-
-		if (buf->format != TILEM_LCD_BUF_BLACK_128) {
-			alloc_cq_image_buf(anim, anim->display_width,
-			                   anim->display_height);
-
-			set_lcdbuf_from_frame(anim, anim->temp_buffer, frm);
-			tilem_draw_lcd_image_rgb(anim->temp_buffer,
-			                         anim->cq_image_buf,
-			                         anim->display_width,
-			                         anim->display_height,
-			                         3 * anim->display_width,
-			                         3, anim->palette,
-			                         TILEM_SCALE_FAST);
-			anim->temp_buffer->data = NULL;
-
-			color_histogram_add_pixels(anim->cq_hist,
-			                           anim->cq_image_buf,
-			                           anim->frame_size / 3);
+		frm->size = size;
+		memcpy(frm->data, anim->enc_buf, size);
+
+		if (key) {
+			frm->key = frm;
+			anim->frames_since_key = 0;
+			anim->bytes_since_key = 0;
+		}
+		else {
+			frm->key = end->key;
+			anim->frames_since_key++;
+			anim->bytes_since_key += size;
 		}
+
+		if (replace) {
+			frm->index = end->index;
+			if (anim->penult)
+				anim->penult->next = frm;
+			else
+				anim->start = frm;
+			if (anim->dec_frame == end)
+				anim->dec_frame = NULL;
+			if (anim->an_pending == end)
+				anim->an_pending = frm;
+			free_frame(end);
+		}
+		else {
+			frm->index = end->index + 1;
+			end->next = frm;
+			anim->penult = end;
+		}
+		anim->end = frm;
+
+		memcpy(anim->last_data, buf->data, anim->frame_size);
+
+		/* (a zero-length frame may yet be replaced, so it can't
+		   be handed to the analysis thread) */
+		if (anim->cq_hist && duration > 0)
+			queue_analysis(anim, frm);
 	}
 
 	anim->last_stamp = buf->stamp;
+	anim->last_hash = (buf->hashvalid ? buf->hash
+	                   : tilem_lcd_buffer_hash(buf));
 	return TRUE;
 }
 
@@ -613,6 +971,9 @@ void tilem_animation_set_colors(TilemAnimation *anim,
 	g_return_if_fail(foreground != NULL);
 	g_return_if_fail(background != NULL);
 
+	/* the analysis thread uses the original palette */
+	finish_analysis(anim);
+
 	if (anim->palette)
 		tilem_free(anim->palette);
 
@@ -665,6 +1026,12 @@ gdouble tilem_animation_get_speed(TilemAnimation *anim)
 	return anim->speed;
 }
 
+int tilem_animation_get_deferred_frames(TilemAnimation *anim)
+{
+	g_return_val_if_fail(TILEM_IS_ANIMATION(anim), 0);
+	return g_atomic_int_get(&anim->an_deferred);
+}
+
 TilemAnimFrame *tilem_animation_next_frame(TilemAnimation *anim,
                                            TilemAnimFrame *frm)
 {
@@ -718,6 +1085,251 @@ void tilem_animation_get_indexed_image(TilemAnimation *anim,
 	anim->temp_buffer->data = NULL;
 }
 
+/* Converting frames to indexed images (scaling and color
+   quantization) is done in parallel by a pool of threads.  Each
+   thread needs its own scaling buffers and quantization cache; these
+   are kept in a queue of IndexedImageWorkers, from which each job
+   takes one while it runs.  The pool and workers are kept for the
+   lifetime of the TilemAnimConverter, so they can be reused for
+   every batch of frames. */
+
+/* Maximum number of threads used for converting frames */
+#define MAX_CONVERTER_THREADS 8
+
+typedef struct _IndexedImageWorker {
+	TilemLCDBuffer *lcdbuf;
+	byte *rgb;
+	ColorQuantCache *cache;
+} IndexedImageWorker;
+
+typedef struct _IndexedImageJob {
+	byte *data;      /* copy of frame contents */
+	int contrast;    /* adjusted contrast level */
+	byte *image;     /* output image */
+} IndexedImageJob;
+
+struct _TilemAnimConverter {
+	TilemAnimation *anim;
+	GThreadPool *pool;     /* NULL if converting in the calling
+	                          thread */
+	GAsyncQueue *workers;  /* idle workers */
+	GAsyncQueue *done;     /* finished jobs */
+	volatile gint nworkers;
+};
+
+static int get_num_threads(void)
+{
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	return MIN(g_get_num_processors(), MAX_CONVERTER_THREADS);
+#else
+	return 2;
+#endif
+}
+
+static IndexedImageWorker * indexed_image_worker_new(TilemAnimation *anim)
+{
+	IndexedImageWorker *wk = g_slice_new0(IndexedImageWorker);
+
+	wk->lcdbuf = tilem_lcd_buffer_new();
+	if (anim->cq_pal) {
+		wk->rgb = g_new(byte, anim->image_width * anim->image_height * 3);
+		wk->cache = color_quant_cache_new(anim->cq_pal);
+	}
+	return wk;
+}
+
+static void indexed_image_worker_free(IndexedImageWorker *wk)
+{
+	tilem_lcd_buffer_free(wk->lcdbuf);
+	g_free(wk->rgb);
+	if (wk->cache)
+		color_quant_cache_free(wk->cache);
+	g_slice_free(IndexedImageWorker, wk);
+}
+
+/* Get an idle worker, creating a new one if there are none (may be
+   called in a worker thread) */
+static IndexedImageWorker * get_worker(TilemAnimConverter *conv)
+{
+	IndexedImageWorker *wk;
+
+	wk = g_async_queue_try_pop(conv->workers);
+	if (!wk) {
+		wk = indexed_image_worker_new(conv->anim);
+		g_atomic_int_inc(&conv->nworkers);
+	}
+	return wk;
+}
+
+/* Convert one frame (called in a worker thread; must not modify
+   ANIM) */
+static void run_indexed_image_job(TilemAnimation *anim,
+                                  IndexedImageWorker *wk,
+                                  IndexedImageJob *job)
+{
+	int w = anim->image_width, h = anim->image_height;
+
+	wk->lcdbuf->width = anim->display_width;
+	wk->lcdbuf->height = anim->display_height;
+	wk->lcdbuf->format = anim->lcdbuf_format;
+	wk->lcdbuf->rowstride = anim->frame_rowstride;
+	wk->lcdbuf->contrast = job->contrast;
+	wk->lcdbuf->data = job->data;
+
+	if (anim->lcdbuf_format == TILEM_LCD_BUF_BLACK_128) {
+		tilem_draw_lcd_image_indexed(wk->lcdbuf, job->image,
+		                             w, h, w, TILEM_SCALE_SMOOTH);
+	}
+	else {
+		tilem_draw_lcd_image_rgb(wk->lcdbuf, wk->rgb,
+		                         w, h, w * 3, 3, anim->palette,
+		                         TILEM_SCALE_SMOOTH);
+		color_quant_cache_quantize_image(wk->cache, job->image,
+		                                 wk->rgb, w, h, w * 3);
+	}
+
+	wk->lcdbuf->data = NULL;
+}
+
+static void indexed_image_thread(gpointer data, gpointer user_data)
+{
+	IndexedImageJob *job = data;
+	TilemAnimConverter *conv = user_data;
+	IndexedImageWorker *wk;
+
+	wk = get_worker(conv);
+	run_indexed_image_job(conv->anim, wk, job);
+	g_async_queue_push(conv->workers, wk);
+	g_async_queue_push(conv->done, job);
+}
+
+TilemAnimConverter * tilem_anim_converter_new(TilemAnimation *anim)
+{
+	TilemAnimConverter *conv;
+	int nthreads;
+
+	g_return_val_if_fail(TILEM_IS_ANIMATION(anim), NULL);
+
+	/* the palette must exist before any worker is created */
+	if (anim->lcdbuf_format != TILEM_LCD_BUF_BLACK_128)
+		generate_cq_palette(anim);
+
+	conv = g_slice_new0(TilemAnimConverter);
+	conv->anim = anim;
+	conv->workers = g_async_queue_new();
+	conv->done = g_async_queue_new();
+
+	nthreads = get_num_threads();
+	if (nthreads > 1)
+		conv->pool = g_thread_pool_new(&indexed_image_thread, conv,
+		                               nthreads, FALSE, NULL);
+	return conv;
+}
+
+void tilem_anim_converter_free(TilemAnimConverter *conv)
+{
+	int i;
+
+	g_return_if_fail(conv != NULL);
+
+	if (conv->pool)
+		g_thread_pool_free(conv->pool, FALSE, TRUE);
+
+	for (i = 0; i < conv->nworkers; i++)
+		indexed_image_worker_free(g_async_queue_pop(conv->workers));
+	g_async_queue_unref(conv->workers);
+	g_async_queue_unref(conv->done);
+	g_slice_free(TilemAnimConverter, conv);
+}
+
+void tilem_anim_converter_get_images(TilemAnimConverter *conv,
+                                     TilemAnimFrame **frames,
+                                     int nframes, byte **buffers,
+                                     int *width, int *height)
+{
+	TilemAnimation *anim;
+	IndexedImageJob *jobs;
+	IndexedImageWorker *wk;
+	int i;
+
+	g_return_if_fail(conv != NULL);
+	g_return_if_fail(frames != NULL);
+	g_return_if_fail(buffers != NULL);
+	g_return_if_fail(width != NULL);
+	g_return_if_fail(height != NULL);
+
+	anim = conv->anim;
+	*width = anim->image_width;
+	*height = anim->image_height;
+
+	/* frames are stored as differences, so they must be decoded
+	   in order, before being handed to the threads */
+	jobs = g_new(IndexedImageJob, nframes);
+	for (i = 0; i < nframes; i++) {
+		jobs[i].data = g_memdup(decode_frame(anim, frames[i]),
+		                        anim->frame_size);
+		jobs[i].contrast = adjust_contrast(anim, frames[i]->contrast);
+		jobs[i].image = buffers[i] = g_new(byte, (anim->image_width
+		                                          * anim->image_height));
+	}
+
+	if (!conv->pool || nframes <= 1) {
+		wk = get_worker(conv);
+		for (i = 0; i < nframes; i++)
+			run_indexed_image_job(anim, wk, &jobs[i]);
+		g_async_queue_push(conv->workers, wk);
+	}
+	else {
+		for (i = 0; i < nframes; i++)
+			g_thread_pool_push(conv->pool, &jobs[i], NULL);
+
+		/* wait for all jobs to finish */
+		for (i = 0; i < nframes; i++)
+			g_async_queue_pop(conv->done);
+	}
+
+	for (i = 0; i < nframes; i++)
+		g_free(jobs[i].data);
+	g_free(jobs);
+}
+
+static void set_gif_color(byte *palette, int index, dword color)
+{
+	palette[3 * index] = color >> 16;
+	palette[3 * index + 1] = color >> 8;
+	palette[3 * index + 2] = color;
+}
+
+/* Find which palette entries are used by a monochrome/grayscale
+   animation.  This is only possible if the image is scaled by an
+   integer factor (otherwise, any intermediate value may appear.) */
+static gboolean get_used_colors(TilemAnimation *anim, gboolean *used)
+{
+	int width = anim->display_width, height = anim->display_height;
+	TilemAnimFrame *frm;
+	byte *image;
+	int i;
+
+	if (anim->image_width % width || anim->image_height % height)
+		return FALSE;
+
+	memset(used, 0, 256 * sizeof(gboolean));
+	image = g_new(byte, width * height);
+
+	for (frm = anim->start; frm; frm = frm->next) {
+		set_lcdbuf_from_frame(anim, anim->temp_buffer, frm);
+		tilem_draw_lcd_image_indexed(anim->temp_buffer, image,
+		                             width, height, width,
+		                             TILEM_SCALE_FAST);
+		for (i = 0; i < width * height; i++)
+			used[image[i]] = TRUE;
+	}
+
+	anim->temp_buffer->data = NULL;
+	g_free(image);
+	return TRUE;
+}
+
 gboolean tilem_animation_save(TilemAnimation *anim,
                               const char *fname, const char *type,
                               char **option_keys, char **option_values,
@@ -728,8 +1340,9 @@ gboolean tilem_animation_save(TilemAnimation *anim,
 	int errnum;
 	GdkPixbuf *pb;
 	gboolean status;
-	const dword *palcolors;
-	byte palette[768];
+	byte palette[768], index_map[256];
+	gboolean used[256];
+	const byte *map = NULL;
 	int i, palsize;
 
 	g_return_val_if_fail(TILEM_IS_ANIMATION(anim), FALSE);
@@ -760,21 +1373,29 @@ gboolean tilem_animation_save(TilemAnimation *anim,
 
 	generate_cq_palette(anim);
 	if (anim->cq_pal) {
-		palcolors = anim->cq_pal->colors;
-		palsize = 256;	/* FIXME (write_gif doesn't handle other sizes) */
+		palsize = MAX(anim->cq_pal->ncolors, 1);
+		for (i = 0; i < palsize; i++)
+			set_gif_color(palette, i, anim->cq_pal->colors[i]);
+	}
+	else if (get_used_colors(anim, used)) {
+		/* include only the colors actually used */
+		palsize = 0;
+		for (i = 0; i < 256; i++) {
+			if (used[i]) {
+				index_map[i] = palsize;
+				set_gif_color(palette, palsize, anim->palette[i]);
+				palsize++;
+			}
+		}
+		map = index_map;
 	}
 	else {
-		palcolors = anim->palette;
 		palsize = 256;
+		for (i = 0; i < palsize; i++)
+			set_gif_color(palette, i, anim->palette[i]);
 	}
 
-	for (i = 0; i < palsize; i++) {
-		palette[3 * i] = palcolors[i] >> 16;
-		palette[3 * i + 1] = palcolors[i] >> 8;
-		palette[3 * i + 2] = palcolors[i];
-	}
-
-	tilem_animation_write_gif(anim, palette, palsize, fp);
+	tilem_animation_write_gif(anim, palette, palsize, map, fp);
 
 	if (fclose(fp)) {
 		errnum = errno;
@@ -46,6 +46,12 @@ gboolean tilem_animation_append_frame(TilemAnimation *anim,
                                       const TilemLCDBuffer *buf,
                                       int duration);
 
+/* Get the number of frames that were recorded while the color
+   analysis thread was busy, and so had to wait to be analyzed.
+   (Such frames are still included in the optimized GIF palette, but
+   may delay generating it.) */
+int tilem_animation_get_deferred_frames(TilemAnimation *anim);
+
 /* Set output image size. */
 void tilem_animation_set_size(TilemAnimation *anim, int width, int height);
 
@@ -92,6 +98,27 @@ void tilem_animation_get_indexed_image(TilemAnimation *anim,
                                        byte **buffer,
                                        int *width, int *height);
 
+/* Object for converting many frames of an animation to indexed-color
+   images, using a pool of threads that is kept until the converter
+   is freed. */
+typedef struct _TilemAnimConverter TilemAnimConverter;
+
+/* Create a converter for the frames of ANIM.  The animation's
+   settings must not be changed while the converter exists. */
+TilemAnimConverter * tilem_anim_converter_new(TilemAnimation *anim);
+
+/* Free a converter, and stop its threads. */
+void tilem_anim_converter_free(TilemAnimConverter *conv);
+
+/* Convert a sequence of frames to indexed-color image buffers, as
+   tilem_animation_get_indexed_image().  The frames are converted in
+   parallel; BUFFERS[i] receives the image for FRAMES[i], and must be
+   freed with g_free(). */
+void tilem_anim_converter_get_images(TilemAnimConverter *conv,
+                                     TilemAnimFrame **frames,
+                                     int nframes, byte **buffers,
+                                     int *width, int *height);
+
 /* Save animation to a file.  TYPE is an ASCII string describing the
    type.  Options are specified by OPTION_KEYS and OPTION_VALUES (see
    gdk_pixbuf_savev().) */
@@ -58,6 +58,7 @@ struct _TilemAudioDevice {
 	gboolean buffer_pending;
 	int initial_fill;
 	int underrun_bytes;
+	guint underruns;
 
 	SDL_sem *buffer_count;
 };
@@ -184,11 +185,19 @@ gboolean tilem_audio_device_play_buffer(TilemAudioDevice *dev, GError **err)
 		message(_("WARNING: Audio buffer underrun by %d bytes"),
 		        dev->underrun_bytes);
 		dev->underrun_bytes = 0;
+		dev->underruns++;
 	}
 
 	return TRUE;
 }
 
+guint tilem_audio_device_get_underruns(TilemAudioDevice *dev)
+{
+	guint n = dev->underruns;
+	dev->underruns = 0;
+	return n;
+}
+
 static void io_callback(void *data, Uint8 *buffer, int len)
 {
 	TilemAudioDevice *dev = data;
@@ -422,6 +431,11 @@ void * tilem_audio_device_get_buffer(G_GNUC_UNUSED TilemAudioDevice *dev,
 	return NULL;
 }
 
+guint tilem_audio_device_get_underruns(G_GNUC_UNUSED TilemAudioDevice *dev)
+{
+	return 0;
+}
+
 gboolean tilem_audio_device_play_buffer(G_GNUC_UNUSED TilemAudioDevice *dev,
                                         G_GNUC_UNUSED GError **err)
 {
@@ -74,3 +74,6 @@ void * tilem_audio_device_get_buffer(TilemAudioDevice *dev,
 /* Play contents of output buffer. */
 gboolean tilem_audio_device_play_buffer(TilemAudioDevice *dev,
                                         GError **err);
+
+/* Get number of buffer underruns since the last call. */
+guint tilem_audio_device_get_underruns(TilemAudioDevice *dev);
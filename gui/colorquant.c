@@ -51,10 +51,49 @@ typedef struct {
 	ColorListCell *maxcell;
 } ColorList, ColorHeap;
 
-struct _ColorKDTree {
+/* K-D trees are stored as flat arrays of nodes; CHILD gives the
+   array index of each subtree, or -1 if the subtree is empty.  The
+   root is node 0. */
+
+#define KD_NONE (-1)
+
+typedef struct {
 	dword color;
-	dword value;
-	ColorKDTree *child[2];
+	int value;
+	int child[2];
+} ColorKDNode;
+
+struct _ColorKDTree {
+	int nnodes;
+	ColorKDNode node[256];
+};
+
+/* Lookup cache for quantization.  The table is indexed by the upper
+   6 bits of each color component; each entry records the remaining
+   2 bits of each component (as a tag), and the palette index for
+   that color, or a flag indicating that the color must be
+   dithered. */
+
+#define CACHE_BITS 18
+#define CACHE_SIZE (1 << CACHE_BITS)
+
+#define CACHE_INDEX(c) ((((c) >> 6) & 0x3f000)   \
+                        | (((c) >> 4) & 0xfc0)   \
+                        | (((c) >> 2) & 0x3f))
+#define CACHE_TAG(c) (((((c) >> 12) & 0x30)     \
+                       | (((c) >> 6) & 0xc)     \
+                       | ((c) & 0x3)) << 8)
+
+#define CACHE_VALID    0x8000
+#define CACHE_DITHER   0x4000
+#define CACHE_TAG_MASK 0x3f00
+
+struct _ColorQuantCache {
+	ColorPalette *pal;
+	guint rlevels[256];
+	guint glevels[256];
+	guint blevels[256];
+	guint16 *table;
 };
 
 /**************** Hash tables ****************/
@@ -204,43 +243,46 @@ static void color_heap_sort(ColorHeap *heap)
 /**************** K-D trees ****************/
 
 /* Search for a given color in a ColorKDTree. */
-static ColorKDTree * color_kdtree_find(ColorKDTree *tree, dword color)
+static ColorKDNode * color_kdtree_find(ColorKDTree *tree, dword color)
 {
-	int axis;
+	int axis, n;
 	dword mask;
 
-	while (tree) {
-		for (axis = 0; axis < 24 && tree; axis += 8) {
-			if (tree->color == color)
-				return tree;
+	n = (tree && tree->nnodes ? 0 : KD_NONE);
+	while (n != KD_NONE) {
+		for (axis = 0; axis < 24 && n != KD_NONE; axis += 8) {
+			if (tree->node[n].color == color)
+				return &tree->node[n];
 
 			mask = (0xff << axis);
-			if ((tree->color & mask) >= (color & mask))
-				tree = tree->child[0];
+			if ((tree->node[n].color & mask) >= (color & mask))
+				n = tree->node[n].child[0];
 			else
-				tree = tree->child[1];
+				n = tree->node[n].child[1];
 		}
 	}
 	return NULL;
 }
 
-/* Generate a new balanced ColorKDTree from a list of colors. */
-static ColorKDTree * color_kdtree_new_balanced(int axis, int ncolors,
-                                               const dword *colors)
+/* Add a balanced subtree to a ColorKDTree, containing the given list
+   of colors.  Return the index of the subtree's root node. */
+static int add_balanced_subtree(ColorKDTree *tree, int axis,
+                                int ncolors, const dword *colors)
 {
-	ColorKDTree *tree;
 	ColorHeap *heap;
 	dword colors0[256], colors1[256];
-	int i, nc0, nc1;
-
-	g_return_val_if_fail(ncolors <= 256, NULL);
+	int i, n, nc0, nc1;
 
 	if (ncolors == 0)
-		return NULL;
+		return KD_NONE;
+
+	n = tree->nnodes++;
+	tree->node[n].value = 0;
+	tree->node[n].child[0] = tree->node[n].child[1] = KD_NONE;
+
 	if (ncolors == 1) {
-		tree = g_slice_new0(ColorKDTree);
-		tree->color = colors[0];
-		return tree;
+		tree->node[n].color = colors[0];
+		return n;
 	}
 
 	/* find median of the list */
@@ -263,18 +305,34 @@ static ColorKDTree * color_kdtree_new_balanced(int axis, int ncolors,
 			colors1[nc1++] = colors[i];
 	}
 
-	tree = g_slice_new0(ColorKDTree);
-	tree->color = heap->c[0].color;
+	tree->node[n].color = heap->c[0].color;
 	color_list_free(heap);
 
 	axis = (axis + 8) % 24;
-	tree->child[0] = color_kdtree_new_balanced(axis, nc0, colors0);
-	tree->child[1] = color_kdtree_new_balanced(axis, nc1, colors1);
+	tree->node[n].child[0] = add_balanced_subtree(tree, axis, nc0, colors0);
+	tree->node[n].child[1] = add_balanced_subtree(tree, axis, nc1, colors1);
+	return n;
+}
+
+/* Generate a new balanced ColorKDTree from a list of colors. */
+static ColorKDTree * color_kdtree_new_balanced(int ncolors,
+                                               const dword *colors)
+{
+	ColorKDTree *tree;
+
+	g_return_val_if_fail(ncolors <= 256, NULL);
+
+	if (ncolors == 0)
+		return NULL;
+
+	tree = g_slice_new(ColorKDTree);
+	tree->nnodes = 0;
+	add_balanced_subtree(tree, 0, ncolors, colors);
 	return tree;
 }
 
 /* Compute squared Euclidean distance between two colors */
-static int color_distance(dword c1, dword c2)
+static inline int color_distance(dword c1, dword c2)
 {
 	int i, x, y, d2;
 
@@ -288,22 +346,22 @@ static int color_distance(dword c1, dword c2)
 }
 
 /* Search through a ColorKDTree for the closest color */
-static void find_closest(ColorKDTree *tree, int axis, dword color,
-                         ColorKDTree ** restrict best,
+static void find_closest(const ColorKDNode *nodes, int n, int axis,
+                         dword color, int * restrict best,
                          int * restrict best_distance)
 {
 	int d2, x, y, ch;
 
-	if (!tree)
+	if (n == KD_NONE)
 		return;
 
-	if (tree->color == color) {
-		*best = tree;
+	if (nodes[n].color == color) {
+		*best = n;
 		*best_distance = 0;
 		return;
 	}
 
-	x = (tree->color >> axis) & 0xff;
+	x = (nodes[n].color >> axis) & 0xff;
 	y = (color >> axis) & 0xff;
 	if (x >= y)
 		ch = 0;
@@ -313,44 +371,45 @@ static void find_closest(ColorKDTree *tree, int axis, dword color,
 	axis = (axis + 8) % 24;
 
 	/* Search through "near" subtree first */
-	find_closest(tree->child[ch], axis, color, best, best_distance);
+	find_closest(nodes, nodes[n].child[ch], axis, color,
+	             best, best_distance);
 
 	/* Search through "far" subtree only if the splitting plane is
 	   closer than the best match found so far */
 	if ((x - y) * (x - y) >= *best_distance)
 		return;
 
-	d2 = color_distance(color, tree->color);
+	d2 = color_distance(color, nodes[n].color);
 	if (d2 < *best_distance) {
 		*best_distance = d2;
-		*best = tree;
+		*best = n;
 	}
 
-	find_closest(tree->child[!ch], axis, color, best, best_distance);
+	find_closest(nodes, nodes[n].child[!ch], axis, color,
+	             best, best_distance);
 }
 
 /* Find the color in the ColorKDTree that is closest (in Euclidean
    distance in RGB space) to the given color. */
-static ColorKDTree * color_kdtree_find_closest(ColorKDTree *tree, dword color,
-                                               int *distance)
+static const ColorKDNode * color_kdtree_find_closest(const ColorKDTree *tree,
+                                                     dword color,
+                                                     int *distance)
 {
-	ColorKDTree *best = NULL;
+	int best = KD_NONE;
 	int best_distance = G_MAXINT;
 
-	find_closest(tree, 0, color, &best, &best_distance);
+	if (tree && tree->nnodes)
+		find_closest(tree->node, 0, 0, color, &best, &best_distance);
 	if (distance)
 		*distance = best_distance;
-	return best;
+	return (best == KD_NONE ? NULL : &tree->node[best]);
 }
 
 /* Free a ColorKDTree. */
 static void color_kdtree_free(ColorKDTree *tree)
 {
-	if (tree) {
-		color_kdtree_free(tree->child[0]);
-		color_kdtree_free(tree->child[1]);
+	if (tree)
 		g_slice_free(ColorKDTree, tree);
-	}
 }
 
 /**************** ColorHistogram ****************/
@@ -505,10 +564,10 @@ static int add_color(ColorPalette *pal, dword color)
 static void gen_tree(ColorPalette *pal)
 {
 	int i;
-	ColorKDTree *t;
+	ColorKDNode *t;
 
 	color_kdtree_free(pal->tree);
-	pal->tree = color_kdtree_new_balanced(0, pal->ncolors, pal->colors);
+	pal->tree = color_kdtree_new_balanced(pal->ncolors, pal->colors);
 	for (i = 0; i < pal->ncolors; i++) {
 		t = color_kdtree_find(pal->tree, pal->colors[i]);
 		if (t)
@@ -651,6 +710,8 @@ ColorPalette * color_palette_new_rgb(int maxcolors, ColorHistogram *hist,
 void color_palette_free(ColorPalette *pal)
 {
 	g_return_if_fail(pal != NULL);
+	if (pal->cache)
+		color_quant_cache_free(pal->cache);
 	color_kdtree_free(pal->tree);
 	if (pal->htab)
 		g_hash_table_destroy(pal->htab);
@@ -752,37 +813,19 @@ static inline int dither_coord(guint value, const guint *levels,
 		return i;
 }
 
-static inline unsigned int quantize_pixel(dword color, ColorPalette *pal,
-                                          int vpos, int hpos,
-                                          const guint *rlevels,
-                                          const guint *glevels,
-                                          const guint *blevels)
+/* Find the palette entry for a color (ignoring the dither pattern.)
+   Return value is the palette index, or CACHE_DITHER if the color
+   must be dithered. */
+static unsigned int lookup_color(const ColorQuantCache *cache, dword color)
 {
-	guint i, rv, gv, bv, ri, gi, bi, dither, y, a, b, c;
-	ColorKDTree *t;
-	const int *rgbtab;
+	const ColorPalette *pal = cache->pal;
+	const guint *levels = cache->rlevels;
+	const ColorKDNode *t;
+	guint i, y, a, b, c;
 
 	if (pal->nrvalues) {
 		i = color_hash_table_get(pal->htab, color);
-		if (i)
-			return i - 1;
-
-		hpos &= DITHER_WIDTH - 1;
-		vpos &= DITHER_HEIGHT - 1;
-		dither = dither_pattern[vpos * DITHER_WIDTH + hpos];
-
-		rgbtab = get_srgb_conv_table();
-		rv = rgbtab[(color >> 16) & 0xff];
-		gv = rgbtab[(color >> 8) & 0xff];
-		bv = rgbtab[color & 0xff];
-		ri = dither_coord(rv, rlevels, pal->nrvalues, dither);
-		gi = dither_coord(gv, glevels, pal->ngvalues,
-		                  DITHER_MAX - dither - 1);
-		bi = dither_coord(bv, blevels, pal->nbvalues, dither);
-
-		return (ri * pal->ngvalues * pal->nbvalues
-		        + gi * pal->nbvalues
-		        + bi);
+		return (i ? i - 1 : CACHE_DITHER);
 	}
 	else if (pal->grayscale) {
 		y = srgb_to_y(color);
@@ -790,14 +833,14 @@ static inline unsigned int quantize_pixel(dword color, ColorPalette *pal,
 		b = pal->ncolors - 1;
 		while (a + 1 < b) {
 			c = (a + b) / 2;
-			if (y == rlevels[c])
+			if (y == levels[c])
 				return c;
-			else if (y > rlevels[c])
+			else if (y > levels[c])
 				a = c;
 			else
 				b = c;
 		}
-		if (y - rlevels[a] < rlevels[a + 1] - y)
+		if (y - levels[a] < levels[a + 1] - y)
 			return a;
 		else
 			return a + 1;
@@ -809,55 +852,126 @@ static inline unsigned int quantize_pixel(dword color, ColorPalette *pal,
 
 		t = color_kdtree_find_closest(pal->tree, color, NULL);
 		g_return_val_if_fail(t != NULL, 0);
-		color_hash_table_put(pal->htab, color, t->value + 1);
 		return t->value;
 	}
 }
 
-void color_palette_quantize_image(ColorPalette *pal,
-                                  byte * restrict buffer,
-                                  const byte * restrict image,
-                                  int width, int height, int rowstride)
+static inline unsigned int quantize_pixel(ColorQuantCache *cache,
+                                          dword color, int vpos, int hpos)
+{
+	const ColorPalette *pal = cache->pal;
+	guint16 *ent = &cache->table[CACHE_INDEX(color)];
+	guint tag = CACHE_VALID | CACHE_TAG(color);
+	guint v, rv, gv, bv, ri, gi, bi, dither;
+	const int *rgbtab;
+
+	if (TILEM_LIKELY((*ent & (CACHE_VALID | CACHE_TAG_MASK)) == tag)) {
+		v = *ent;
+	}
+	else {
+		v = lookup_color(cache, color);
+		*ent = tag | v;
+	}
+
+	if (TILEM_LIKELY(!(v & CACHE_DITHER)))
+		return v & 0xff;
+
+	hpos &= DITHER_WIDTH - 1;
+	vpos &= DITHER_HEIGHT - 1;
+	dither = dither_pattern[vpos * DITHER_WIDTH + hpos];
+
+	rgbtab = get_srgb_conv_table();
+	rv = rgbtab[(color >> 16) & 0xff];
+	gv = rgbtab[(color >> 8) & 0xff];
+	bv = rgbtab[color & 0xff];
+	ri = dither_coord(rv, cache->rlevels, pal->nrvalues, dither);
+	gi = dither_coord(gv, cache->glevels, pal->ngvalues,
+	                  DITHER_MAX - dither - 1);
+	bi = dither_coord(bv, cache->blevels, pal->nbvalues, dither);
+
+	return (ri * pal->ngvalues * pal->nbvalues
+	        + gi * pal->nbvalues
+	        + bi);
+}
+
+ColorQuantCache * color_quant_cache_new(ColorPalette *pal)
 {
 	const int *rgbtab = get_srgb_conv_table();
-	guint rlevels[256], glevels[256], blevels[256];
-	int i, j;
+	ColorQuantCache *cache;
+	int i;
 	dword c;
 
-	g_return_if_fail(pal != NULL);
-	g_return_if_fail(image != NULL);
-	g_return_if_fail(buffer != NULL);
+	g_return_val_if_fail(pal != NULL, NULL);
+
+	cache = g_slice_new0(ColorQuantCache);
+	cache->pal = pal;
+	cache->table = g_new0(guint16, CACHE_SIZE);
 
 	/* convert color cube to linear R, G, B coordinates */
 
 	for (i = 0; i < pal->nrvalues; i++) {
 		c = pal->colors[i * pal->ngvalues * pal->nbvalues];
-		rlevels[i] = rgbtab[(c >> 16) & 0xff];
+		cache->rlevels[i] = rgbtab[(c >> 16) & 0xff];
 	}
 	for (i = 0; i < pal->ngvalues; i++) {
 		c = pal->colors[i * pal->nbvalues];
-		glevels[i] = rgbtab[(c >> 8) & 0xff];
+		cache->glevels[i] = rgbtab[(c >> 8) & 0xff];
 	}
 	for (i = 0; i < pal->nbvalues; i++) {
 		c = pal->colors[i];
-		blevels[i] = rgbtab[c & 0xff];
+		cache->blevels[i] = rgbtab[c & 0xff];
 	}
 
 	/* grayscale: convert palette to linear luminance */
 
 	if (pal->grayscale)
 		for (i = 0; i < pal->ncolors; i++)
-			rlevels[i] = srgb_to_y(pal->colors[i]);
+			cache->rlevels[i] = srgb_to_y(pal->colors[i]);
+
+	return cache;
+}
+
+void color_quant_cache_free(ColorQuantCache *cache)
+{
+	g_return_if_fail(cache != NULL);
+	g_free(cache->table);
+	g_slice_free(ColorQuantCache, cache);
+}
+
+void color_quant_cache_quantize_image(ColorQuantCache *cache,
+                                      byte * restrict buffer,
+                                      const byte * restrict image,
+                                      int width, int height, int rowstride)
+{
+	int i, j;
+	dword c;
+
+	g_return_if_fail(cache != NULL);
+	g_return_if_fail(image != NULL);
+	g_return_if_fail(buffer != NULL);
 
 	for (i = 0; i < height; i++) {
 		for (j = 0; j < width; j++) {
 			c = (image[3 * j] << 16
 			     | image[3 * j + 1] << 8
 			     | image[3 * j + 2]);
-			*buffer = quantize_pixel(c, pal, i, j, rlevels,
-			                         glevels, blevels);
+			*buffer = quantize_pixel(cache, c, i, j);
 			buffer++;
 		}
 		image += rowstride;
 	}
 }
+
+void color_palette_quantize_image(ColorPalette *pal,
+                                  byte * restrict buffer,
+                                  const byte * restrict image,
+                                  int width, int height, int rowstride)
+{
+	g_return_if_fail(pal != NULL);
+
+	if (!pal->cache)
+		pal->cache = color_quant_cache_new(pal);
+
+	color_quant_cache_quantize_image(pal->cache, buffer, image,
+	                                 width, height, rowstride);
+}
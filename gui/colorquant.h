@@ -19,6 +19,7 @@
 
 typedef struct _ColorHistogram ColorHistogram;
 typedef struct _ColorKDTree ColorKDTree;
+typedef struct _ColorQuantCache ColorQuantCache;
 
 typedef struct _ColorPalette {
 	/* List of colors in the palette */
@@ -40,6 +41,9 @@ typedef struct _ColorPalette {
 
 	/* K-D tree used to find closest color in the palette */
 	ColorKDTree *tree;
+
+	/* Lookup cache used by color_palette_quantize_image() */
+	ColorQuantCache *cache;
 } ColorPalette;
 
 /* Create a new empty color histogram. */
@@ -81,3 +85,19 @@ void color_palette_quantize_image(ColorPalette *pal,
                                   byte * restrict buffer,
                                   const byte * restrict image,
                                   int width, int height, int rowstride);
+
+/* Create a cache for quantizing images using the given palette.  The
+   cache must be freed before the palette.  A cache may only be used
+   by one thread at a time, but any number of caches may be used
+   concurrently with the same palette. */
+ColorQuantCache * color_quant_cache_new(ColorPalette *pal);
+
+/* Free a quantization cache. */
+void color_quant_cache_free(ColorQuantCache *cache);
+
+/* Quantize an RGB image, as color_palette_quantize_image(), using the
+   given cache. */
+void color_quant_cache_quantize_image(ColorQuantCache *cache,
+                                      byte * restrict buffer,
+                                      const byte * restrict image,
+                                      int width, int height, int rowstride);
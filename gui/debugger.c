@@ -35,6 +35,7 @@
 #include "disasmview.h"
 #include "files.h"
 #include "msgbox.h"
+#include "filedlg.h"
 #include "fixedtreeview.h"
 #include "memmodel.h"
 
@@ -370,6 +371,13 @@ static void action_edit_breakpoints(G_GNUC_UNUSED GtkAction *a, gpointer data)
 	tilem_debugger_edit_breakpoints(dbg);
 }
 
+/* Show recently executed instructions */
+static void action_view_trace(G_GNUC_UNUSED GtkAction *a, gpointer data)
+{
+	TilemDebugger *dbg = data;
+	tilem_debugger_show_trace(dbg);
+}
+
 /* Close debugger window */
 static void action_close(G_GNUC_UNUSED GtkAction *a, gpointer data)
 {
@@ -401,6 +409,72 @@ static void action_view_keypad(GtkToggleAction *action, gpointer data)
 		gtk_widget_hide(dbg->keypad_dialog->window);
 }
 
+/* Start or stop profiling */
+static void action_profile(GtkToggleAction *action, gpointer data)
+{
+	TilemDebugger *dbg = data;
+	TilemProfile *prof;
+	char *dir, *filename, *dname;
+	FILE *f;
+	int status;
+
+	if (gtk_toggle_action_get_active(action)) {
+		tilem_calc_emulator_begin_profile
+			(dbg->emu, tilem_disasm_get_romcall_rst(dbg->dasm));
+		return;
+	}
+
+	prof = tilem_calc_emulator_end_profile(dbg->emu);
+	if (!prof)
+		return;
+
+	tilem_config_get("debugger",
+	                 "profile_directory/f", &dir,
+	                 NULL);
+
+	filename = prompt_save_file(_("Save Profile"),
+	                            GTK_WINDOW(dbg->window),
+	                            "callgrind.out", dir,
+	                            _("Callgrind files"), "callgrind.out*",
+	                            _("All files"), "*",
+	                            NULL);
+	g_free(dir);
+
+	if (filename) {
+		f = g_fopen(filename, "w");
+		status = -1;
+		if (f) {
+			tilem_calc_emulator_lock(dbg->emu);
+			status = tilem_disasm_write_profile
+				(dbg->dasm, prof, f,
+				 dbg->emu->calc ? dbg->emu->calc->hw.desc : NULL);
+			tilem_calc_emulator_unlock(dbg->emu);
+			if (fclose(f))
+				status = -1;
+		}
+
+		if (status) {
+			dname = g_filename_display_name(filename);
+			messagebox01(GTK_WINDOW(dbg->window), GTK_MESSAGE_ERROR,
+			             _("Unable to save profile"),
+			             _("An error occurred while writing %s."),
+			             dname);
+			g_free(dname);
+		}
+		else {
+			dir = g_path_get_dirname(filename);
+			tilem_config_set("debugger",
+			                 "profile_directory/f", dir,
+			                 NULL);
+			g_free(dir);
+		}
+
+		g_free(filename);
+	}
+
+	tilem_profile_free(prof);
+}
+
 /* Set memory addressing mode */
 static void action_mem_mode(GtkRadioAction *action,
                             G_GNUC_UNUSED GtkRadioAction *current,
@@ -543,6 +617,9 @@ static const GtkActionEntry paused_action_ents[] =
 	 { "edit-breakpoints", NULL, N_("_Breakpoints"), "<control>B",
 	   N_("Add, remove, or modify breakpoints"),
 	   G_CALLBACK(action_edit_breakpoints) },
+	 { "view-trace", NULL, N_("_Recent Instructions"), "<control>T",
+	   N_("Show the most recently executed instructions"),
+	   G_CALLBACK(action_view_trace) },
 	 { "go-to-address", GTK_STOCK_JUMP_TO, N_("_Address..."), "<control>L",
 	   N_("Jump to an address"),
 	   G_CALLBACK(action_go_to_address) },
@@ -578,7 +655,10 @@ static const GtkActionEntry misc_action_ents[] =
 static const GtkToggleActionEntry misc_toggle_ents[] =
 	{{ "view-keypad", 0, N_("_Keypad"), 0,
 	   N_("Show the calculator keypad state"),
-	   G_CALLBACK(action_view_keypad), FALSE }};
+	   G_CALLBACK(action_view_keypad), FALSE },
+	 { "profile", 0, N_("_Profile"), 0,
+	   N_("Count the instructions and cycles spent in each function"),
+	   G_CALLBACK(action_profile), FALSE }};
 
 /* Callbacks */
 
@@ -858,11 +938,13 @@ static const char uidesc[] =
 	"  <menuitem action='finish'/>"
 	"  <separator/>"
 	"  <menuitem action='edit-breakpoints'/>"
+	"  <menuitem action='profile'/>"
 	"  <separator/>"
 	"  <menuitem action='close'/>"
 	" </menu>"
 	" <menu action='view-menu'>"
 	"  <menuitem action='view-keypad'/>"
+	"  <menuitem action='view-trace'/>"
 	"  <separator/>"
 	"  <menuitem action='view-logical'/>"
 	"  <menuitem action='view-absolute'/>"
@@ -1263,6 +1345,7 @@ void tilem_debugger_hide(TilemDebugger *dbg)
 void tilem_debugger_calc_changed(TilemDebugger *dbg)
 {
 	TilemCalc *calc;
+	GtkAction *action;
 
 	g_return_if_fail(dbg != NULL);
 
@@ -1273,6 +1356,11 @@ void tilem_debugger_calc_changed(TilemDebugger *dbg)
 
 	free_all_breakpoints(dbg);
 
+	/* any profile in progress was discarded along with the old
+	   calc */
+	action = gtk_action_group_get_action(dbg->misc_actions, "profile");
+	gtk_toggle_action_set_active(GTK_TOGGLE_ACTION(action), FALSE);
+
 	calc = dbg->emu->calc;
 	if (!calc)
 		return;
@@ -124,6 +124,9 @@ void tilem_debugger_change_breakpoint(TilemDebugger *dbg,
 /* Show a dialog letting the user add, remove, and edit breakpoints. */
 void tilem_debugger_edit_breakpoints(TilemDebugger *dbg);
 
+/* Show a list of the most recently executed instructions. */
+void tilem_debugger_show_trace(TilemDebugger *dbg);
+
 
 /* Memory view */
 
@@ -104,29 +104,11 @@ static gboolean calc_asleep(TilemCalcEmulator *emu)
 	        && !emu->key_queue_timer);
 }
 
-static gboolean refresh_lcd(gpointer data)
-{
-	TilemCalcEmulator* emu = data;
-
-	if (emu->ewin)
-		tilem_emulator_window_refresh_lcd(emu->ewin);
-
-	return FALSE;
-}
-
 /* Update screen for display while paused */
 static void update_screen_mono(TilemCalcEmulator *emu)
 {
-	g_mutex_lock(emu->lcd_mutex);
-
 	tilem_lcd_get_frame(emu->calc, emu->lcd_buffer);
-
-	if (!emu->lcd_update_pending) {
-		emu->lcd_update_pending = TRUE;
-		g_idle_add_full(G_PRIORITY_DEFAULT, &refresh_lcd, emu, NULL);
-	}
-
-	g_mutex_unlock(emu->lcd_mutex);
+	tilem_calc_emulator_publish_lcd(emu);
 }
 
 /* idle callback to update progress bar */
@@ -495,6 +477,9 @@ static void update_audio(TilemCalcEmulator *emu)
 			return;
 		}
 
+		emu->telemetry.audio_underruns
+			+= tilem_audio_device_get_underruns(emu->audio_device);
+
 		audio_set_buffer(emu, buffer, size, FALSE);
 	}
 }
@@ -531,6 +516,7 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 	int delaytime;
 	CableHandle *cable = NULL;
 	gboolean raw_mode = FALSE;
+	gint64 t0, t1, t2;
 
 	all_events = events | BREAK_MASK;
 
@@ -561,7 +547,9 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 		update_screen_mono(emu);
 		update_progress(emu, TRUE);
 		audio_close(emu);
+		t0 = g_get_monotonic_time();
 		g_cond_wait(emu->calc_wakeup_cond, emu->calc_mutex);
+		emu->telemetry.idle_time += g_get_monotonic_time() - t0;
 		update_progress(emu, TRUE);
 		g_timer_elapsed(emu->timer, &emu->timevalue);
 		if (elapsed) *elapsed = 0;
@@ -571,7 +559,9 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 		update_progress(emu, FALSE);
 		update_screen_mono(emu);
 		audio_close(emu);
+		t0 = g_get_monotonic_time();
 		g_cond_wait(emu->calc_wakeup_cond, emu->calc_mutex);
+		emu->telemetry.idle_time += g_get_monotonic_time() - t0;
 		g_timer_elapsed(emu->timer, &emu->timevalue);
 		if (elapsed) *elapsed = timeout;
 		return 0;
@@ -592,7 +582,11 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 	if (emu->high_res_time > 0 && timeout > HIGH_RES_TICK)
 		timeout = HIGH_RES_TICK;
 
+	t0 = g_get_monotonic_time();
 	tilem_z80_run_time(emu->calc, timeout, &rem);
+	t1 = g_get_monotonic_time();
+	emu->telemetry.run_time += t1 - t0;
+	emu->telemetry.emulated_time += timeout - rem;
 
 	ev_user = emu->calc->z80.stop_reason & events;
 	ev_auto = emu->calc->z80.stop_reason & ~events;
@@ -637,6 +631,8 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 
 		delaytime = sub_us(emu->timevalue, tcur);
 
+		t1 = g_get_monotonic_time();
+
 		if (emu->high_res_time >= 0) {
 			if (delaytime > 0) {
 				do {
@@ -654,15 +650,27 @@ dword tilem_em_run(TilemCalcEmulator *emu, int linkmode,
 				emu->timevalue = tcur;
 		}
 
+		t2 = g_get_monotonic_time();
 		tilem_em_lock(emu);
+
+		/* (update only while locked, so that other threads
+		   can read a consistent snapshot) */
+		if (emu->high_res_time >= 0)
+			emu->telemetry.spin_time += t2 - t1;
+		else
+			emu->telemetry.sleep_time += t2 - t1;
+		emu->telemetry.lock_wait_time += g_get_monotonic_time() - t2;
 	}
 	else if (cable && !raw_mode) {
 		tilem_em_unlock(emu);
 		update_ext_cable_cooked(emu, cable);
+		t2 = g_get_monotonic_time();
 		tilem_em_lock(emu);
+		emu->telemetry.lock_wait_time += g_get_monotonic_time() - t2;
 	}
 	else {
 		tilem_em_check_yield(emu);
+		emu->telemetry.lock_wait_time += g_get_monotonic_time() - t1;
 	}
 
 	if (emu->high_res_time >= 0)
@@ -38,9 +38,19 @@
 #define MILLISEC_PER_FRAME 30
 #define MICROSEC_PER_FRAME (MILLISEC_PER_FRAME * 1000)
 
+#define VIDEO_GAMMA 2.2
+
 #define GRAY_WINDOW_SIZE 4
 #define GRAY_SAMPLE_INT 200
 
+/* Size of the execution trace buffer (about 4 bytes per instruction) */
+#define TRACE_BUFFER_SIZE 65536
+
+/* Number of instructions written in automatic trace dumps */
+#define TRACE_DUMP_LENGTH 200
+#define TRACE_DUMP_REASONS (TILEM_STOP_BREAKPOINT | TILEM_STOP_EXCEPTION \
+                            | TILEM_STOP_INVALID_INST)
+
 
 /* Lock emulator.  Notify the core loop that we wish to do so - note
    that if the core is running at full speed, it keeps the mutex
@@ -63,24 +73,129 @@ void tilem_calc_emulator_unlock(TilemCalcEmulator *emu)
 	g_mutex_unlock(emu->calc_mutex);
 }
 
+/* Flag in lcd_middle indicating a frame the GUI has not yet taken.
+   gui-qt/calc.cpp implements the same handoff with the same flag;
+   keep the two in step. */
+#define LCD_FRAME_FRESH 4
+
+static gint atomic_exchange(volatile gint *p, gint value)
+{
+	gint old;
+
+	do {
+		old = g_atomic_int_get(p);
+	} while (!g_atomic_int_compare_and_exchange(p, old, value));
+
+	return old;
+}
+
 static gboolean refresh_lcd(gpointer data)
 {
 	TilemCalcEmulator* emu = data;
 
-	if (emu->ewin)
-		tilem_emulator_window_refresh_lcd(emu->ewin);
+	if (emu->ewin) {
+		tilem_emulator_window_update_lcd(emu->ewin);
+	}
+	else {
+		tilem_calc_emulator_take_lcd(emu);
+		tilem_calc_emulator_request_lcd(emu, 0);
+	}
 
 	return FALSE;
 }
 
+void tilem_calc_emulator_publish_lcd(TilemCalcEmulator *emu)
+{
+	int ystart, yend;
+	gint old;
+
+	if (!tilem_lcd_buffer_get_dirty_rows(emu->lcd_buffer, 0,
+	                                     &ystart, &yend))
+		return;
+
+	/* rows may have changed and changed back again; the dirty
+	   rows are kept for the next frame that is published */
+	if (emu->lcd_seq_published
+	    && emu->lcd_buffer->hash == emu->lcd_hash_published)
+		return;
+	emu->lcd_hash_published = emu->lcd_buffer->hash;
+
+	tilem_lcd_buffer_copy(emu->lcd_frames[emu->lcd_back],
+	                      emu->lcd_buffer);
+	tilem_lcd_buffer_clear_dirty(emu->lcd_buffer);
+	emu->lcd_frame_seq[emu->lcd_back] = ++emu->lcd_seq_published;
+	g_atomic_int_set(&emu->lcd_frame_request, 0);
+
+	old = atomic_exchange(&emu->lcd_middle,
+	                      emu->lcd_back | LCD_FRAME_FRESH);
+	emu->lcd_back = old & ~LCD_FRAME_FRESH;
+
+	/* if the previous frame was never taken, the GUI has an
+	   update pending already */
+	if (!(old & LCD_FRAME_FRESH))
+		g_idle_add_full(G_PRIORITY_DEFAULT, &refresh_lcd, emu, NULL);
+}
+
+void tilem_calc_emulator_request_lcd(TilemCalcEmulator *emu, int interval)
+{
+	g_atomic_int_set(&emu->lcd_frame_interval, interval);
+	g_atomic_int_set(&emu->lcd_frame_request, 1);
+}
+
+gboolean tilem_calc_emulator_take_lcd(TilemCalcEmulator *emu)
+{
+	TilemLCDBuffer *buf;
+	gint old;
+
+	if (!(g_atomic_int_get(&emu->lcd_middle) & LCD_FRAME_FRESH))
+		return FALSE;
+
+	old = atomic_exchange(&emu->lcd_middle, emu->lcd_front);
+	emu->lcd_front = old & ~LCD_FRAME_FRESH;
+	buf = emu->lcd_frames[emu->lcd_front];
+
+	/* each frame's dirty mask is relative to the frame published
+	   before it, so if any were skipped, redraw everything */
+	if (emu->lcd_frame_seq[emu->lcd_front] != emu->lcd_seq_shown + 1)
+		tilem_lcd_buffer_set_dirty(buf, 0, buf->height);
+	emu->lcd_seq_shown = emu->lcd_frame_seq[emu->lcd_front];
+
+	return TRUE;
+}
+
+/* Check whether the GUI can display a new frame */
+static gboolean lcd_frame_wanted(TilemCalcEmulator *emu, gint64 t)
+{
+	if (!g_atomic_int_get(&emu->lcd_frame_request))
+		return FALSE;
+
+	/* when running faster than real time, don't produce frames
+	   faster than the display can show them */
+	return (t - emu->lcd_frame_time
+	        >= g_atomic_int_get(&emu->lcd_frame_interval));
+}
+
 static void tmr_screen_update(TilemCalc *calc, void *data)
 {
 	TilemCalcEmulator *emu = data;
-	dword old_stamp;
-
-	g_mutex_lock(emu->lcd_mutex);
+	gboolean wanted;
+	gint64 t0;
+
+	t0 = g_get_monotonic_time();
+
+	/* skip extracting frames that will never be shown (unless
+	   they're needed for an animation or video) */
+	wanted = lcd_frame_wanted(emu, t0);
+	if (!wanted && !emu->anim && !emu->video) {
+		/* the grayscale window must still advance every frame,
+		   or its change history grows without bound */
+		if (emu->glcd)
+			tilem_gray_lcd_next_frame(emu->glcd);
+		return;
+	}
 
-	old_stamp = emu->lcd_buffer->stamp;
+	if (wanted)
+		emu->lcd_frame_time = t0;
 
 	if (emu->glcd)
 		tilem_gray_lcd_get_frame(emu->glcd, emu->lcd_buffer);
@@ -101,14 +216,50 @@ static void tmr_screen_update(TilemCalc *calc, void *data)
 		}
 	}
 
-	/* don't force an update if screen hasn't changed (or if we're
-	   still waiting for the GUI to handle our last update) */
-	if (!emu->lcd_update_pending && emu->lcd_buffer->stamp != old_stamp) {
-		emu->lcd_update_pending = TRUE;
-		g_idle_add_full(G_PRIORITY_DEFAULT, &refresh_lcd, emu, NULL);
+	if (emu->video && tilem_video_writer_add_frame(emu->video,
+	                                               emu->lcd_buffer,
+	                                               MICROSEC_PER_FRAME)) {
+		/* stop recording; the error is reported by
+		   tilem_calc_emulator_end_video() */
+		tilem_video_writer_free(emu->video);
+		emu->video = NULL;
+		emu->video_error = TRUE;
 	}
 
-	g_mutex_unlock(emu->lcd_mutex);
+	if (wanted)
+		tilem_calc_emulator_publish_lcd(emu);
+
+	emu->telemetry.lcd_time += g_get_monotonic_time() - t0;
+	emu->telemetry.lcd_frames++;
+}
+
+static void free_lcd_frames(TilemCalcEmulator *emu)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (emu->lcd_frames[i])
+			tilem_lcd_buffer_free(emu->lcd_frames[i]);
+		emu->lcd_frames[i] = NULL;
+	}
+}
+
+/* Create empty frame buffers (the core thread must be locked, and
+   this must be called from the GUI thread) */
+static void new_lcd_frames(TilemCalcEmulator *emu)
+{
+	int i;
+
+	free_lcd_frames(emu);
+	for (i = 0; i < 3; i++) {
+		emu->lcd_frames[i] = tilem_lcd_buffer_new();
+		emu->lcd_frame_seq[i] = 0;
+	}
+	emu->lcd_front = 0;
+	emu->lcd_back = 1;
+	g_atomic_int_set(&emu->lcd_middle, 2);
+	emu->lcd_seq_published = 0;
+	emu->lcd_seq_shown = 0;
 }
 
 static void cancel_animation(TilemCalcEmulator *emu)
@@ -118,6 +269,53 @@ static void cancel_animation(TilemCalcEmulator *emu)
 	emu->anim = NULL;
 }
 
+static gboolean end_video(TilemCalcEmulator *emu)
+{
+	gboolean status = !emu->video_error;
+
+	if (emu->video) {
+		if (tilem_video_writer_free(emu->video))
+			status = FALSE;
+		emu->video = NULL;
+	}
+	if (emu->video_file) {
+		if (emu->video_file != stdout && fclose(emu->video_file))
+			status = FALSE;
+		emu->video_file = NULL;
+	}
+	emu->video_error = FALSE;
+	return status;
+}
+
+static void end_input_log(TilemCalcEmulator *emu)
+{
+	if (emu->input_log) {
+		tilem_input_log_free(emu->input_log);
+		emu->input_log = NULL;
+	}
+	if (emu->input_log_file) {
+		fclose(emu->input_log_file);
+		emu->input_log_file = NULL;
+	}
+}
+
+static void cancel_profile(TilemCalcEmulator *emu)
+{
+	if (emu->profile)
+		tilem_profile_free(emu->profile);
+	emu->profile = NULL;
+}
+
+static void new_trace(TilemCalcEmulator *emu)
+{
+	if (emu->trace)
+		tilem_trace_free(emu->trace);
+	emu->trace = tilem_trace_new(emu->calc, TRACE_BUFFER_SIZE, 0);
+	if (emu->trace_dump_file)
+		tilem_trace_set_autodump(emu->trace, emu->trace_dump_file,
+		                         TRACE_DUMP_REASONS, TRACE_DUMP_LENGTH);
+}
+
 static GtkWidget *get_toplevel(TilemCalcEmulator *emu)
 {
 	if (emu->ewin)
@@ -142,8 +340,7 @@ TilemCalcEmulator *tilem_calc_emulator_new()
 	g_mutex_init(emu->calc_mutex);
 	emu->calc_wakeup_cond = (GCond*) g_new(GCond*, 1);
 	g_cond_init(emu->calc_wakeup_cond);
-	emu->lcd_mutex = (GMutex*) g_new(GMutex*, 1);
-	g_mutex_init(emu->lcd_mutex);
+	emu->lcd_frame_request = 1;
 
 	tilem_config_get("emulation",
 	                 "grayscale/b=1", &emu->grayscale,
@@ -155,6 +352,7 @@ TilemCalcEmulator *tilem_calc_emulator_new()
 	g_cond_init(emu->task_finished_cond);
 
 	emu->timer = g_timer_new();
+	emu->telemetry_start = g_get_monotonic_time();
 
 	emu->pbar_mutex = (GMutex*) g_new(GMutex*, 1);
 	g_mutex_init(emu->pbar_mutex);
@@ -201,6 +399,9 @@ void tilem_calc_emulator_free(TilemCalcEmulator *emu)
 
 	tilem_calc_emulator_lock(emu);
 	cancel_animation(emu);
+	cancel_profile(emu);
+	end_input_log(emu);
+	end_video(emu);
 	emu->exiting = TRUE;
 	tilem_calc_emulator_unlock(emu);
 
@@ -213,7 +414,6 @@ void tilem_calc_emulator_free(TilemCalcEmulator *emu)
 	g_free(emu->state_file_name);
 
 	g_mutex_clear(emu->calc_mutex);
-	g_mutex_clear(emu->lcd_mutex);
 	g_cond_clear(emu->calc_wakeup_cond);
 
 	g_cond_clear(emu->task_finished_cond);
@@ -230,10 +430,15 @@ void tilem_calc_emulator_free(TilemCalcEmulator *emu)
 		tilem_lcd_buffer_free(emu->lcd_buffer);
 	if (emu->tmp_lcd_buffer)
 		tilem_lcd_buffer_free(emu->tmp_lcd_buffer);
+	free_lcd_frames(emu);
 	if (emu->audio_filter)
 		tilem_audio_filter_free(emu->audio_filter);
 	if (emu->glcd)
 		tilem_gray_lcd_free(emu->glcd);
+	if (emu->trace)
+		tilem_trace_free(emu->trace);
+	if (emu->trace_dump_file)
+		fclose(emu->trace_dump_file);
 	if (emu->calc)
 		tilem_calc_free(emu->calc);
 
@@ -397,17 +602,31 @@ gboolean tilem_calc_emulator_load_state(TilemCalcEmulator *emu,
 	tilem_calc_emulator_lock(emu);
 
 	cancel_animation(emu);
+	cancel_profile(emu);
+	end_input_log(emu);
+	end_video(emu);
 
 	if (emu->audio_filter)
 		tilem_audio_filter_free(emu->audio_filter);
  	if (emu->glcd)
 		tilem_gray_lcd_free(emu->glcd);
+	if (emu->trace)
+		tilem_trace_free(emu->trace);
+	emu->trace = NULL;
 	if (emu->calc)
 		tilem_calc_free(emu->calc);
 
 	emu->calc = calc;
+	new_trace(emu);
+	if (emu->perf_counters)
+		tilem_perf_counters_enable(calc, 1);
+	if (emu->lcd_buffer)
+		tilem_lcd_buffer_free(emu->lcd_buffer);
+	if (emu->tmp_lcd_buffer)
+		tilem_lcd_buffer_free(emu->tmp_lcd_buffer);
 	emu->lcd_buffer = tilem_lcd_buffer_new();
 	emu->tmp_lcd_buffer = tilem_lcd_buffer_new();
+	new_lcd_frames(emu);
 
 	if (emu->grayscale && !(calc->hw.flags & TILEM_CALC_HAS_COLOR))
 		emu->glcd = tilem_gray_lcd_new(calc, GRAY_WINDOW_SIZE,
@@ -503,6 +722,11 @@ gboolean tilem_calc_emulator_revert_state(TilemCalcEmulator *emu, GError **err)
 		status = FALSE;
 	}
 
+	/* instructions executed before loading are no longer
+	   meaningful */
+	if (emu->trace)
+		tilem_trace_clear(emu->trace);
+
 	tilem_calc_emulator_unlock(emu);
 
 	if (emu->dbg)
@@ -707,6 +931,286 @@ void tilem_calc_emulator_set_link_cable(TilemCalcEmulator *emu,
 	tilem_calc_emulator_unlock(emu);
 }
 
+gboolean tilem_calc_emulator_begin_input_log(TilemCalcEmulator *emu,
+                                             const char *filename,
+                                             gboolean replay,
+                                             GError **err)
+{
+	FILE *f;
+	char *dname;
+	int errnum;
+
+	g_return_val_if_fail(emu != NULL, FALSE);
+	g_return_val_if_fail(emu->calc != NULL, FALSE);
+	g_return_val_if_fail(filename != NULL, FALSE);
+
+	f = g_fopen(filename, replay ? "rb" : "wb");
+	if (!f) {
+		errnum = errno;
+		dname = g_filename_display_basename(filename);
+		g_set_error(err, G_FILE_ERROR,
+		            g_file_error_from_errno(errnum),
+		            _("Unable to open %s: %s"),
+		            dname, g_strerror(errnum));
+		g_free(dname);
+		return FALSE;
+	}
+
+	tilem_calc_emulator_lock(emu);
+	end_input_log(emu);
+
+	if (replay)
+		emu->input_log = tilem_input_log_replay(emu->calc, f);
+	else
+		emu->input_log = tilem_input_log_record(emu->calc, f);
+
+	if (!emu->input_log) {
+		tilem_calc_emulator_unlock(emu);
+		fclose(f);
+		dname = g_filename_display_basename(filename);
+		g_set_error(err, TILEM_EMULATOR_ERROR,
+		            TILEM_EMULATOR_ERROR_INVALID_STATE,
+		            (replay
+		             ? _("The file %s is not a valid input log"
+		                 " for this calculator.")
+		             : _("Unable to write to %s.")),
+		            dname);
+		g_free(dname);
+		return FALSE;
+	}
+
+	emu->input_log_file = f;
+	tilem_calc_emulator_unlock(emu);
+	return TRUE;
+}
+
+void tilem_calc_emulator_end_input_log(TilemCalcEmulator *emu)
+{
+	g_return_if_fail(emu != NULL);
+
+	tilem_calc_emulator_lock(emu);
+	end_input_log(emu);
+	tilem_calc_emulator_unlock(emu);
+}
+
+gboolean tilem_calc_emulator_begin_video(TilemCalcEmulator *emu,
+                                         const char *filename,
+                                         int fps, GError **err)
+{
+	FILE *f;
+	char *dname;
+	int errnum, format;
+	dword *palette;
+
+	g_return_val_if_fail(emu != NULL, FALSE);
+	g_return_val_if_fail(emu->calc != NULL, FALSE);
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(fps > 0, FALSE);
+
+	if (!strcmp(filename, "-"))
+		f = stdout;
+	else
+		f = g_fopen(filename, "wb");
+
+	if (!f) {
+		errnum = errno;
+		dname = g_filename_display_basename(filename);
+		g_set_error(err, G_FILE_ERROR,
+		            g_file_error_from_errno(errnum),
+		            _("Unable to open %s: %s"),
+		            dname, g_strerror(errnum));
+		g_free(dname);
+		return FALSE;
+	}
+
+	if (g_str_has_suffix(filename, ".y4m"))
+		format = TILEM_VIDEO_Y4M;
+	else
+		format = TILEM_VIDEO_RGB24;
+
+	palette = tilem_color_palette_new(255, 255, 255, 0, 0, 0,
+	                                  VIDEO_GAMMA);
+
+	tilem_calc_emulator_lock(emu);
+	end_video(emu);
+
+	emu->video = tilem_video_writer_new(f, format,
+	                                    emu->calc->hw.lcdwidth * 2,
+	                                    emu->calc->hw.lcdheight * 2,
+	                                    fps, palette);
+	tilem_free(palette);
+
+	if (!emu->video) {
+		tilem_calc_emulator_unlock(emu);
+		if (f != stdout)
+			fclose(f);
+		dname = g_filename_display_basename(filename);
+		g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_IO,
+		            _("Unable to write to %s."), dname);
+		g_free(dname);
+		return FALSE;
+	}
+
+	emu->video_file = f;
+	tilem_calc_emulator_unlock(emu);
+	return TRUE;
+}
+
+gboolean tilem_calc_emulator_end_video(TilemCalcEmulator *emu)
+{
+	gboolean status;
+
+	g_return_val_if_fail(emu != NULL, FALSE);
+
+	tilem_calc_emulator_lock(emu);
+	status = end_video(emu);
+	tilem_calc_emulator_unlock(emu);
+	return status;
+}
+
+void tilem_calc_emulator_begin_profile(TilemCalcEmulator *emu,
+                                       int romcallrst)
+{
+	g_return_if_fail(emu != NULL);
+	g_return_if_fail(emu->calc != NULL);
+
+	tilem_calc_emulator_lock(emu);
+	cancel_profile(emu);
+	emu->profile = tilem_profile_new(emu->calc, romcallrst);
+	tilem_calc_emulator_unlock(emu);
+}
+
+TilemProfile * tilem_calc_emulator_end_profile(TilemCalcEmulator *emu)
+{
+	TilemProfile *prof;
+
+	g_return_val_if_fail(emu != NULL, NULL);
+
+	tilem_calc_emulator_lock(emu);
+	prof = emu->profile;
+	emu->profile = NULL;
+	if (prof)
+		tilem_profile_detach(prof);
+	tilem_calc_emulator_unlock(emu);
+
+	return prof;
+}
+
+gboolean tilem_calc_emulator_set_trace_dump(TilemCalcEmulator *emu,
+                                            const char *filename,
+                                            GError **err)
+{
+	FILE *f;
+	char *dname;
+	int errnum;
+
+	g_return_val_if_fail(emu != NULL, FALSE);
+	g_return_val_if_fail(filename != NULL, FALSE);
+
+	f = g_fopen(filename, "w");
+	if (!f) {
+		errnum = errno;
+		dname = g_filename_display_basename(filename);
+		g_set_error(err, G_FILE_ERROR,
+		            g_file_error_from_errno(errnum),
+		            _("Unable to open %s: %s"),
+		            dname, g_strerror(errnum));
+		g_free(dname);
+		return FALSE;
+	}
+
+	tilem_calc_emulator_lock(emu);
+	if (emu->trace_dump_file)
+		fclose(emu->trace_dump_file);
+	emu->trace_dump_file = f;
+	if (emu->trace)
+		tilem_trace_set_autodump(emu->trace, f, TRACE_DUMP_REASONS,
+		                         TRACE_DUMP_LENGTH);
+	tilem_calc_emulator_unlock(emu);
+	return TRUE;
+}
+
+void tilem_calc_emulator_set_perf_counters(TilemCalcEmulator *emu,
+                                           gboolean enable)
+{
+	g_return_if_fail(emu != NULL);
+
+	tilem_calc_emulator_lock(emu);
+	emu->perf_counters = enable;
+	if (emu->calc)
+		tilem_perf_counters_enable(emu->calc, enable);
+	tilem_calc_emulator_unlock(emu);
+}
+
+void tilem_calc_emulator_get_telemetry(TilemCalcEmulator *emu,
+                                       TilemEmulatorTelemetry *t)
+{
+	g_return_if_fail(emu != NULL);
+	g_return_if_fail(t != NULL);
+
+	tilem_calc_emulator_lock(emu);
+	*t = emu->telemetry;
+	t->wall_time = g_get_monotonic_time() - emu->telemetry_start;
+	tilem_calc_emulator_unlock(emu);
+}
+
+void tilem_calc_emulator_reset_telemetry(TilemCalcEmulator *emu)
+{
+	g_return_if_fail(emu != NULL);
+
+	tilem_calc_emulator_lock(emu);
+	memset(&emu->telemetry, 0, sizeof(TilemEmulatorTelemetry));
+	emu->telemetry_start = g_get_monotonic_time();
+	tilem_calc_emulator_unlock(emu);
+}
+
+/* Percentage of wall time */
+static double wall_percent(const TilemEmulatorTelemetry *t, gint64 v)
+{
+	return (t->wall_time ? 100.0 * v / t->wall_time : 0.0);
+}
+
+gboolean tilem_calc_emulator_write_telemetry(TilemCalcEmulator *emu,
+                                             FILE *outfile)
+{
+	TilemEmulatorTelemetry t;
+
+	g_return_val_if_fail(emu != NULL, FALSE);
+	g_return_val_if_fail(outfile != NULL, FALSE);
+
+	tilem_calc_emulator_get_telemetry(emu, &t);
+
+	fprintf(outfile, "wall_time_us %" G_GINT64_FORMAT "\n", t.wall_time);
+	fprintf(outfile, "emulated_time_us %" G_GINT64_FORMAT "\n",
+	        t.emulated_time);
+	fprintf(outfile, "run_time_us %" G_GINT64_FORMAT "\n", t.run_time);
+	fprintf(outfile, "sleep_time_us %" G_GINT64_FORMAT "\n", t.sleep_time);
+	fprintf(outfile, "spin_time_us %" G_GINT64_FORMAT "\n", t.spin_time);
+	fprintf(outfile, "idle_time_us %" G_GINT64_FORMAT "\n", t.idle_time);
+	fprintf(outfile, "lock_wait_time_us %" G_GINT64_FORMAT "\n",
+	        t.lock_wait_time);
+	fprintf(outfile, "lcd_time_us %" G_GINT64_FORMAT "\n", t.lcd_time);
+	fprintf(outfile, "lcd_frames %u\n", t.lcd_frames);
+	fprintf(outfile, "audio_underruns %u\n", t.audio_underruns);
+	fprintf(outfile, "anim_deferred_frames %u\n", t.anim_deferred_frames);
+
+	/* derived values */
+	fprintf(outfile, "host_ns_per_emulated_ms %.0f\n",
+	        (t.emulated_time
+	         ? 1e6 * t.run_time / t.emulated_time : 0.0));
+	fprintf(outfile, "lcd_us_per_frame %.1f\n",
+	        (t.lcd_frames ? (double) t.lcd_time / t.lcd_frames : 0.0));
+	fprintf(outfile, "run_percent %.1f\n", wall_percent(&t, t.run_time));
+	fprintf(outfile, "sleep_percent %.1f\n",
+	        wall_percent(&t, t.sleep_time));
+	fprintf(outfile, "spin_percent %.1f\n", wall_percent(&t, t.spin_time));
+	fprintf(outfile, "idle_percent %.1f\n", wall_percent(&t, t.idle_time));
+	fprintf(outfile, "lock_wait_percent %.1f\n",
+	        wall_percent(&t, t.lock_wait_time));
+
+	return !ferror(outfile);
+}
+
 /* If currently recording a macro, record a keypress */
 static void record_key(TilemCalcEmulator* emu, int code)
 {
@@ -936,6 +1440,8 @@ TilemAnimation * tilem_calc_emulator_end_animation(TilemCalcEmulator *emu)
 	tilem_calc_emulator_lock(emu);
 	anim = emu->anim;
 	emu->anim = NULL;
+	emu->telemetry.anim_deferred_frames
+		+= tilem_animation_get_deferred_frames(anim);
 	tilem_calc_emulator_unlock(emu);
 
 	return anim;
@@ -39,6 +39,26 @@ typedef struct _TilemMacro {
 } TilemMacro;
 
 
+/* Host time accounting (all times in microseconds) */
+typedef struct _TilemEmulatorTelemetry {
+	gint64 wall_time;	/* Host time since telemetry was reset */
+	gint64 emulated_time;	/* Calculator time emulated */
+	gint64 run_time;	/* Host time spent emulating */
+	gint64 sleep_time;	/* Host time spent sleeping to limit speed */
+	gint64 spin_time;	/* Host time spent busy-waiting to limit
+				   speed (for link cable timing) */
+	gint64 idle_time;	/* Host time spent waiting while paused or
+				   while calculator is turned off */
+	gint64 lock_wait_time;	/* Host time the core thread spent waiting
+				   for other threads to release the
+				   emulator lock */
+	gint64 lcd_time;	/* Host time spent capturing LCD frames
+				   (included in run_time) */
+	guint lcd_frames;	/* Number of LCD frames captured */
+	guint audio_underruns;	/* Number of audio buffer underruns */
+	guint anim_deferred_frames; /* Number of animation frames whose
+				       palette analysis had to wait */
+} TilemEmulatorTelemetry;
 
 typedef struct _TilemCalcEmulator {
 	GThread *z80_thread;
@@ -92,16 +112,55 @@ typedef struct _TilemCalcEmulator {
 	int key_queue_cur;
 	int key_queue_hold;
 
-	GMutex *lcd_mutex;
-	TilemLCDBuffer *lcd_buffer;
+	TilemLCDBuffer *lcd_buffer; /* frame being extracted (core thread) */
 	TilemLCDBuffer *tmp_lcd_buffer;
 	TilemGrayLCD *glcd;
 	gboolean grayscale;
-	gboolean lcd_update_pending;
+
+	/* Finished frames, handed from the core thread to the GUI
+	   without locking.  The core thread owns lcd_frames[lcd_back]
+	   and the GUI owns lcd_frames[lcd_front]; lcd_middle holds the
+	   index of the third buffer, plus LCD_FRAME_FRESH if the GUI
+	   has not yet taken it.  Each side swaps its own buffer with
+	   the middle one. */
+	TilemLCDBuffer *lcd_frames[3];
+	dword lcd_frame_seq[3];
+	int lcd_back;
+	int lcd_front;
+	volatile gint lcd_middle;
+	dword lcd_seq_published;
+	dword lcd_seq_shown;
+	qword lcd_hash_published;
+
+	/* Frame pacing: the GUI sets lcd_frame_request when it is ready
+	   to display another frame, and lcd_frame_interval to the
+	   display's refresh interval (in microseconds.)  The core
+	   thread extracts a frame for display only when one has been
+	   requested, and no more often than the refresh interval. */
+	volatile gint lcd_frame_request;
+	volatile gint lcd_frame_interval;
+	gint64 lcd_frame_time;
 
 	TilemAnimation *anim; /* animation being recorded */
 	gboolean anim_grayscale; /* use grayscale in animation */
 
+	TilemVideoWriter *video; /* video being recorded */
+	FILE *video_file;
+	gboolean video_error; /* write error while recording video */
+
+	TilemInputLog *input_log; /* input log being recorded/replayed */
+	FILE *input_log_file;
+
+	TilemProfile *profile; /* profile being recorded */
+
+	TilemTrace *trace; /* recently executed instructions */
+	FILE *trace_dump_file; /* file for automatic trace dumps */
+
+	gboolean perf_counters; /* enable performance counters */
+
+	TilemEmulatorTelemetry telemetry; /* host time accounting */
+	gint64 telemetry_start;
+
 	char *rom_file_name;
 	char *state_file_name;
 
@@ -155,6 +214,20 @@ void tilem_calc_emulator_lock(TilemCalcEmulator *emu);
 /* Unlock calculator and allow emulation to continue. */
 void tilem_calc_emulator_unlock(TilemCalcEmulator *emu);
 
+/* Hand the current contents of lcd_buffer over to the GUI, if any
+   rows have changed.  (Core thread only.) */
+void tilem_calc_emulator_publish_lcd(TilemCalcEmulator *emu);
+
+/* Ask the core thread for another frame, to be extracted no sooner
+   than INTERVAL microseconds after the previous one.  (GUI thread
+   only.) */
+void tilem_calc_emulator_request_lcd(TilemCalcEmulator *emu, int interval);
+
+/* Take the most recent frame from the core thread, if there is one
+   the GUI has not yet seen, and make it lcd_frames[lcd_front].
+   Return TRUE if the frame has changed.  (GUI thread only.) */
+gboolean tilem_calc_emulator_take_lcd(TilemCalcEmulator *emu);
+
 /* Load the calculator state from the given ROM file (and accompanying
    sav file, if any.) */
 gboolean tilem_calc_emulator_load_state(TilemCalcEmulator *emu,
@@ -204,6 +277,64 @@ void tilem_calc_emulator_set_audio_options(TilemCalcEmulator *emu,
 void tilem_calc_emulator_set_link_cable(TilemCalcEmulator *emu,
                                         const CableOptions *options);
 
+/* Begin recording all calculator inputs to the given file (if
+   replay is FALSE), or replaying inputs previously recorded (if
+   replay is TRUE.)  While replaying, inputs from the user are
+   ignored. */
+gboolean tilem_calc_emulator_begin_input_log(TilemCalcEmulator *emu,
+                                             const char *filename,
+                                             gboolean replay,
+                                             GError **err);
+
+/* Stop recording or replaying inputs. */
+void tilem_calc_emulator_end_input_log(TilemCalcEmulator *emu);
+
+/* Begin writing a video of the calculator screen to the given file
+   ("-" for standard output), at FPS frames per second of emulated
+   time.  The file is written in YUV4MPEG2 format if its name ends in
+   ".y4m", or as raw 24-bit RGB otherwise; either can be piped
+   directly to an external encoder. */
+gboolean tilem_calc_emulator_begin_video(TilemCalcEmulator *emu,
+                                         const char *filename,
+                                         int fps, GError **err);
+
+/* Stop writing video.  Returns FALSE if an error occurred while
+   writing the file. */
+gboolean tilem_calc_emulator_end_video(TilemCalcEmulator *emu);
+
+/* Begin profiling.  ROMCALLRST is the RST opcode used for ROM calls
+   (see tilem_profile_new()), or 0. */
+void tilem_calc_emulator_begin_profile(TilemCalcEmulator *emu,
+                                       int romcallrst);
+
+/* Stop profiling and return the profile (or NULL if profiling was
+   not active.)  Free it with tilem_profile_free(). */
+TilemProfile * tilem_calc_emulator_end_profile(TilemCalcEmulator *emu);
+
+/* Write the most recently executed instructions to the given file
+   whenever emulation stops at a breakpoint or a hardware exception
+   occurs. */
+gboolean tilem_calc_emulator_set_trace_dump(TilemCalcEmulator *emu,
+                                            const char *filename,
+                                            GError **err);
+
+/* Enable or disable performance counters (for the current
+   calculator, and any calculator loaded in the future.) */
+void tilem_calc_emulator_set_perf_counters(TilemCalcEmulator *emu,
+                                           gboolean enable);
+
+/* Get host time accounting since the last reset. */
+void tilem_calc_emulator_get_telemetry(TilemCalcEmulator *emu,
+                                       TilemEmulatorTelemetry *t);
+
+/* Reset host time accounting. */
+void tilem_calc_emulator_reset_telemetry(TilemCalcEmulator *emu);
+
+/* Write host time accounting to a file, one value per line, as "NAME
+   VALUE". */
+gboolean tilem_calc_emulator_write_telemetry(TilemCalcEmulator *emu,
+                                             FILE *outfile);
+
 /* Press a single key. */
 void tilem_calc_emulator_press_key(TilemCalcEmulator *emu, int key);
 
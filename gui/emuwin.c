@@ -71,133 +71,102 @@ static gboolean window_maximized(TilemEmulatorWindow *ewin)
 	                              | GDK_WINDOW_STATE_FULLSCREEN));
 }
 
-static void
-put_pixel (GdkPixbuf *pixbuf, int x, int y, gboolean pixel_is_on)
+/* Draw speed statistics in the top left corner of the LCD */
+static void draw_speed_text(cairo_t *cr, const char *text)
 {
-	int width, height, rowstride, n_channels;
-	guchar *pixels, *p;
-
-	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
-
-	g_assert (gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB);
-	g_assert (gdk_pixbuf_get_bits_per_sample (pixbuf) == 8);
-	g_assert (n_channels == 3);
-
-	width = gdk_pixbuf_get_width (pixbuf);
-	height = gdk_pixbuf_get_height (pixbuf);
-
-	g_assert (x >= 0 && x < width);
-	g_assert (y >= 0 && y < height);
-
-	rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-	pixels = gdk_pixbuf_get_pixels (pixbuf);
-
-	p = pixels + y * rowstride + x * n_channels;
-	if(pixel_is_on) {
-		p[0] = 0;
-		p[1] = 0;
-		p[2] = 0;
-	} else {
-		p[0] = 255;
-		p[1] = 255;
-		p[2] = 255;
-	}
-		
+	cairo_text_extents_t ext;
+
+	cairo_save(cr);
+	cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL,
+	                       CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size(cr, 10.0);
+	cairo_text_extents(cr, text, &ext);
+
+	cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.6);
+	cairo_rectangle(cr, 0, 0, ext.x_advance + 6, ext.height + 6);
+	cairo_fill(cr);
+
+	cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+	cairo_move_to(cr, 3 - ext.x_bearing, 3 - ext.y_bearing);
+	cairo_show_text(cr, text);
+	cairo_restore(cr);
 }
 
+static void update_lcd_palette(GtkWidget *w, TilemEmulatorWindow *ewin);
+
 static gboolean screen_repaint(GtkWidget *w, cairo_t *cr,
                                TilemEmulatorWindow *ewin)
 {
 	GtkAllocation alloc;
-	GdkWindow *win;
-	GtkStyle *style;
-	gboolean drawrgb;
+	GdkRectangle clip;
+	cairo_surface_t *surf;
+	TilemLCDBuffer *buf;
+	int ystart, yend;
 
 	gtk_widget_get_allocation(w, &alloc);
+	if (alloc.width <= 0 || alloc.height <= 0)
+		return TRUE;
 
-	/* If image buffer is not the correct size, allocate a new one */
-
-	if (!ewin->lcd_image_buf
-	    || alloc.width != ewin->lcd_image_width
-	    || alloc.height != ewin->lcd_image_height) {
-		ewin->lcd_image_width = alloc.width;
-		ewin->lcd_image_height = alloc.height;
-		g_free(ewin->lcd_image_buf);
-		ewin->lcd_image_buf = g_new(byte, alloc.width * alloc.height * 3);
+	/* Only the rows inside the clip region need to be redrawn */
+	if (gdk_cairo_get_clip_rectangle(cr, &clip)) {
+		ystart = MAX(clip.y, 0);
+		yend = MIN(clip.y + clip.height, alloc.height);
+	}
+	else {
+		ystart = 0;
+		yend = alloc.height;
 	}
 
-	/* Draw LCD contents into the image buffer */
-
-	g_mutex_lock(ewin->emu->lcd_mutex);
-	ewin->emu->lcd_update_pending = FALSE;
-
-        if (ewin->emu->lcd_buffer->format == TILEM_LCD_BUF_SRGB_63) {
-	        tilem_draw_lcd_image_rgb(ewin->emu->lcd_buffer,
-	                                 ewin->lcd_image_buf,
-	                                 alloc.width, alloc.height,
-	                                 alloc.width * 3, 3, NULL,
-	                                 (ewin->lcd_smooth_scale
-	                                  ? TILEM_SCALE_SMOOTH
-	                                  : TILEM_SCALE_FAST));
-	        drawrgb = TRUE;
-        }
-        else {
-	        tilem_draw_lcd_image_indexed(ewin->emu->lcd_buffer,
-	                                     ewin->lcd_image_buf,
-	                                     alloc.width, alloc.height,
-	                                     alloc.width,
-	                                     (ewin->lcd_smooth_scale
-	                                      ? TILEM_SCALE_SMOOTH
-	                                      : TILEM_SCALE_FAST));
-	        drawrgb = FALSE;
-        }
-	g_mutex_unlock(ewin->emu->lcd_mutex);
-
-	/* Render buffer to the screen */
-
-	win = gtk_widget_get_window(w);
-	
-	GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, alloc.width, alloc.height);
-	int x, y;
-	for(y = 0; y < alloc.height; y++) {
-		for(x = 0; x < alloc.width; x++) {
-			if(ewin->lcd_image_buf[(y*alloc.width)+x] > 128) {
-				put_pixel(pixbuf, x, y, TRUE);
-			} else {
-				put_pixel(pixbuf, x, y, FALSE);
-			}
-		}
+	/* If image surface is not the correct size, create a new one */
+
+	surf = ewin->lcd_surface;
+	if (!surf
+	    || alloc.width != cairo_image_surface_get_width(surf)
+	    || alloc.height != cairo_image_surface_get_height(surf)) {
+		if (surf)
+			cairo_surface_destroy(surf);
+		surf = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+		                                  alloc.width, alloc.height);
+		ewin->lcd_surface = surf;
+		ystart = 0;
+		yend = alloc.height;
 	}
-	
-	
-	gdk_cairo_set_source_pixbuf(cr, pixbuf, 0, 0);
+
+	if (!ewin->lcd_palette)
+		update_lcd_palette(w, ewin);
+
+	/* Draw LCD contents directly into the surface */
+
+	cairo_surface_flush(surf);
+
+	buf = ewin->emu->lcd_frames[ewin->emu->lcd_front];
+	tilem_draw_lcd_image_xrgb_rows(buf,
+	                               cairo_image_surface_get_data(surf),
+	                               alloc.width, alloc.height,
+	                               cairo_image_surface_get_stride(surf),
+	                               ewin->lcd_palette,
+	                               (ewin->lcd_smooth_scale
+	                                ? TILEM_SCALE_SMOOTH
+	                                : TILEM_SCALE_FAST),
+	                               ystart, yend);
+
+	cairo_surface_mark_dirty_rectangle(surf, 0, ystart,
+	                                   alloc.width, yend - ystart);
+
+	/* Render surface to the screen */
+
+	cairo_set_source_surface(cr, surf, 0, 0);
 	cairo_paint(cr);
 
-	if (drawrgb) {
-		//gdk_cairo_set_source_pixbuf(cr, ewin->lcd_image_buf, 0, 0);
-		//cairo_paint(cr);
-		//gdk_draw_rgb_image(win, style->fg_gc[GTK_STATE_NORMAL], 0, 0,
-		//                   alloc.width, alloc.height,
-		//                   GDK_RGB_DITHER_NORMAL,
-		//                   ewin->lcd_image_buf, alloc.width * 3);
-	} else {
-		//gdk_cairo_set_source_pixbuf(cr, ewin->lcd_image_buf, 0, 0);
-		//cairo_paint(cr);
-		//gdk_draw_indexed_image(win, style->fg_gc[GTK_STATE_NORMAL],
-		//                       0, 0, alloc.width, alloc.height,
-		//                       GDK_RGB_DITHER_NONE,
-		//                       ewin->lcd_image_buf, alloc.width,
-		//                       ewin->lcd_cmap);
-	}
+	if (ewin->speed_text)
+		draw_speed_text(cr, ewin->speed_text);
 
 	return TRUE;
 }
 
-/* Set the color palette for drawing the emulated LCD. */
-static void screen_restyle(GtkWidget* w, GtkStyle* oldstyle G_GNUC_UNUSED,
-                           TilemEmulatorWindow* ewin)
+/* Calculate the color palette for drawing the emulated LCD. */
+static void update_lcd_palette(GtkWidget *w, TilemEmulatorWindow *ewin)
 {
-	dword* palette;
 	GtkStyle *style;
 	int r_dark, g_dark, b_dark;
 	int r_light, g_light, b_light;
@@ -228,16 +197,19 @@ static void screen_restyle(GtkWidget* w, GtkStyle* oldstyle G_GNUC_UNUSED,
 		b_light = (ewin->skin->lcd_white & 0xff);
 	}
 
-	/* Generate a new palette, and convert it into GDK format */
+	/* Generate a new palette */
 
-	//if (ewin->lcd_cmap)
-	//	gdk_rgb_cmap_free(ewin->lcd_cmap);
-
-	palette = tilem_color_palette_new(r_light, g_light, b_light,
-					  r_dark, g_dark, b_dark, gamma);
-	//ewin->lcd_cmap = gdk_rgb_cmap_new(palette, 256);
-	tilem_free(palette);
+	tilem_free(ewin->lcd_palette);
+	ewin->lcd_palette = tilem_color_palette_new(r_light, g_light, b_light,
+	                                            r_dark, g_dark, b_dark,
+	                                            gamma);
+}
 
+/* Set the color palette for drawing the emulated LCD. */
+static void screen_restyle(GtkWidget* w, GtkStyle* oldstyle G_GNUC_UNUSED,
+                           TilemEmulatorWindow* ewin)
+{
+	update_lcd_palette(w, ewin);
 	gtk_widget_queue_draw(ewin->lcd);
 }
 
@@ -316,6 +288,65 @@ static void noskin_size_allocate(G_GNUC_UNUSED GtkWidget *widget,
 	ewin->zoom_factor[ewin->zoom_mode] = MAX(z, 1.0);
 }
 
+#if GTK_CHECK_VERSION(3, 8, 0)
+
+/* Called at the start of the next display frame: ask the core
+   thread for a new LCD image, to be ready for the frame after */
+static gboolean lcd_tick(G_GNUC_UNUSED GtkWidget *w, GdkFrameClock *clock,
+                         gpointer data)
+{
+	TilemEmulatorWindow *ewin = data;
+	gint64 refresh_interval;
+
+	gdk_frame_clock_get_refresh_info(clock, 0, &refresh_interval, NULL);
+
+	/* allow some slack, so that the core thread's timer doesn't
+	   miss every other display frame */
+	tilem_calc_emulator_request_lcd(ewin->emu,
+	                                refresh_interval * 3 / 4);
+	return G_SOURCE_REMOVE;
+}
+
+static void lcd_tick_removed(gpointer data)
+{
+	TilemEmulatorWindow *ewin = data;
+	ewin->lcd_tick_id = 0;
+}
+
+/* Request another frame once this one has been displayed */
+static void request_next_frame(TilemEmulatorWindow *ewin)
+{
+	if (!ewin->lcd_tick_id)
+		ewin->lcd_tick_id = gtk_widget_add_tick_callback
+			(ewin->lcd, &lcd_tick, ewin, &lcd_tick_removed);
+}
+
+/* Remove a pending request before the LCD widget is destroyed (the
+   core thread is told to go ahead, so that a new widget will still
+   receive frames) */
+static void cancel_frame_request(TilemEmulatorWindow *ewin)
+{
+	if (ewin->lcd_tick_id) {
+		gtk_widget_remove_tick_callback(ewin->lcd, ewin->lcd_tick_id);
+		ewin->lcd_tick_id = 0;
+		if (ewin->emu)
+			tilem_calc_emulator_request_lcd(ewin->emu, 0);
+	}
+}
+
+#else
+
+static void request_next_frame(TilemEmulatorWindow *ewin)
+{
+	tilem_calc_emulator_request_lcd(ewin->emu, 0);
+}
+
+static void cancel_frame_request(G_GNUC_UNUSED TilemEmulatorWindow *ewin)
+{
+}
+
+#endif
+
 /* Used when you load another skin */
 void redraw_screen(TilemEmulatorWindow *ewin)
 {
@@ -352,6 +383,8 @@ void redraw_screen(TilemEmulatorWindow *ewin)
 		lcdwidth = lcdheight = 1;
 	}
 
+	cancel_frame_request(ewin);
+
 	if (ewin->lcd)
 		gtk_widget_destroy(ewin->lcd);
 	if (ewin->background)
@@ -494,6 +527,7 @@ static void window_destroy(G_GNUC_UNUSED GtkWidget *w, gpointer data)
 		                 "zoom_240/r", ewin->zoom_factor[ZMODE_240],
 		                 NULL);
 
+	cancel_frame_request(ewin);
 	ewin->window = ewin->layout = ewin->lcd = ewin->background = NULL;
 }
 
@@ -550,6 +584,8 @@ void tilem_emulator_window_free(TilemEmulatorWindow *ewin)
 {
 	g_return_if_fail(ewin != NULL);
 
+	cancel_frame_request(ewin);
+
 	if (ewin->lcd)
 		gtk_widget_destroy(ewin->lcd);
 	if (ewin->background)
@@ -563,7 +599,13 @@ void tilem_emulator_window_free(TilemEmulatorWindow *ewin)
 	if (ewin->actions)
 		g_object_unref(ewin->actions);
 
-	g_free(ewin->lcd_image_buf);
+	if (ewin->lcd_surface)
+		cairo_surface_destroy(ewin->lcd_surface);
+	tilem_free(ewin->lcd_palette);
+
+	if (ewin->speed_timeout_id)
+		g_source_remove(ewin->speed_timeout_id);
+	g_free(ewin->speed_text);
 
 	g_free(ewin->skin_file_name);
 	if (ewin->skin) {
@@ -571,9 +613,6 @@ void tilem_emulator_window_free(TilemEmulatorWindow *ewin)
 		g_free(ewin->skin);
 	}
 
-	//if (ewin->lcd_cmap)
-	//	gdk_rgb_cmap_free(ewin->lcd_cmap);
-
 	g_slice_free(TilemEmulatorWindow, ewin);
 }
 
@@ -672,6 +711,106 @@ void tilem_emulator_window_refresh_lcd(TilemEmulatorWindow *ewin)
 		gtk_widget_queue_draw(ewin->lcd);
 }
 
+void tilem_emulator_window_update_lcd(TilemEmulatorWindow *ewin)
+{
+	TilemLCDBuffer *buf;
+	GtkAllocation alloc;
+	int y, ystart, yend, top, bottom;
+
+	g_return_if_fail(ewin != NULL);
+	g_return_if_fail(ewin->emu != NULL);
+
+	if (!ewin->lcd) {
+		tilem_calc_emulator_take_lcd(ewin->emu);
+		tilem_calc_emulator_request_lcd(ewin->emu, 0);
+		return;
+	}
+
+	if (!tilem_calc_emulator_take_lcd(ewin->emu))
+		return;
+
+	request_next_frame(ewin);
+
+	gtk_widget_get_allocation(ewin->lcd, &alloc);
+
+	buf = ewin->emu->lcd_frames[ewin->emu->lcd_front];
+	if (buf->height == 0) {
+		gtk_widget_queue_draw(ewin->lcd);
+	}
+	else {
+		for (y = 0; tilem_lcd_buffer_get_dirty_rows(buf, y, &ystart,
+		                                            &yend); y = yend) {
+			/* include one extra row on either side, since
+			   scaled pixels may overlap */
+			top = ystart * alloc.height / buf->height - 1;
+			bottom = ((yend * alloc.height + buf->height - 1)
+			          / buf->height) + 1;
+			top = MAX(top, 0);
+			bottom = MIN(bottom, alloc.height);
+			gtk_widget_queue_draw_area(ewin->lcd, 0, top,
+			                           alloc.width, bottom - top);
+		}
+	}
+	tilem_lcd_buffer_clear_dirty(buf);
+}
+
+/* Percentage of wall-clock time */
+#define PCT(field) ((cur.field - ewin->speed_prev.field) * 100.0 / wall)
+
+/* Update speed statistics (called once per second) */
+static gboolean update_speed(gpointer data)
+{
+	TilemEmulatorWindow *ewin = data;
+	TilemEmulatorTelemetry cur;
+	gdouble wall;
+
+	tilem_calc_emulator_get_telemetry(ewin->emu, &cur);
+
+	wall = cur.wall_time - ewin->speed_prev.wall_time;
+	if (wall > 0) {
+		g_free(ewin->speed_text);
+		ewin->speed_text = g_strdup_printf
+			(_("Speed %3.0f%%  CPU %3.0f%%  Sleep %3.0f%%"
+			   "  Lock %3.0f%%  %u fps"),
+			 PCT(emulated_time),
+			 PCT(run_time),
+			 PCT(sleep_time) + PCT(spin_time),
+			 PCT(lock_wait_time),
+			 (unsigned) ((cur.lcd_frames
+			              - ewin->speed_prev.lcd_frames)
+			             * 1000000.0 / wall + 0.5));
+		tilem_emulator_window_refresh_lcd(ewin);
+	}
+
+	ewin->speed_prev = cur;
+	return TRUE;
+}
+
+#undef PCT
+
+void tilem_emulator_window_set_show_speed(TilemEmulatorWindow *ewin,
+                                          gboolean show)
+{
+	g_return_if_fail(ewin != NULL);
+
+	if (ewin->speed_timeout_id) {
+		g_source_remove(ewin->speed_timeout_id);
+		ewin->speed_timeout_id = 0;
+	}
+
+	g_free(ewin->speed_text);
+	ewin->speed_text = NULL;
+
+	if (show) {
+		tilem_calc_emulator_get_telemetry(ewin->emu,
+		                                  &ewin->speed_prev);
+		ewin->speed_timeout_id = g_timeout_add(1000, &update_speed,
+		                                       ewin);
+	}
+
+	tilem_emulator_window_refresh_lcd(ewin);
+}
+
 
 
 
@@ -33,11 +33,10 @@ typedef struct _TilemEmulatorWindow {
 	GdkGeometry geomhints;
 	GdkWindowHints geomhintmask;
 
-	byte* lcd_image_buf;
-	int lcd_image_width;
-	int lcd_image_height;
-	//GdkRgbCmap* lcd_cmap;
+	cairo_surface_t *lcd_surface; /* Scaled LCD image */
+	dword *lcd_palette; /* Palette for monochrome/grayscale LCDs */
 	gboolean lcd_smooth_scale;
+	guint lcd_tick_id; /* Pending request for the next frame */
 
 	char *skin_file_name;
 	SKIN_INFOS *skin;
@@ -53,6 +52,11 @@ typedef struct _TilemEmulatorWindow {
 	int keypress_keycodes[64];
 	int sequence_keycode;
 
+	/* Speed display */
+	guint speed_timeout_id;
+	TilemEmulatorTelemetry speed_prev;
+	char *speed_text;
+
 } TilemEmulatorWindow;
 
 /* Create a new TilemEmulatorWindow. */
@@ -75,5 +79,13 @@ void tilem_emulator_window_calc_changed(TilemEmulatorWindow *ewin);
 /* Redraw LCD contents. */
 void tilem_emulator_window_refresh_lcd(TilemEmulatorWindow *ewin);
 
+/* Redraw the parts of the LCD that have changed since the last
+   update (as marked in the emulator's LCD buffer.) */
+void tilem_emulator_window_update_lcd(TilemEmulatorWindow *ewin);
+
+/* Show or hide emulation speed statistics over the LCD. */
+void tilem_emulator_window_set_show_speed(TilemEmulatorWindow *ewin,
+                                          gboolean show);
+
 /* Prompt for a ROM file to open */
 gboolean tilem_emulator_window_prompt_open_rom(TilemEmulatorWindow *ewin);
@@ -346,14 +346,41 @@ void progress_bar_update(TilemCalcEmulator* emu);
 
 /* ##### animatedgif.c ##### */
 
-/* Save a TilemAnimation to a GIF file. */
-void tilem_animation_write_gif(TilemAnimation *anim, byte* palette, int palette_size, FILE *fp);
+typedef struct _TilemGifWriter TilemGifWriter;
+
+/* Begin writing a GIF file.  PALETTE contains PALETTE_SIZE colors (as
+   RGB triples); the color table and code size are no larger than
+   needed to hold them.  If ANIMATED is true, the file is written as
+   an animation, and each frame after the first stores only the
+   rectangle that changed. */
+TilemGifWriter * tilem_gif_writer_new(FILE *fp, int width, int height,
+                                      const byte *palette, int palette_size,
+                                      gboolean animated);
+
+/* Write a frame.  IMAGE is an indexed-color image (of the size given
+   to tilem_gif_writer_new), and DELAY is the frame duration in 1/100
+   second. */
+void tilem_gif_writer_add_frame(TilemGifWriter *gw, const byte *image,
+                                int delay);
+
+/* Write the end of the file, and free the writer. */
+void tilem_gif_writer_finish(TilemGifWriter *gw);
+
+/* Save a TilemAnimation to a GIF file.  If INDEX_MAP is non-null,
+   it maps image pixel values to palette indices. */
+void tilem_animation_write_gif(TilemAnimation *anim, const byte *palette,
+                               int palette_size, const byte *index_map,
+                               FILE *fp);
 
 
 /* ##### gifencod.c ##### */
 
-/* Encode gif data */
-void GifEncode(FILE *fout, unsigned char *pixels, int depth, int siz);
+/* Write LZW-compressed GIF image data: the minimum code size, data
+   sub-blocks, but not the block terminator.  All pixel values must
+   be less than 2^DEPTH. */
+void tilem_gif_encode_image(FILE *fp, const byte *pixels,
+                            int width, int height, int rowstride,
+                            int depth);
 
 
 /* ##### screenshot.c ##### */
@@ -161,6 +161,13 @@ static void action_quit(G_GNUC_UNUSED GtkAction *act,
 	gtk_widget_destroy(ewin->window);
 }
 
+static void action_show_speed(GtkToggleAction *action, gpointer data)
+{
+	TilemEmulatorWindow *ewin = data;
+	tilem_emulator_window_set_show_speed
+		(ewin, gtk_toggle_action_get_active(action));
+}
+
 static const GtkActionEntry main_action_ents[] =
 	{{ "send-file",
 	   GTK_STOCK_OPEN, N_("Send _File..."), "<ctrl>O",
@@ -242,6 +249,12 @@ static const GtkActionEntry main_action_ents[] =
 	   N_("Quit the application"),
 	   G_CALLBACK(action_quit) }};
 
+static const GtkToggleActionEntry main_toggle_ents[] =
+	{{ "show-speed",
+	   0, N_("Show Sp_eed"), "",
+	   N_("Display emulation speed and host time usage"),
+	   G_CALLBACK(action_show_speed), FALSE }};
+
 static GtkWidget *add_item(GtkWidget *menu, GtkAccelGroup *accelgrp,
                            GtkActionGroup *actions, const char *name)
 {
@@ -290,6 +303,9 @@ void build_menu(TilemEmulatorWindow* ewin)
 	gtk_action_group_set_translation_domain(acts, GETTEXT_PACKAGE);
 	gtk_action_group_add_actions(ewin->actions, main_action_ents,
 	                             G_N_ELEMENTS(main_action_ents), ewin);
+	gtk_action_group_add_toggle_actions(ewin->actions, main_toggle_ents,
+	                                    G_N_ELEMENTS(main_toggle_ents),
+	                                    ewin);
 
 	ag = gtk_accel_group_new();
 	gtk_window_add_accel_group(GTK_WINDOW(ewin->window), ag);
@@ -319,6 +335,7 @@ void build_menu(TilemEmulatorWindow* ewin)
 
 	add_item(menu, ag, acts, "screenshot");
 	add_item(menu, ag, acts, "quick-screenshot");
+	add_item(menu, ag, acts, "show-speed");
 	add_separator(menu);
 
 	add_item(menu, ag, acts, "preferences");
@@ -28,6 +28,7 @@
 #include <locale.h>
 #include <gtk/gtk.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <ticalcs.h>
 #include <tilem.h>
 
@@ -51,6 +52,13 @@ static gboolean cl_normalspeed_flag = FALSE;
 static gboolean cl_fullspeed_flag = FALSE;
 static gchar* cl_link_cable = NULL;
 static gboolean cl_audio_flag = FALSE;
+static gchar* cl_record_input = NULL;
+static gchar* cl_replay_input = NULL;
+static gchar* cl_record_video = NULL;
+static gint cl_video_rate = 30;
+static gchar* cl_trace_dump = NULL;
+static gchar* cl_perf_counters = NULL;
+static gchar* cl_telemetry = NULL;
 
 
 static GOptionEntry entries[] =
@@ -68,6 +76,13 @@ static GOptionEntry entries[] =
 	{ "full-speed", 0, 0, G_OPTION_ARG_NONE, &cl_fullspeed_flag, N_("Run at maximum speed"), NULL },
 	{ "cable", 'c', 0, G_OPTION_ARG_STRING, &cl_link_cable, N_("Connect to an external link cable"), N_("TYPE[:PORT]") },
 	{ "audio", 'a', 0, G_OPTION_ARG_NONE, &cl_audio_flag, N_("Enable audio output"), NULL },
+	{ "record-input", 0, 0, G_OPTION_ARG_FILENAME, &cl_record_input, N_("Record all calculator inputs to a file"), N_("FILE") },
+	{ "replay-input", 0, 0, G_OPTION_ARG_FILENAME, &cl_replay_input, N_("Replay calculator inputs from a file"), N_("FILE") },
+	{ "record-video", 0, 0, G_OPTION_ARG_FILENAME, &cl_record_video, N_("Record the calculator screen as uncompressed video (Y4M if FILE ends in .y4m, raw RGB otherwise; - for standard output)"), N_("FILE") },
+	{ "video-rate", 0, 0, G_OPTION_ARG_INT, &cl_video_rate, N_("Frame rate for --record-video (default 30)"), N_("FPS") },
+	{ "perf-counters", 0, 0, G_OPTION_ARG_FILENAME, &cl_perf_counters, N_("Write emulator performance counters to a file on exit"), N_("FILE") },
+	{ "telemetry", 0, 0, G_OPTION_ARG_FILENAME, &cl_telemetry, N_("Write host time usage statistics to a file on exit"), N_("FILE") },
+	{ "trace-dump", 0, 0, G_OPTION_ARG_FILENAME, &cl_trace_dump, N_("Write recently executed instructions to a file at each breakpoint or exception"), N_("FILE") },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &cl_files_to_load, NULL, N_("FILE") },
 	{ 0, 0, 0, 0, 0, 0, 0 }
 };
@@ -359,6 +374,41 @@ void popup_ask_save(TilemEmulatorWindow* ewin) {
   return;
 }
 
+static void write_perf_counters(const TilemPerfCounters *perf,
+                                const char *filename)
+{
+	FILE *f;
+	int status = -1;
+
+	f = g_fopen(filename, "w");
+	if (f) {
+		status = tilem_perf_counters_write(perf, f);
+		if (fclose(f))
+			status = -1;
+	}
+
+	if (status)
+		g_printerr(_("%s: unable to write %s\n"),
+		           g_get_prgname(), filename);
+}
+
+static void write_telemetry(TilemCalcEmulator *emu, const char *filename)
+{
+	FILE *f;
+	gboolean status = FALSE;
+
+	f = g_fopen(filename, "w");
+	if (f) {
+		status = tilem_calc_emulator_write_telemetry(emu, f);
+		if (fclose(f))
+			status = FALSE;
+	}
+
+	if (!status)
+		g_printerr(_("%s: unable to write %s\n"),
+		           g_get_prgname(), filename);
+}
+
 static gboolean delete_event( G_GNUC_UNUSED GtkWidget *widget,
                               G_GNUC_UNUSED GdkEvent  *event,
                               gpointer   data )
@@ -461,6 +511,36 @@ int main(int argc, char **argv)
 	tilem_calc_emulator_set_audio(emu, cl_audio_flag);
 	tilem_calc_emulator_set_link_cable(emu, &cable_options);
 
+	if (emu->calc && (cl_record_input || cl_replay_input)) {
+		if (!tilem_calc_emulator_begin_input_log
+		    (emu, (cl_replay_input ? cl_replay_input : cl_record_input),
+		     (cl_replay_input != NULL), &error)) {
+			g_printerr(_("%s: %s\n"), g_get_prgname(), error->message);
+			g_clear_error(&error);
+		}
+	}
+
+	if (emu->calc && cl_record_video) {
+		if (cl_video_rate <= 0)
+			cl_video_rate = 30;
+		if (!tilem_calc_emulator_begin_video(emu, cl_record_video,
+		                                     cl_video_rate, &error)) {
+			g_printerr(_("%s: %s\n"), g_get_prgname(), error->message);
+			g_clear_error(&error);
+		}
+	}
+
+	if (cl_perf_counters)
+		tilem_calc_emulator_set_perf_counters(emu, TRUE);
+
+	if (cl_trace_dump) {
+		if (!tilem_calc_emulator_set_trace_dump(emu, cl_trace_dump,
+		                                        &error)) {
+			g_printerr(_("%s: %s\n"), g_get_prgname(), error->message);
+			g_clear_error(&error);
+		}
+	}
+
 	if (cl_files_to_load)
 		load_files_cmdline(emu->ewin, cl_files_to_load);
 	if (cl_macro_to_run)
@@ -483,6 +563,14 @@ int main(int argc, char **argv)
 
 	tilem_calc_emulator_pause(emu);
 
+	if (cl_perf_counters && emu->calc && emu->calc->perf)
+		write_perf_counters(emu->calc->perf, cl_perf_counters);
+	if (cl_telemetry)
+		write_telemetry(emu, cl_telemetry);
+	if (cl_record_video && !tilem_calc_emulator_end_video(emu))
+		g_printerr(_("%s: unable to write %s\n"),
+		           g_get_prgname(), cl_record_video);
+
 	tilem_emulator_window_free(emu->ewin);
 	tilem_calc_emulator_free(emu);
 
@@ -0,0 +1,173 @@
+/*
+ * TilEm II
+ *
+ * Copyright (c) 2026 The TilEm developers
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <ticalcs.h>
+#include <tilem.h>
+#include <tilemdb.h>
+
+#include "gui.h"
+#include "fixedtreeview.h"
+
+/* Number of instructions to display */
+#define TRACE_VIEW_LENGTH 1000
+
+enum {
+	COL_ADDRESS,
+	COL_INSTRUCTION,
+	COL_NOTE,
+	N_COLUMNS
+};
+
+/* Fill list with the most recent instructions.  Instructions are
+   disassembled from the current memory contents, so self-modifying
+   code may be shown incorrectly. */
+static void fill_trace_store(TilemDebugger *dbg, GtkListStore *store)
+{
+	TilemCalc *calc = dbg->emu->calc;
+	TilemTraceEntry *entries;
+	GtkTreeIter iter;
+	char addr[20], buf[500], *p;
+	dword phys;
+	int n, i;
+
+	entries = g_new(TilemTraceEntry, TRACE_VIEW_LENGTH);
+
+	tilem_calc_emulator_lock(dbg->emu);
+	n = tilem_trace_get_entries(dbg->emu->trace, entries,
+	                            TRACE_VIEW_LENGTH);
+
+	for (i = 0; i < n; i++) {
+		phys = (entries[i].page << 14) | (entries[i].pc & 0x3fff);
+		tilem_disasm_disassemble(dbg->dasm, calc, 1, phys, NULL,
+		                         buf, sizeof(buf));
+		while ((p = strchr(buf, '\t')))
+			*p = ' ';
+
+		g_snprintf(addr, sizeof(addr), "%02X:%04X",
+		           entries[i].page, entries[i].pc);
+
+		gtk_list_store_append(store, &iter);
+		gtk_list_store_set(store, &iter,
+		                   COL_ADDRESS, addr,
+		                   COL_INSTRUCTION, buf,
+		                   COL_NOTE, (entries[i].interrupt
+		                              ? _("Interrupt") : ""),
+		                   -1);
+	}
+	tilem_calc_emulator_unlock(dbg->emu);
+
+	g_free(entries);
+}
+
+void tilem_debugger_show_trace(TilemDebugger *dbg)
+{
+	GtkWidget *dlg, *treeview, *sw, *vbox;
+	GtkListStore *store;
+	GtkTreeViewColumn *col;
+	GtkCellRenderer *cell;
+	GtkTreePath *path;
+	int n;
+
+	g_return_if_fail(dbg != NULL);
+	g_return_if_fail(dbg->emu != NULL);
+
+	if (!dbg->emu->trace)
+		return;
+
+	dlg = gtk_dialog_new_with_buttons(_("Recent Instructions"),
+	                                  GTK_WINDOW(dbg->window),
+	                                  GTK_DIALOG_MODAL,
+	                                  _("Close"),
+	                                  GTK_RESPONSE_ACCEPT,
+	                                  NULL);
+
+	gtk_window_set_default_size(GTK_WINDOW(dlg), -1, 400);
+
+	store = gtk_list_store_new(N_COLUMNS,
+	                           G_TYPE_STRING,
+	                           G_TYPE_STRING,
+	                           G_TYPE_STRING);
+	fill_trace_store(dbg, store);
+
+	treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(treeview), TRUE);
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(treeview), TRUE);
+
+	fixed_tree_view_init(treeview, 0,
+	                     COL_ADDRESS, "DD:DDDD ",
+	                     COL_INSTRUCTION, "LD (IX+DD),DDh      ",
+	                     COL_NOTE, "Interrupt ",
+	                     -1);
+
+	cell = gtk_cell_renderer_text_new();
+	col = gtk_tree_view_column_new_with_attributes
+		(_("Address"), cell, "text", COL_ADDRESS, NULL);
+	gtk_tree_view_column_set_sizing(col, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), col);
+
+	cell = gtk_cell_renderer_text_new();
+	col = gtk_tree_view_column_new_with_attributes
+		(_("Instruction"), cell, "text", COL_INSTRUCTION, NULL);
+	gtk_tree_view_column_set_sizing(col, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), col);
+
+	cell = gtk_cell_renderer_text_new();
+	col = gtk_tree_view_column_new_with_attributes
+		("", cell, "text", COL_NOTE, NULL);
+	gtk_tree_view_column_set_sizing(col, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), col);
+
+	sw = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw),
+	                               GTK_POLICY_NEVER,
+	                               GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(sw),
+	                                    GTK_SHADOW_IN);
+	gtk_container_add(GTK_CONTAINER(sw), treeview);
+	gtk_container_set_border_width(GTK_CONTAINER(sw), 6);
+
+	/* show the most recent instruction */
+	n = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store), NULL);
+	if (n > 0) {
+		path = gtk_tree_path_new_from_indices(n - 1, -1);
+		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(treeview), path,
+		                             NULL, FALSE, 0.0, 0.0);
+		gtk_tree_view_set_cursor(GTK_TREE_VIEW(treeview), path,
+		                         NULL, FALSE);
+		gtk_tree_path_free(path);
+	}
+
+	g_object_unref(store);
+
+	gtk_widget_show_all(sw);
+
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+	gtk_box_pack_start(GTK_BOX(vbox), sw, TRUE, TRUE, 0);
+
+	gtk_dialog_run(GTK_DIALOG(dlg));
+	gtk_widget_destroy(dlg);
+}